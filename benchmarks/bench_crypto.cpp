@@ -0,0 +1,119 @@
+/**
+ * @file benchmarks/bench_crypto.cpp
+ * @brief Benchmarks for the stream ciphers and the client certificate chain in src/crypto.*
+ */
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include <src/crypto.h>
+
+/**
+ * @brief Encrypt a video shard of `range(0)` bytes in place, like the video broadcast thread.
+ */
+static void
+BM_GcmEncrypt(benchmark::State &state) {
+  crypto::aes_t key(16, 0x42);
+  crypto::aes_t iv(12, 0x24);
+  crypto::cipher::gcm_t cipher { key, false };
+
+  std::vector<std::uint8_t> shard(state.range(0));
+  std::uint8_t tag[crypto::cipher::tag_size];
+
+  for (auto _ : state) {
+    cipher.encrypt(std::string_view { (char *) shard.data(), shard.size() }, tag, shard.data(), &iv);
+    benchmark::DoNotOptimize(tag);
+  }
+
+  state.SetBytesProcessed(state.iterations() * shard.size());
+}
+BENCHMARK(BM_GcmEncrypt)->Arg(1408)->Arg(16 * 1024);
+
+/**
+ * @brief Encrypt an audio packet of `range(0)` bytes, like the audio broadcast thread.
+ */
+static void
+BM_CbcEncrypt(benchmark::State &state) {
+  crypto::aes_t key(16, 0x42);
+  crypto::aes_t iv(16, 0x24);
+  crypto::cipher::cbc_t cipher { key, true };
+
+  std::vector<std::uint8_t> plaintext(state.range(0));
+  std::vector<std::uint8_t> ciphertext(crypto::cipher::round_to_pkcs7_padded(plaintext.size()));
+
+  for (auto _ : state) {
+    auto bytes = cipher.encrypt(std::string_view { (char *) plaintext.data(), plaintext.size() }, ciphertext.data(), &iv);
+    benchmark::DoNotOptimize(bytes);
+  }
+
+  state.SetBytesProcessed(state.iterations() * plaintext.size());
+}
+BENCHMARK(BM_CbcEncrypt)->Arg(120)->Arg(1400);
+
+namespace {
+  /**
+   * @brief Self-signed client certificates, each with a key of its own like real clients.
+   * @details The keys are P-256 keys, so generating a thousand of them is quick.
+   */
+  const std::vector<crypto::x509_t> &
+  client_certs() {
+    static const auto certs = []() {
+      auto creds = crypto::gen_creds("NVIDIA GameStream Client", 2048);
+
+      std::vector<crypto::x509_t> certs;
+      for (long serial = 1; serial <= 1001; ++serial) {
+        crypto::pkey_t key { EVP_EC_gen("P-256") };
+
+        auto cert = crypto::x509(creds.x509);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), serial);
+        X509_set_pubkey(cert.get(), key.get());
+        X509_sign(cert.get(), key.get(), EVP_sha256());
+
+        certs.emplace_back(std::move(cert));
+      }
+
+      return certs;
+    }();
+
+    return certs;
+  }
+
+  void
+  pair_clients(crypto::cert_chain_t &chain, std::size_t count) {
+    for (std::size_t x = 0; x < count; ++x) {
+      chain.add(crypto::x509_t { X509_dup(client_certs()[x].get()) });
+    }
+  }
+}  // namespace
+
+/**
+ * @brief Verify the certificate of the last of `range(0)` paired clients, like the TLS handshake on the HTTPS port.
+ */
+static void
+BM_CertChainVerify(benchmark::State &state) {
+  crypto::cert_chain_t chain;
+  pair_clients(chain, state.range(0));
+
+  crypto::x509_t cert { X509_dup(client_certs()[state.range(0) - 1].get()) };
+  for (auto _ : state) {
+    auto error = chain.verify_safe(cert.get());
+    benchmark::DoNotOptimize(error);
+  }
+}
+BENCHMARK(BM_CertChainVerify)->Arg(10)->Arg(100)->Arg(1000);
+
+/**
+ * @brief Reject the certificate of a client that isn't one of `range(0)` paired clients.
+ */
+static void
+BM_CertChainReject(benchmark::State &state) {
+  crypto::cert_chain_t chain;
+  pair_clients(chain, state.range(0));
+
+  crypto::x509_t cert { X509_dup(client_certs().back().get()) };
+  for (auto _ : state) {
+    auto error = chain.verify_safe(cert.get());
+    benchmark::DoNotOptimize(error);
+  }
+}
+BENCHMARK(BM_CertChainReject)->Arg(10)->Arg(100)->Arg(1000);
@@ -0,0 +1,48 @@
+/**
+ * @file benchmarks/bench_input.cpp
+ * @brief Benchmarks for the input batching in src/input.*
+ */
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <moonlight-common-c/src/Input.h>
+#include <moonlight-common-c/src/Limelight.h>
+
+#include <src/utility.h>
+
+namespace input {
+  enum class batch_result_e;
+
+  batch_result_e
+  batch(PNV_INPUT_HEADER dest, PNV_INPUT_HEADER src);
+}  // namespace input
+
+/**
+ * @brief Batch two input packets of the same type.
+ */
+template <class T>
+static void
+BM_Batch(benchmark::State &state, std::uint32_t magic) {
+  T dest {};
+  T src {};
+  dest.header.magic = src.header.magic = util::endian::little(magic);
+
+  // Touch and pen events only batch while moving
+  if constexpr (requires { src.eventType; }) {
+    dest.eventType = src.eventType = LI_TOUCH_EVENT_MOVE;
+  }
+
+  for (auto _ : state) {
+    auto batched = dest;
+    benchmark::DoNotOptimize(input::batch(&batched.header, &src.header));
+  }
+}
+BENCHMARK_CAPTURE(BM_Batch<NV_REL_MOUSE_MOVE_PACKET>, rel_mouse_move, MOUSE_MOVE_REL_MAGIC_GEN5);
+BENCHMARK_CAPTURE(BM_Batch<NV_ABS_MOUSE_MOVE_PACKET>, abs_mouse_move, MOUSE_MOVE_ABS_MAGIC);
+BENCHMARK_CAPTURE(BM_Batch<NV_SCROLL_PACKET>, scroll, SCROLL_MAGIC_GEN5);
+BENCHMARK_CAPTURE(BM_Batch<SS_HSCROLL_PACKET>, hscroll, SS_HSCROLL_MAGIC);
+BENCHMARK_CAPTURE(BM_Batch<NV_MULTI_CONTROLLER_PACKET>, controller, MULTI_CONTROLLER_MAGIC_GEN5);
+BENCHMARK_CAPTURE(BM_Batch<SS_TOUCH_PACKET>, touch, SS_TOUCH_MAGIC);
+BENCHMARK_CAPTURE(BM_Batch<SS_PEN_PACKET>, pen, SS_PEN_MAGIC);
+BENCHMARK_CAPTURE(BM_Batch<SS_CONTROLLER_TOUCH_PACKET>, controller_touch, SS_CONTROLLER_TOUCH_MAGIC);
+BENCHMARK_CAPTURE(BM_Batch<SS_CONTROLLER_MOTION_PACKET>, controller_motion, SS_CONTROLLER_MOTION_MAGIC);
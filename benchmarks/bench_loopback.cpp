@@ -0,0 +1,493 @@
+/**
+ * @file benchmarks/bench_loopback.cpp
+ * @brief End-to-end benchmark of capture, software encoding, FEC, encryption and UDP transport on localhost.
+ */
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/endian/conversion.hpp>
+
+extern "C" {
+#include <src/rswrapper.h>
+}
+
+#include <src/config.h>
+#include <src/crypto.h>
+#include <src/globals.h>
+#include <src/stream_packets.h>
+#include <src/video.h>
+
+using namespace std::literals;
+namespace asio = boost::asio;
+
+#ifdef __linux__
+namespace platf {
+  std::shared_ptr<display_t>
+  replay_display(mem_type_e hwdevice_type, const std::string &display_name, const video::config_t &config);
+}  // namespace platf
+#endif
+
+namespace {
+  constexpr int frame_width = 1280;
+  constexpr int frame_height = 720;
+  constexpr int framerate = 60;
+  constexpr auto stream_duration = 3s;
+
+  // Default packet size and parity shard minimum requested by Moonlight
+  constexpr int packetsize = 1392;
+  constexpr int min_parity_shards = 2;
+  constexpr std::size_t blocksize = packetsize + MAX_RTP_HEADER_SIZE;
+
+  using rtp_tick = std::chrono::duration<std::uint32_t, std::ratio<1, 90000>>;
+
+  enum class pattern_e : int {
+    still,  ///< The same picture on every frame, like an idle desktop
+    motion,  ///< Noise scrolling across the whole picture, like fast camera movement in a game
+    replay,  ///< The recording named by the SUNSHINE_BENCH_REPLAY environment variable
+  };
+
+  struct synthetic_img_t: platf::img_t {
+    std::vector<std::uint8_t> buffer;
+  };
+
+  /**
+   * @brief A display that draws deterministic frames at a fixed framerate.
+   */
+  class synthetic_display_t: public platf::display_t {
+  public:
+    synthetic_display_t(pattern_e pattern):
+        pattern { pattern } {
+      width = env_width = frame_width;
+      height = env_height = frame_height;
+    }
+
+    platf::capture_e
+    capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
+      constexpr auto delay = std::chrono::nanoseconds { 1s } / framerate;
+      auto next_frame = std::chrono::steady_clock::now();
+
+      while (true) {
+        std::this_thread::sleep_until(next_frame);
+        next_frame += delay;
+
+        std::shared_ptr<platf::img_t> img_out;
+        if (!pull_free_image_cb(img_out)) {
+          return platf::capture_e::interrupted;
+        }
+
+        draw(*img_out, frame_nr++);
+        img_out->frame_timestamp = std::chrono::steady_clock::now();
+
+        if (!push_captured_image_cb(std::move(img_out), true)) {
+          return platf::capture_e::ok;
+        }
+      }
+    }
+
+    std::shared_ptr<platf::img_t>
+    alloc_img() override {
+      auto img = std::make_shared<synthetic_img_t>();
+      img->width = width;
+      img->height = height;
+      img->pixel_pitch = 4;
+      img->row_pitch = width * img->pixel_pitch;
+      img->buffer.resize(img->row_pitch * height);
+      img->data = img->buffer.data();
+
+      return img;
+    }
+
+    int
+    dummy_img(platf::img_t *img) override {
+      std::fill_n(img->data, img->row_pitch * img->height, 0);
+      return 0;
+    }
+
+    std::unique_ptr<platf::avcodec_encode_device_t>
+    make_avcodec_encode_device(platf::pix_fmt_e pix_fmt) override {
+      return std::make_unique<platf::avcodec_encode_device_t>();
+    }
+
+  private:
+    void
+    draw(platf::img_t &img, std::uint32_t frame) {
+      auto shift = pattern == pattern_e::motion ? frame * 7 : 0;
+
+      for (int y = 0; y < img.height; ++y) {
+        auto row = (std::uint32_t *) (img.data + y * img.row_pitch);
+        for (int x = 0; x < img.width; ++x) {
+          // A gradient with hashed noise on top, so the encoder can't predict all of it
+          auto noise = (std::uint32_t) (x + shift) * 0x9E3779B1u ^ (std::uint32_t) y * 0x85EBCA77u;
+          row[x] = ((x * 255 / img.width) << 16 | (y * 255 / img.height) << 8 | (noise >> 24)) & 0xFFFFFF;
+        }
+      }
+    }
+
+    pattern_e pattern;
+    std::uint32_t frame_nr = 0;
+  };
+
+  // Marks the end of the stream for the receiver, it's shorter than any video packet
+  constexpr std::uint8_t end_of_stream = 0;
+
+  // The key of the stream, Moonlight sends a random one when it launches an app
+  const crypto::aes_t gcm_key(16, 0x5A);
+
+  /**
+   * @brief Sends encoded frames like the video broadcast thread, to a session with video encryption.
+   */
+  class sender_t {
+  public:
+    sender_t(asio::io_context &io, const asio::ip::udp::endpoint &peer, std::chrono::steady_clock::time_point epoch):
+        sock { io, asio::ip::udp::v4() },
+        peer { peer },
+        sender { platf::create_high_precision_timer(), epoch },
+        cipher { gcm_key, false } {}
+
+    void
+    send_frame(video::packet_raw_t &packet) {
+      stream::video_short_frame_header_t frame_header {};
+      frame_header.headerType = 0x01;
+      frame_header.frameType = packet.is_idr() ? 2 : 1;
+
+      std::string_view frame { (char *) packet.data(), packet.data_size() };
+      auto fec_blocks = stream::split_video_frame(frame_header, frame, packetsize, config::stream.fec_percentage);
+
+      stream::video_destination_t destination {
+        .sock = (std::uintptr_t) sock.native_handle(),
+        .peer = peer,
+        .local_address = asio::ip::address_v4::loopback(),
+        .min_parity_shards = min_parity_shards,
+        .cipher = &cipher,
+        .gcm_iv_counter = gcm_iv_counter,
+        .lowseq = lowseq,
+        .metrics = metrics,
+      };
+
+      sender.send_frame(packet, fec_blocks, destination);
+    }
+
+    void
+    send_end_of_stream() {
+      sock.send_to(asio::buffer(&end_of_stream, sizeof(end_of_stream)), peer);
+    }
+
+  private:
+    asio::ip::udp::socket sock;
+    asio::ip::udp::endpoint peer;
+
+    stream::video_sender_t sender;
+    crypto::cipher::gcm_t cipher;
+    std::uint64_t gcm_iv_counter = 0;
+    int lowseq = 0;
+    metrics::session_t metrics {};
+  };
+
+  struct receiver_stats_t {
+    std::vector<double> latencies_ms;
+    std::size_t frames = 0;
+    std::size_t frames_recovered = 0;
+    std::size_t bytes = 0;
+    std::size_t decrypt_errors = 0;
+  };
+
+  /**
+   * @brief Decrypts and reassembles frames from their video packets like Moonlight, using the parity shards to recover lost ones.
+   * @details Some packets are dropped on arrival to simulate loss.
+   */
+  class receiver_t {
+  public:
+    receiver_t(asio::io_context &io, double loss, std::chrono::steady_clock::time_point epoch):
+        sock { io, asio::ip::udp::endpoint { asio::ip::address_v4::loopback(), 0 } }, loss { loss }, epoch { epoch }, cipher { gcm_key, false } {
+      // Keyframes arrive in bursts of hundreds of shards
+      sock.set_option(asio::socket_base::receive_buffer_size { 8 * 1024 * 1024 });
+    }
+
+    asio::ip::udp::endpoint
+    endpoint() const {
+      return sock.local_endpoint();
+    }
+
+    receiver_stats_t
+    run() {
+      receiver_stats_t stats;
+      std::vector<std::uint8_t> datagram(sizeof(stream::video_packet_enc_prefix_t) + blocksize);
+      std::vector<std::uint8_t> tagged_cipher(crypto::cipher::tag_size + blocksize);
+      std::vector<std::uint8_t> shard;
+
+      while (true) {
+        auto size = sock.receive(asio::buffer(datagram));
+        if (size < sizeof(stream::video_packet_raw_t)) {
+          return stats;
+        }
+
+        if (size != datagram.size() || drop(rng) < loss) {
+          continue;
+        }
+
+        // The GCM tag comes before the ciphertext in the prefix of the packet
+        auto prefix = (stream::video_packet_enc_prefix_t *) datagram.data();
+        crypto::aes_t iv(std::begin(prefix->iv), std::end(prefix->iv));
+        std::copy_n(prefix->tag, crypto::cipher::tag_size, tagged_cipher.data());
+        std::copy_n(datagram.data() + sizeof(*prefix), blocksize, tagged_cipher.data() + crypto::cipher::tag_size);
+        if (cipher.decrypt(std::string_view { (char *) tagged_cipher.data(), tagged_cipher.size() }, shard, &iv) || shard.size() != blocksize) {
+          ++stats.decrypt_errors;
+          continue;
+        }
+
+        auto raw = (stream::video_packet_raw_t *) shard.data();
+        auto frame_index = raw->packet.frameIndex;
+        if (completed.contains(frame_index)) {
+          continue;
+        }
+
+        auto shard_index = (raw->packet.fecInfo >> 12) & 0x3FF;
+        auto data_shards = (raw->packet.fecInfo >> 22) & 0x3FF;
+        auto fec_percentage = (raw->packet.fecInfo >> 4) & 0xFF;
+        auto block_index = (raw->packet.multiFecBlocks >> 4) & 0x3;
+        auto block_count = ((raw->packet.multiFecBlocks >> 6) & 0x3) + 1;
+
+        auto &frame = frames[frame_index];
+        frame.blocks.resize(block_count);
+        frame.timestamp = boost::endian::big_to_native(raw->rtp.timestamp);
+
+        auto &block = frame.blocks[block_index];
+        if (block.done) {
+          continue;
+        }
+        if (block.shards.empty()) {
+          // The number of parity shards isn't sent, Moonlight computes it the same way
+          auto parity_shards = (data_shards * fec_percentage + 99) / 100;
+
+          block.shards.resize(data_shards + parity_shards, std::vector<std::uint8_t>(blocksize));
+          block.marks.resize(data_shards + parity_shards, 1);
+          block.data_shards = data_shards;
+        }
+        if (shard_index >= block.shards.size()) {
+          continue;
+        }
+
+        std::copy_n(shard.data(), blocksize, block.shards[shard_index].data());
+        block.marks[shard_index] = 0;
+
+        if (++block.received < block.data_shards) {
+          continue;
+        }
+
+        // Rebuild the missing data shards from the parity shards, the headers of the packets are
+        // stamped after the parity shards are generated, so only their payload is recovered
+        if (std::any_of(block.marks.begin(), block.marks.begin() + block.data_shards, [](auto mark) { return mark; })) {
+          std::vector<std::uint8_t *> shards_p;
+          for (auto &shard : block.shards) {
+            shards_p.emplace_back(shard.data());
+          }
+
+          auto rs = reed_solomon_new(block.data_shards, block.shards.size() - block.data_shards);
+          reed_solomon_decode(rs, shards_p.data(), block.marks.data(), block.shards.size(), blocksize);
+          reed_solomon_release(rs);
+
+          frame.recovered = true;
+        }
+        block.done = true;
+
+        if (std::all_of(frame.blocks.begin(), frame.blocks.end(), [](auto &block) { return block.done; })) {
+          complete(stats, frame_index);
+        }
+      }
+    }
+
+  private:
+    struct block_t {
+      std::vector<std::vector<std::uint8_t>> shards;
+      std::vector<std::uint8_t> marks;
+      std::size_t data_shards = 0;
+      std::size_t received = 0;
+      bool done = false;
+    };
+
+    struct frame_t {
+      std::vector<block_t> blocks;
+      std::uint32_t timestamp = 0;
+      bool recovered = false;
+    };
+
+    void
+    complete(receiver_stats_t &stats, std::uint32_t frame_index) {
+      auto &frame = frames[frame_index];
+
+      if (frame.timestamp) {
+        auto now = std::chrono::duration_cast<rtp_tick>(std::chrono::steady_clock::now() - epoch).count();
+        stats.latencies_ms.emplace_back((now - frame.timestamp) / 90.0);
+      }
+
+      // The last packet of the frame is padded, its header tells how much of it is the frame
+      auto payload_blocksize = blocksize - sizeof(stream::video_packet_raw_t);
+      std::size_t data_shards = 0;
+      for (auto &block : frame.blocks) {
+        data_shards += block.data_shards;
+      }
+
+      stream::video_short_frame_header_t frame_header;
+      std::memcpy(&frame_header, frame.blocks.front().shards.front().data() + sizeof(stream::video_packet_raw_t), sizeof(frame_header));
+      stats.bytes += data_shards * payload_blocksize - (payload_blocksize - frame_header.lastPayloadLen) - sizeof(frame_header);
+
+      ++stats.frames;
+      stats.frames_recovered += frame.recovered;
+
+      frames.erase(frame_index);
+      completed.emplace(frame_index);
+    }
+
+    asio::ip::udp::socket sock;
+    double loss;
+    std::chrono::steady_clock::time_point epoch;
+    crypto::cipher::gcm_t cipher;
+
+    std::mt19937 rng { 1234 };
+    std::uniform_real_distribution<double> drop { 0.0, 1.0 };
+
+    std::map<std::uint32_t, frame_t> frames;
+    std::set<std::uint32_t> completed;
+  };
+
+  double
+  percentile(std::vector<double> &values, double p) {
+    if (values.empty()) {
+      return 0;
+    }
+
+    std::sort(values.begin(), values.end());
+    return values[std::min<std::size_t>(values.size() * p, values.size() - 1)];
+  }
+
+  /**
+   * @brief Make the video pipeline capture the synthetic display with the software encoder.
+   * @return `true` if the software encoder works.
+   */
+  bool
+  setup_pipeline(pattern_e pattern) {
+    static const bool probed = [&]() {
+      mail::man = std::make_shared<safe::mail_raw_t>();
+      reed_solomon_init();
+
+      config::video.encoder = "software";
+      config::video.probe_cache = false;
+      video::override_displays([](platf::mem_type_e, const std::string &, const video::config_t &) {
+        return std::make_shared<synthetic_display_t>(pattern_e::still);
+      },
+        { "synthetic" });
+
+      return video::probe_encoders() == 0;
+    }();
+
+    // Displays are only created when a stream starts, so the pattern can change between runs
+    video::override_displays([pattern](platf::mem_type_e hwdevice_type, const std::string &display_name, const video::config_t &config) -> std::shared_ptr<platf::display_t> {
+#ifdef __linux__
+      if (pattern == pattern_e::replay) {
+        config::video.replay_file = std::getenv("SUNSHINE_BENCH_REPLAY");
+        config::video.replay_speed = 1.0;
+        return platf::replay_display(hwdevice_type, display_name, config);
+      }
+#endif
+
+      return std::make_shared<synthetic_display_t>(pattern);
+    },
+      { "synthetic" });
+
+    return probed;
+  }
+}  // namespace
+
+/**
+ * @brief Stream the `range(0)` pattern for a few seconds with `range(1)` tenths of a percent of the shards lost.
+ */
+static void
+BM_Loopback(benchmark::State &state) {
+  auto pattern = (pattern_e) state.range(0);
+  auto loss = state.range(1) / 1000.0;
+
+  if (!setup_pipeline(pattern)) {
+    state.SkipWithError("The software encoder doesn't work");
+    return;
+  }
+
+  for (auto _ : state) {
+    asio::io_context io;
+    auto epoch = std::chrono::steady_clock::now();
+    receiver_t receiver { io, loss, epoch };
+    sender_t sender { io, receiver.endpoint(), epoch };
+
+    receiver_stats_t stats;
+    std::thread receive_thread { [&]() {
+      stats = receiver.run();
+    } };
+
+    video::config_t config { frame_width, frame_height, framerate, 20000, 1, 1, 0, 0, 0, 0, 0 };
+    auto mail = std::make_shared<safe::mail_raw_t>();
+    std::thread capture_thread { [&]() {
+      video::capture(mail, config, nullptr);
+    } };
+
+    auto packets = mail::man->queue<video::packet_t>(mail::video_packets);
+    auto start = std::chrono::steady_clock::now();
+    std::size_t frames_sent = 0;
+
+    while (std::chrono::steady_clock::now() - start < stream_duration) {
+      if (auto packet = packets->pop(100ms)) {
+        sender.send_frame(**packet);
+        ++frames_sent;
+      }
+    }
+
+    mail->event<bool>(mail::shutdown)->raise(true);
+    capture_thread.join();
+
+    // Drop the frames encoded after the measurement ended
+    while (packets->pop(0ms)) {}
+
+    sender.send_end_of_stream();
+    receive_thread.join();
+
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    state.counters["latency_p50_ms"] = percentile(stats.latencies_ms, 0.50);
+    state.counters["latency_p99_ms"] = percentile(stats.latencies_ms, 0.99);
+    state.counters["latency_max_ms"] = percentile(stats.latencies_ms, 1.0);
+    state.counters["throughput_Mbps"] = stats.bytes * 8 / seconds / 1e6;
+    state.counters["frames"] = stats.frames;
+    state.counters["frames_lost"] = frames_sent - stats.frames;
+    state.counters["frames_recovered"] = stats.frames_recovered;
+    state.counters["decrypt_errors"] = stats.decrypt_errors;
+  }
+}
+
+/**
+ * @brief Stream the synthetic patterns, and the recording named by SUNSHINE_BENCH_REPLAY when it's set.
+ */
+static void
+loopback_args(benchmark::internal::Benchmark *benchmark) {
+  std::vector<std::int64_t> patterns { (int) pattern_e::still, (int) pattern_e::motion };
+#ifdef __linux__
+  if (std::getenv("SUNSHINE_BENCH_REPLAY")) {
+    patterns.emplace_back((int) pattern_e::replay);
+  }
+#endif
+
+  benchmark->ArgsProduct({ patterns, { 0, 10, 50 } });
+}
+
+BENCHMARK(BM_Loopback)
+  ->ArgNames({ "pattern", "loss_permille" })
+  ->Apply(loopback_args)
+  ->Iterations(1)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
@@ -0,0 +1,23 @@
+/**
+ * @file benchmarks/bench_main.cpp
+ * @brief Entry point definition for the benchmarks.
+ */
+#include <benchmark/benchmark.h>
+
+#include <src/logging.h>
+
+int
+main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+
+  // Only warnings and errors, logging from the hot paths would skew the results
+  auto deinit_log = logging::init(3, "sunshine_bench.log", false);
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return 0;
+}
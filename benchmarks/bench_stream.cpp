@@ -0,0 +1,98 @@
+/**
+ * @file benchmarks/bench_stream.cpp
+ * @brief Benchmarks for the packetization in src/stream.*
+ */
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+#include <string_view>
+#include <vector>
+
+extern "C" {
+#include <src/rswrapper.h>
+}
+
+#include <src/stream.h>
+
+namespace stream {
+  std::vector<uint8_t>
+  concat_and_insert(uint64_t insert_size, uint64_t slice_size, const std::string_view &data1, const std::string_view &data2);
+
+  std::vector<uint8_t>
+  replace(const std::string_view &original, const std::string_view &old, const std::string_view &_new);
+}  // namespace stream
+
+namespace {
+  // Default packet size requested by Moonlight, plus room for the RTP header
+  constexpr std::size_t blocksize = 1392 + 16;
+
+  std::vector<char>
+  random_payload(std::size_t size) {
+    std::mt19937 rng { 1234 };
+
+    std::vector<char> payload(size);
+    for (auto &byte : payload) {
+      byte = (char) rng();
+    }
+
+    return payload;
+  }
+}  // namespace
+
+/**
+ * @brief Encode a FEC block of `range(0)` data shards with 20% parity, the last shard being short.
+ */
+static void
+BM_FecEncode(benchmark::State &state) {
+  reed_solomon_init();
+
+  auto payload = random_payload(state.range(0) * blocksize - blocksize / 2);
+  std::string_view view { payload.data(), payload.size() };
+
+  for (auto _ : state) {
+    auto shards = stream::fec::encode(view, blocksize, 20, 2, 0);
+    benchmark::DoNotOptimize(shards.shards_p.begin());
+  }
+
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_FecEncode)->Arg(8)->Arg(64)->Arg(212);
+
+/**
+ * @brief Insert a packet header in front of every shard of a `range(0)` byte frame.
+ */
+static void
+BM_ConcatAndInsert(benchmark::State &state) {
+  auto payload = random_payload(state.range(0));
+  char frame_header[8] {};
+
+  for (auto _ : state) {
+    auto result = stream::concat_and_insert(32, blocksize - 32, std::string_view { frame_header, sizeof(frame_header) }, std::string_view { payload.data(), payload.size() });
+    benchmark::DoNotOptimize(result.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_ConcatAndInsert)->Arg(16 * 1024)->Arg(256 * 1024);
+
+/**
+ * @brief Replace the SPS of an IDR frame of `range(0)` bytes.
+ */
+static void
+BM_Replace(benchmark::State &state) {
+  auto payload = random_payload(state.range(0));
+
+  // The parameter sets lead the frame
+  const char sps[] = "\x00\x00\x00\x01\x67\x64\x00\x33\xac\x2b\x40\x28\x02\xdd";
+  const char new_sps[] = "\x00\x00\x00\x01\x67\x64\x00\x33\xac\x2b\x40\x28\x02\xdd\x08\x00\x00\x03\x00\x08";
+  std::copy_n(sps, sizeof(sps) - 1, payload.begin());
+
+  for (auto _ : state) {
+    auto result = stream::replace(std::string_view { payload.data(), payload.size() }, std::string_view { sps, sizeof(sps) - 1 }, std::string_view { new_sps, sizeof(new_sps) - 1 });
+    benchmark::DoNotOptimize(result.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_Replace)->Arg(16 * 1024)->Arg(256 * 1024);
@@ -0,0 +1,85 @@
+/**
+ * @file benchmarks/bench_thread_safe.cpp
+ * @brief Benchmarks for the handoff between threads in src/thread_safe.h and src/task_pool.h
+ */
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <src/task_pool.h>
+#include <src/thread_safe.h>
+
+using namespace std::literals;
+
+/**
+ * @brief Round trip of a value through a pair of queues, like a captured image to the encode thread.
+ */
+static void
+BM_QueueHandoff(benchmark::State &state) {
+  safe::queue_t<int> request;
+  safe::queue_t<int> response;
+
+  std::thread echo { [&]() {
+    while (auto value = request.pop()) {
+      response.raise(*value);
+    }
+  } };
+
+  for (auto _ : state) {
+    request.raise(1);
+    benchmark::DoNotOptimize(response.pop());
+  }
+
+  request.stop();
+  echo.join();
+}
+BENCHMARK(BM_QueueHandoff)->UseRealTime();
+
+/**
+ * @brief Round trip of a value through a pair of events, like an IDR request to the encode thread.
+ */
+static void
+BM_EventHandoff(benchmark::State &state) {
+  safe::event_t<int> request;
+  safe::event_t<int> response;
+
+  std::thread echo { [&]() {
+    while (auto value = request.pop()) {
+      response.raise(*value);
+    }
+  } };
+
+  for (auto _ : state) {
+    request.raise(1);
+    benchmark::DoNotOptimize(response.pop());
+  }
+
+  request.stop();
+  echo.join();
+}
+BENCHMARK(BM_EventHandoff)->UseRealTime();
+
+/**
+ * @brief Schedule and cancel a timer while `range(0)` other timers are pending.
+ */
+static void
+BM_TaskPoolTimer(benchmark::State &state) {
+  task_pool_util::TaskPool pool;
+
+  std::vector<task_pool_util::TaskPool::task_id_t> pending;
+  for (int x = 0; x < state.range(0); ++x) {
+    pending.emplace_back(pool.pushDelayed([]() {}, 1h + x * 1ms).task_id);
+  }
+
+  for (auto _ : state) {
+    auto timer = pool.pushDelayed([]() {}, 30min);
+    benchmark::DoNotOptimize(pool.cancel(timer.task_id));
+  }
+
+  for (auto task_id : pending) {
+    pool.cancel(task_id);
+  }
+}
+BENCHMARK(BM_TaskPoolTimer)->Arg(0)->Arg(16)->Arg(256);
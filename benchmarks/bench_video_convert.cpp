@@ -0,0 +1,43 @@
+/**
+ * @file benchmarks/bench_video_convert.cpp
+ * @brief Benchmarks for the software encoder's color conversion in src/video_convert.*
+ */
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <src/video_convert.h>
+
+/**
+ * @brief Convert a 1080p BGR0 image to NV12 or YUV420P with `range(0)` threads.
+ */
+static void
+BM_Convert(benchmark::State &state, AVPixelFormat format, bool simd) {
+  constexpr int width = 1920;
+  constexpr int height = 1080;
+
+  auto converter = video::bgr0_converter_t::make(format, state.range(0), simd);
+  if (!converter) {
+    state.SkipWithError("Unsupported format");
+    return;
+  }
+
+  std::vector<std::uint8_t> image(width * height * 4, 0x80);
+  std::vector<std::uint8_t> luma(width * height);
+  std::vector<std::uint8_t> chroma(width * height / 2);
+
+  // The chroma of YUV420P is planar, NV12 interleaves it in a single plane
+  std::uint8_t *dst[4] { luma.data(), chroma.data(), chroma.data() + chroma.size() / 2, nullptr };
+  int dst_linesize[4] { width, format == AV_PIX_FMT_NV12 ? width : width / 2, width / 2, 0 };
+
+  for (auto _ : state) {
+    converter->convert(image.data(), width * 4, width, height, dst, dst_linesize);
+    benchmark::ClobberMemory();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_Convert, nv12_scalar, AV_PIX_FMT_NV12, false)->Arg(1)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Convert, nv12_simd, AV_PIX_FMT_NV12, true)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Convert, yuv420p_simd, AV_PIX_FMT_YUV420P, true)->Arg(1)->Arg(4)->UseRealTime();
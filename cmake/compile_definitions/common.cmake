@@ -75,6 +75,10 @@ set(SUNSHINE_TARGET_FILES
         "${CMAKE_SOURCE_DIR}/src/uuid.h"
         "${CMAKE_SOURCE_DIR}/src/config.h"
         "${CMAKE_SOURCE_DIR}/src/config.cpp"
+        "${CMAKE_SOURCE_DIR}/src/cursor_blend.cpp"
+        "${CMAKE_SOURCE_DIR}/src/cursor_blend.h"
+        "${CMAKE_SOURCE_DIR}/src/encoder_probe_cache.cpp"
+        "${CMAKE_SOURCE_DIR}/src/encoder_probe_cache.h"
         "${CMAKE_SOURCE_DIR}/src/entry_handler.cpp"
         "${CMAKE_SOURCE_DIR}/src/entry_handler.h"
         "${CMAKE_SOURCE_DIR}/src/file_handler.cpp"
@@ -83,6 +87,10 @@ set(SUNSHINE_TARGET_FILES
         "${CMAKE_SOURCE_DIR}/src/globals.h"
         "${CMAKE_SOURCE_DIR}/src/logging.cpp"
         "${CMAKE_SOURCE_DIR}/src/logging.h"
+        "${CMAKE_SOURCE_DIR}/src/log_tail.cpp"
+        "${CMAKE_SOURCE_DIR}/src/log_tail.h"
+        "${CMAKE_SOURCE_DIR}/src/binary_log.cpp"
+        "${CMAKE_SOURCE_DIR}/src/binary_log.h"
         "${CMAKE_SOURCE_DIR}/src/main.cpp"
         "${CMAKE_SOURCE_DIR}/src/main.h"
         "${CMAKE_SOURCE_DIR}/src/crypto.cpp"
@@ -93,14 +101,21 @@ set(SUNSHINE_TARGET_FILES
         "${CMAKE_SOURCE_DIR}/src/httpcommon.h"
         "${CMAKE_SOURCE_DIR}/src/confighttp.cpp"
         "${CMAKE_SOURCE_DIR}/src/confighttp.h"
+        "${CMAKE_SOURCE_DIR}/src/asset_cache.cpp"
+        "${CMAKE_SOURCE_DIR}/src/asset_cache.h"
         "${CMAKE_SOURCE_DIR}/src/rtsp.cpp"
         "${CMAKE_SOURCE_DIR}/src/rtsp.h"
         "${CMAKE_SOURCE_DIR}/src/stream.cpp"
         "${CMAKE_SOURCE_DIR}/src/stream.h"
+        "${CMAKE_SOURCE_DIR}/src/stream_packets.h"
         "${CMAKE_SOURCE_DIR}/src/video.cpp"
         "${CMAKE_SOURCE_DIR}/src/video.h"
         "${CMAKE_SOURCE_DIR}/src/video_colorspace.cpp"
         "${CMAKE_SOURCE_DIR}/src/video_colorspace.h"
+        "${CMAKE_SOURCE_DIR}/src/video_convert.cpp"
+        "${CMAKE_SOURCE_DIR}/src/video_convert.h"
+        "${CMAKE_SOURCE_DIR}/src/frame_fingerprint.cpp"
+        "${CMAKE_SOURCE_DIR}/src/frame_fingerprint.h"
         "${CMAKE_SOURCE_DIR}/src/input.cpp"
         "${CMAKE_SOURCE_DIR}/src/input.h"
         "${CMAKE_SOURCE_DIR}/src/audio.cpp"
@@ -122,6 +137,12 @@ set(SUNSHINE_TARGET_FILES
         "${CMAKE_SOURCE_DIR}/src/round_robin.h"
         "${CMAKE_SOURCE_DIR}/src/stat_trackers.h"
         "${CMAKE_SOURCE_DIR}/src/stat_trackers.cpp"
+        "${CMAKE_SOURCE_DIR}/src/trace.h"
+        "${CMAKE_SOURCE_DIR}/src/trace.cpp"
+        "${CMAKE_SOURCE_DIR}/src/metrics.h"
+        "${CMAKE_SOURCE_DIR}/src/metrics.cpp"
+        "${CMAKE_SOURCE_DIR}/src/flight_recorder.h"
+        "${CMAKE_SOURCE_DIR}/src/flight_recorder.cpp"
         "${CMAKE_SOURCE_DIR}/src/rswrapper.h"
         "${CMAKE_SOURCE_DIR}/src/rswrapper.c"
         ${PLATFORM_TARGET_FILES})
@@ -133,6 +154,10 @@ list(APPEND SUNSHINE_DEFINITIONS SUNSHINE_ASSETS_DIR="${SUNSHINE_ASSETS_DIR_DEF}
 
 list(APPEND SUNSHINE_DEFINITIONS SUNSHINE_TRAY=${SUNSHINE_TRAY})
 
+if(NOT SUNSHINE_LOG_MIN_LEVEL STREQUAL "")
+    list(APPEND SUNSHINE_DEFINITIONS SUNSHINE_LOG_MIN_LEVEL=${SUNSHINE_LOG_MIN_LEVEL})
+endif()
+
 # Publisher metadata - escape spaces for proper compilation
 string(REPLACE " " "_" SUNSHINE_PUBLISHER_NAME_SAFE "${SUNSHINE_PUBLISHER_NAME}")
 list(APPEND SUNSHINE_DEFINITIONS SUNSHINE_PUBLISHER_NAME="${SUNSHINE_PUBLISHER_NAME_SAFE}")
@@ -111,6 +111,7 @@ function add_debain_based_deps() {
     "libxcb-shm0-dev"  # X11
     "libxcb-xfixes0-dev"  # X11
     "libxcb1-dev"  # X11
+    "libxdamage-dev"  # X11
     "libxfixes-dev"  # X11
     "libxrandr-dev"  # X11
     "libxtst-dev"  # X11
@@ -164,6 +165,7 @@ function add_fedora_deps() {
     "libX11-devel"  # X11
     "libxcb-devel"  # X11
     "libXcursor-devel"  # X11
+    "libXdamage-devel"  # X11
     "libXfixes-devel"  # X11
     "libXi-devel"  # X11
     "libXinerama-devel"  # X11
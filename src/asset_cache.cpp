@@ -0,0 +1,321 @@
+/**
+ * @file src/asset_cache.cpp
+ * @brief Definitions for the cache of the Web UI files.
+ */
+#include "asset_cache.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std::literals;
+
+namespace asset_cache {
+  namespace fs = std::filesystem;
+
+  namespace {
+    struct entry_t {
+      std::shared_ptr<const asset_t> asset;
+      std::chrono::steady_clock::time_point checked;
+    };
+
+    std::mutex cache_mutex;
+    std::unordered_map<std::string, entry_t> cache;
+
+    std::optional<std::string>
+    read_file(const fs::path &path) {
+      std::ifstream in { path, std::ios::binary };
+      if (!in) {
+        return std::nullopt;
+      }
+
+      return std::string { std::istreambuf_iterator<char> { in }, std::istreambuf_iterator<char> {} };
+    }
+
+    /**
+     * The variant is only used if it was compressed from the current file, and compressing made it smaller.
+     */
+    std::optional<std::string>
+    read_variant(const fs::path &path, std::string_view extension, fs::file_time_type mtime, std::uintmax_t size) {
+      auto variant = path;
+      variant += extension;
+
+      std::error_code ec;
+      auto variant_size = fs::file_size(variant, ec);
+      if (ec || variant_size >= size || variant_size > max_cached_size) {
+        return std::nullopt;
+      }
+
+      auto variant_mtime = fs::last_write_time(variant, ec);
+      if (ec || variant_mtime < mtime) {
+        return std::nullopt;
+      }
+
+      return read_file(variant);
+    }
+
+    std::shared_ptr<const asset_t>
+    load(const fs::path &path, fs::file_time_type mtime, std::uintmax_t size) {
+      auto asset = std::make_shared<asset_t>();
+      asset->path = path;
+      asset->mtime = mtime;
+      asset->size = size;
+      asset->last_modified = http_date(std::chrono::file_clock::to_sys(mtime));
+
+      if (size <= max_cached_size) {
+        asset->identity = read_file(path);
+        if (!asset->identity) {
+          return nullptr;
+        }
+      }
+
+      asset->gzip = read_variant(path, ".gz"sv, mtime, size);
+      asset->br = read_variant(path, ".br"sv, mtime, size);
+
+      return asset;
+    }
+
+    /**
+     * @return The q-value of an encoding in an Accept-Encoding header, 0 if it isn't accepted.
+     */
+    double
+    quality(std::string_view accept_encoding, std::string_view encoding) {
+      std::optional<double> any;
+      while (!accept_encoding.empty()) {
+        auto end = accept_encoding.find(',');
+        auto item = accept_encoding.substr(0, end);
+        accept_encoding.remove_prefix(end == std::string_view::npos ? accept_encoding.size() : end + 1);
+
+        auto params = item.find(';');
+        auto name = item.substr(0, params);
+        while (!name.empty() && name.front() == ' ') {
+          name.remove_prefix(1);
+        }
+        while (!name.empty() && name.back() == ' ') {
+          name.remove_suffix(1);
+        }
+
+        double q = 1;
+        if (params != std::string_view::npos) {
+          auto q_pos = item.find("q="sv, params);
+          if (q_pos != std::string_view::npos) {
+            auto value = item.substr(q_pos + 2);
+            std::from_chars(value.data(), value.data() + value.size(), q);
+          }
+        }
+
+        auto equals = std::equal(std::begin(name), std::end(name), std::begin(encoding), std::end(encoding), [](char a, char b) {
+          return std::tolower((unsigned char) a) == b;
+        });
+        if (equals) {
+          return q;
+        }
+        if (name == "*"sv) {
+          any = q;
+        }
+      }
+
+      return any.value_or(0);
+    }
+  }  // namespace
+
+  std::shared_ptr<const asset_t>
+  get(const fs::path &path) {
+    auto key = path.string();
+    auto now = std::chrono::steady_clock::now();
+
+    std::shared_ptr<const asset_t> cached;
+    {
+      std::lock_guard lg { cache_mutex };
+
+      auto it = cache.find(key);
+      if (it != std::end(cache)) {
+        if (now - it->second.checked < recheck_interval) {
+          return it->second.asset;
+        }
+
+        cached = it->second.asset;
+      }
+    }
+
+    std::error_code ec;
+    auto status = fs::status(path, ec);
+    if (ec || !fs::is_regular_file(status)) {
+      std::lock_guard lg { cache_mutex };
+      cache.erase(key);
+
+      return nullptr;
+    }
+
+    auto mtime = fs::last_write_time(path, ec);
+    auto size = fs::file_size(path, ec);
+    if (ec) {
+      return nullptr;
+    }
+
+    // Files are loaded outside the lock, other files are served meanwhile
+    auto asset = cached && cached->mtime == mtime && cached->size == size ? cached : load(path, mtime, size);
+
+    std::lock_guard lg { cache_mutex };
+    if (asset) {
+      cache[key] = { asset, now };
+    }
+    else {
+      cache.erase(key);
+    }
+
+    return asset;
+  }
+
+  void
+  clear() {
+    std::lock_guard lg { cache_mutex };
+    cache.clear();
+  }
+
+  encoding_e
+  negotiate(const asset_t &asset, std::string_view accept_encoding) {
+    // Brotli files are the smallest, when the client accepts both
+    if (asset.br && quality(accept_encoding, "br"sv) > 0) {
+      return encoding_e::br;
+    }
+    if (asset.gzip && quality(accept_encoding, "gzip"sv) > 0) {
+      return encoding_e::gzip;
+    }
+
+    return encoding_e::identity;
+  }
+
+  const std::string *
+  body(const asset_t &asset, encoding_e encoding) {
+    const std::optional<std::string> *variant;
+    switch (encoding) {
+      case encoding_e::gzip:
+        variant = &asset.gzip;
+        break;
+      case encoding_e::br:
+        variant = &asset.br;
+        break;
+      default:
+        variant = &asset.identity;
+        break;
+    }
+
+    return *variant ? &**variant : nullptr;
+  }
+
+  std::string_view
+  content_encoding(encoding_e encoding) {
+    switch (encoding) {
+      case encoding_e::gzip:
+        return "gzip"sv;
+      case encoding_e::br:
+        return "br"sv;
+      default:
+        return {};
+    }
+  }
+
+  std::string
+  etag(const asset_t &asset, encoding_e encoding) {
+    char buffer[64];
+    auto end = std::to_chars(std::begin(buffer), std::end(buffer), asset.size, 16).ptr;
+    *end++ = '-';
+    end = std::to_chars(end, std::end(buffer), (std::uint64_t) asset.mtime.time_since_epoch().count(), 16).ptr;
+
+    std::string tag;
+    tag.reserve(32);
+    tag += '"';
+    tag.append(buffer, end);
+    if (encoding != encoding_e::identity) {
+      tag += '-';
+      tag += content_encoding(encoding);
+    }
+    tag += '"';
+
+    return tag;
+  }
+
+  bool
+  not_modified(std::string_view etag, std::string_view last_modified, std::optional<std::string_view> if_none_match, std::optional<std::string_view> if_modified_since) {
+    if (if_none_match) {
+      auto tags = *if_none_match;
+      while (!tags.empty()) {
+        auto end = tags.find(',');
+        auto tag = tags.substr(0, end);
+        tags.remove_prefix(end == std::string_view::npos ? tags.size() : end + 1);
+
+        while (!tag.empty() && tag.front() == ' ') {
+          tag.remove_prefix(1);
+        }
+        while (!tag.empty() && tag.back() == ' ') {
+          tag.remove_suffix(1);
+        }
+
+        // Weak comparison, it's only used for GET
+        if (tag.starts_with("W/"sv)) {
+          tag.remove_prefix(2);
+        }
+
+        if (tag == "*"sv || tag == etag) {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    // Clients send back the Last-Modified they received, any other date is treated as a change
+    return if_modified_since && *if_modified_since == last_modified;
+  }
+
+  bool
+  is_fingerprinted(const fs::path &path) {
+    // Vite writes "[name]-[hash].[ext]", the hash has 8 characters of base64url
+    constexpr std::size_t hash_size = 8;
+
+    auto stem = path.stem().string();
+    if (stem.size() <= hash_size + 1 || stem[stem.size() - hash_size - 1] != '-') {
+      return false;
+    }
+
+    auto hash = std::string_view { stem }.substr(stem.size() - hash_size);
+    auto is_hash_char = [](char ch) {
+      return std::isalnum((unsigned char) ch) || ch == '-' || ch == '_';
+    };
+    auto is_distinct = [](char ch) {
+      return std::isdigit((unsigned char) ch) || std::isupper((unsigned char) ch);
+    };
+
+    return std::all_of(std::begin(hash), std::end(hash), is_hash_char) && std::any_of(std::begin(hash), std::end(hash), is_distinct);
+  }
+
+  std::string
+  http_date(std::chrono::system_clock::time_point time) {
+    static constexpr std::array weekdays { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static constexpr std::array months { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+    auto days = std::chrono::floor<std::chrono::days>(time);
+    std::chrono::year_month_day date { days };
+    std::chrono::weekday weekday { days };
+    std::chrono::hh_mm_ss clock { std::chrono::floor<std::chrono::seconds>(time - days) };
+
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%s, %02u %s %04d %02d:%02d:%02d GMT",
+      weekdays[weekday.c_encoding()],
+      (unsigned) date.day(),
+      months[(unsigned) date.month() - 1],
+      (int) date.year(),
+      (int) clock.hours().count(),
+      (int) clock.minutes().count(),
+      (int) clock.seconds().count());
+
+    return buffer;
+  }
+}  // namespace asset_cache
@@ -0,0 +1,116 @@
+/**
+ * @file src/asset_cache.h
+ * @brief Declarations for the cache of the Web UI files.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Keeps the files of the Web UI in memory, with the variants that were compressed when the Web UI was built.
+ */
+namespace asset_cache {
+  // Larger files are read from disk on every request, their compressed variants are still kept
+  constexpr std::uintmax_t max_cached_size = 1 << 20;
+
+  // A cached file is checked for changes at most this often
+  constexpr std::chrono::seconds recheck_interval { 1 };
+
+  enum class encoding_e {
+    identity,
+    gzip,
+    br,
+  };
+
+  struct asset_t {
+    std::filesystem::path path;
+    std::filesystem::file_time_type mtime;
+    std::uintmax_t size;
+
+    std::string last_modified;  ///< The modification time as an HTTP date
+
+    std::optional<std::string> identity;  ///< The file, std::nullopt if it's larger than max_cached_size
+    std::optional<std::string> gzip;  ///< The .gz file next to it, if it's up to date and smaller
+    std::optional<std::string> br;  ///< The .br file next to it, if it's up to date and smaller
+  };
+
+  /**
+   * @brief Get a file, it's loaded on first use and reloaded once it changed.
+   * @param path The file.
+   * @return The file, or nullptr if it isn't a regular file.
+   */
+  std::shared_ptr<const asset_t>
+  get(const std::filesystem::path &path);
+
+  /**
+   * @brief Forget all files.
+   */
+  void
+  clear();
+
+  /**
+   * @brief Pick the smallest variant the client accepts.
+   * @param asset The file.
+   * @param accept_encoding The value of the Accept-Encoding header.
+   * @return The encoding to send.
+   */
+  encoding_e
+  negotiate(const asset_t &asset, std::string_view accept_encoding);
+
+  /**
+   * @brief Get the body of a variant.
+   * @return The body, or nullptr if the file has to be read from disk.
+   */
+  const std::string *
+  body(const asset_t &asset, encoding_e encoding);
+
+  /**
+   * @brief Get the value of the Content-Encoding header of a variant.
+   * @return The value, or an empty string for the identity.
+   */
+  std::string_view
+  content_encoding(encoding_e encoding);
+
+  /**
+   * @brief Get the entity tag of a variant, every variant has its own.
+   * @return The quoted tag, e.g. "\"1f2-18c2b7e5a1b3c000-br\"".
+   */
+  std::string
+  etag(const asset_t &asset, encoding_e encoding);
+
+  /**
+   * @brief Check if the client already has the variant.
+   * @param etag The entity tag of the variant.
+   * @param last_modified The modification time of the file as an HTTP date.
+   * @param if_none_match The value of the If-None-Match header.
+   * @param if_modified_since The value of the If-Modified-Since header, only used without If-None-Match.
+   * @return true if the response is 304 Not Modified.
+   */
+  bool
+  not_modified(std::string_view etag, std::string_view last_modified, std::optional<std::string_view> if_none_match, std::optional<std::string_view> if_modified_since);
+
+  /**
+   * @brief Check if the name of a file contains a hash of its content, like the files Vite writes, e.g. "index-4f2a9B_c.js".
+   * @details Only these files can be cached forever, a new build gives changed files a new name.
+   * A hash without a digit or an uppercase letter isn't told apart from a word, these files are revalidated like the others.
+   * @param path The file.
+   * @return true if the name ends with a dash and 8 characters of a hash before the extension.
+   */
+  bool
+  is_fingerprinted(const std::filesystem::path &path);
+
+  /**
+   * @brief Format a time as an HTTP date.
+   * @examples
+   * http_date(time) == "Sun, 06 Nov 1994 08:49:37 GMT"
+   * @examples_end
+   */
+  std::string
+  http_date(std::chrono::system_clock::time_point time);
+}  // namespace asset_cache
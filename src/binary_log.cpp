@@ -0,0 +1,330 @@
+/**
+ * @file src/binary_log.cpp
+ * @brief Definitions for the binary log of the hot paths.
+ */
+#include "binary_log.h"
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace std::literals;
+
+namespace binary_log {
+  std::atomic<int> min_level { std::numeric_limits<int>::max() };
+
+  namespace {
+    // Seconds of per-packet records of a streaming thread at the verbose level
+    constexpr std::size_t ring_bytes = 1 << 18;
+
+    // Lines are written at least this often, and on flush()
+    constexpr auto batch_interval = 50ms;
+
+    struct format_t {
+      int level;
+      std::string text;
+    };
+
+    // Also held while records are formatted, call sites only register once
+    std::mutex formats_mutex;
+    std::vector<format_t> formats;
+
+    /**
+     * A ring of records with a single writer, the thread that owns it, and a single reader, the formatter.
+     * Positions only grow, the ring wraps around at ring_bytes.
+     */
+    struct ring_t {
+      std::unique_ptr<std::byte[]> data { std::make_unique<std::byte[]>(ring_bytes) };
+
+      std::atomic<std::uint64_t> head {};
+      std::atomic<std::uint64_t> tail {};
+
+      std::atomic<std::uint64_t> dropped {};
+      std::atomic_bool exited {};
+    };
+
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<ring_t>> rings;
+
+    struct thread_ring_t {
+      ~thread_ring_t() {
+        if (ring) {
+          ring->exited = true;
+        }
+      }
+
+      std::shared_ptr<ring_t> ring;
+    };
+
+    thread_local thread_ring_t thread_ring;
+
+    std::mutex state_mutex;
+    std::condition_variable state_cv;
+    std::thread formatter;
+    writer_t writer;
+    bool running {};
+    bool stopping {};
+    std::uint64_t flush_requested {};
+    std::uint64_t flush_completed {};
+
+    /**
+     * Rings are only allocated for threads that log through BINARY_LOG().
+     */
+    ring_t &
+    current_ring() {
+      if (!thread_ring.ring) {
+        auto ring = std::make_shared<ring_t>();
+
+        std::lock_guard lg { rings_mutex };
+        rings.emplace_back(ring);
+
+        thread_ring.ring = std::move(ring);
+      }
+
+      return *thread_ring.ring;
+    }
+
+    void
+    read(const ring_t &ring, std::uint64_t position, void *dest, std::size_t size) {
+      auto offset = position % ring_bytes;
+      auto first = std::min(size, ring_bytes - offset);
+
+      std::memcpy(dest, ring.data.get() + offset, first);
+      std::memcpy((std::byte *) dest + first, ring.data.get(), size - first);
+    }
+
+    template <typename T>
+    T
+    take(const std::byte *&data) {
+      T value;
+      std::memcpy(&value, data, sizeof(value));
+      data += sizeof(value);
+
+      return value;
+    }
+
+    void
+    append_arg(std::string &out, const std::byte *&data, const std::byte *end) {
+      if (data == end) {
+        return;
+      }
+
+      char number[32];
+      std::to_chars_result result;
+      switch (take<arg_e>(data)) {
+        case arg_e::i64:
+          result = std::to_chars(std::begin(number), std::end(number), take<std::int64_t>(data));
+          break;
+        case arg_e::u64:
+          result = std::to_chars(std::begin(number), std::end(number), take<std::uint64_t>(data));
+          break;
+        case arg_e::f64:
+          // Same as streaming a double
+          result = std::to_chars(std::begin(number), std::end(number), take<double>(data), std::chars_format::general, 6);
+          break;
+        case arg_e::str: {
+          auto length = take<std::uint16_t>(data);
+          out.append((const char *) data, length);
+          data += length;
+          return;
+        }
+      }
+
+      out.append(number, result.ptr);
+    }
+
+    line_t
+    format_record(const std::byte *record) {
+      auto header = take<detail::header_t>(record);
+      auto end = record + header.size - sizeof(header);
+
+      auto &format = formats[header.format & ~detail::truncated_flag];
+
+      line_t line {
+        .level = format.level,
+        .time = clock::time_point { clock::duration { header.time } },
+      };
+      line.message.reserve(format.text.size() + 32);
+
+      std::string_view text = format.text;
+      for (auto pos = text.find("{}"sv); pos != std::string_view::npos; pos = text.find("{}"sv)) {
+        line.message.append(text.substr(0, pos));
+        append_arg(line.message, record, end);
+        text.remove_prefix(pos + 2);
+      }
+      line.message.append(text);
+
+      if (header.format & detail::truncated_flag) {
+        line.message.append(" [truncated, the arguments exceed "sv);
+        line.message.append(std::to_string(max_record_size));
+        line.message.append(" bytes]"sv);
+      }
+
+      return line;
+    }
+
+    /**
+     * Format everything in the rings, and write it in a single batch.
+     */
+    void
+    drain() {
+      std::vector<std::shared_ptr<ring_t>> current;
+      {
+        std::lock_guard lg { rings_mutex };
+        current = rings;
+      }
+
+      std::vector<line_t> lines;
+      {
+        std::lock_guard lg { formats_mutex };
+
+        std::vector<std::byte> record;
+        for (auto &ring : current) {
+          auto tail = ring->tail.load(std::memory_order_relaxed);
+          auto head = ring->head.load(std::memory_order_acquire);
+
+          while (tail < head) {
+            detail::header_t header;
+            read(*ring, tail, &header, sizeof(header));
+
+            record.resize(header.size);
+            read(*ring, tail, record.data(), header.size);
+            lines.emplace_back(format_record(record.data()));
+
+            tail += header.size;
+          }
+
+          ring->tail.store(tail, std::memory_order_release);
+
+          if (auto dropped = ring->dropped.exchange(0, std::memory_order_relaxed)) {
+            lines.push_back({
+              .level = level::warning,
+              .time = clock::now(),
+              .message = "Dropped "s + std::to_string(dropped) + " log records, logging is faster than the log can be written"s,
+            });
+          }
+        }
+      }
+
+      // Threads only exit after their last record was committed
+      {
+        std::lock_guard lg { rings_mutex };
+        std::erase_if(rings, [](const std::shared_ptr<ring_t> &ring) {
+          return ring->exited && ring->tail.load(std::memory_order_relaxed) == ring->head.load(std::memory_order_relaxed);
+        });
+      }
+
+      if (lines.empty()) {
+        return;
+      }
+
+      // Records of different threads interleave
+      std::stable_sort(std::begin(lines), std::end(lines), [](const line_t &a, const line_t &b) {
+        return a.time < b.time;
+      });
+
+      writer(lines);
+    }
+
+    void
+    run() {
+      std::unique_lock ul { state_mutex };
+      while (true) {
+        state_cv.wait_for(ul, batch_interval, []() {
+          return stopping || flush_requested > flush_completed;
+        });
+
+        auto requested = flush_requested;
+        auto stop = stopping;
+
+        ul.unlock();
+        drain();
+        ul.lock();
+
+        flush_completed = requested;
+        state_cv.notify_all();
+
+        if (stop) {
+          running = false;
+          break;
+        }
+      }
+    }
+  }  // namespace
+
+  std::uint32_t
+  register_format(int level, std::string_view format) {
+    std::lock_guard lg { formats_mutex };
+
+    formats.push_back({ level, std::string { format } });
+    return (std::uint32_t) formats.size() - 1;
+  }
+
+  void
+  commit(std::span<const std::byte> record) {
+    auto &ring = current_ring();
+
+    auto head = ring.head.load(std::memory_order_relaxed);
+    auto tail = ring.tail.load(std::memory_order_acquire);
+    if (ring_bytes - (head - tail) < record.size()) {
+      ring.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    auto offset = head % ring_bytes;
+    auto first = std::min(record.size(), ring_bytes - offset);
+
+    std::memcpy(ring.data.get() + offset, record.data(), first);
+    std::memcpy(ring.data.get(), record.data() + first, record.size() - first);
+
+    ring.head.store(head + record.size(), std::memory_order_release);
+  }
+
+  void
+  start(writer_t new_writer, int level) {
+    stop();
+
+    writer = std::move(new_writer);
+    running = true;
+    formatter = std::thread { run };
+
+    min_level = level;
+  }
+
+  void
+  flush() {
+    std::unique_lock ul { state_mutex };
+    if (!running) {
+      return;
+    }
+
+    auto requested = ++flush_requested;
+    state_cv.notify_all();
+    state_cv.wait(ul, [requested]() {
+      return flush_completed >= requested || !running;
+    });
+  }
+
+  void
+  stop() {
+    if (!formatter.joinable()) {
+      return;
+    }
+
+    min_level = std::numeric_limits<int>::max();
+
+    {
+      std::lock_guard lg { state_mutex };
+      stopping = true;
+    }
+    state_cv.notify_all();
+    formatter.join();
+
+    stopping = false;
+    writer = nullptr;
+  }
+}  // namespace binary_log
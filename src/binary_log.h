@@ -0,0 +1,291 @@
+/**
+ * @file src/binary_log.h
+ * @brief Declarations for the binary log of the hot paths.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Log calls below this level are compiled out.
+ * @details Release builds drop verbose calls, define SUNSHINE_LOG_MIN_LEVEL=0 to keep them.
+ */
+#ifndef SUNSHINE_LOG_MIN_LEVEL
+  #ifdef NDEBUG
+    #define SUNSHINE_LOG_MIN_LEVEL 1
+  #else
+    #define SUNSHINE_LOG_MIN_LEVEL 0
+  #endif
+#endif
+
+/**
+ * @brief Log from a hot path.
+ * @details The arguments are captured raw into a ring buffer of the calling thread, they are formatted
+ * and written to the log by a background thread. Nothing is evaluated unless the level is logged.
+ * Every "{}" in the format is replaced by the next argument, which can be an integer, a floating
+ * point number or a string.
+ * @examples
+ * BINARY_LOG(verbose, "Audio [seq {}, pts {}] ::  send...", sequenceNumber, timestamp);
+ * @examples_end
+ */
+#define BINARY_LOG(severity, format, ...)                                                                  \
+  do {                                                                                                     \
+    if constexpr (::binary_log::level::severity >= SUNSHINE_LOG_MIN_LEVEL) {                               \
+      if (::binary_log::enabled(::binary_log::level::severity)) {                                          \
+        static const auto binary_log_format_id = ::binary_log::register_format(::binary_log::level::severity, format); \
+        ::binary_log::write(binary_log_format_id, format __VA_OPT__(, ) __VA_ARGS__);                      \
+      }                                                                                                    \
+    }                                                                                                      \
+  } while (0)
+
+namespace binary_log {
+  /**
+   * @brief The levels of the loggers in logging.h.
+   */
+  namespace level {
+    constexpr int verbose = 0;
+    constexpr int debug = 1;
+    constexpr int info = 2;
+    constexpr int warning = 3;
+    constexpr int error = 4;
+    constexpr int fatal = 5;
+  }  // namespace level
+
+  using clock = std::chrono::system_clock;
+
+  // Longer strings are cut off, and arguments that don't fit after them are left out
+  constexpr std::size_t max_record_size = 1024;
+
+  struct line_t {
+    int level;
+    clock::time_point time;
+    std::string message;
+  };
+
+  /**
+   * @brief Receives the formatted lines of a batch, sorted by the time they were logged.
+   */
+  using writer_t = std::function<void(const std::vector<line_t> &)>;
+
+  enum class arg_e : std::uint8_t {
+    i64,
+    u64,
+    f64,
+    str,
+  };
+
+  /**
+   * @brief Count the "{}" in a format.
+   */
+  constexpr std::size_t
+  placeholders(std::string_view format) {
+    std::size_t count = 0;
+    for (std::size_t x = 0; x + 1 < format.size(); ++x) {
+      if (format[x] == '{' && format[x + 1] == '}') {
+        ++count;
+        ++x;
+      }
+    }
+
+    return count;
+  }
+
+  /**
+   * @brief A format that is checked against its arguments at compile time.
+   */
+  template <typename... Args>
+  struct format_string_t {
+    template <typename T>
+      requires std::convertible_to<const T &, std::string_view>
+    consteval format_string_t(const T &format):
+        text { format } {
+      if (placeholders(text) != sizeof...(Args)) {
+        throw "The number of arguments doesn't match the format";
+      }
+    }
+
+    std::string_view text;
+  };
+
+  extern std::atomic<int> min_level;
+
+  inline bool
+  enabled(int level) {
+    return level >= min_level.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Register a format, each call site registers its format once.
+   * @return The id of the format in records.
+   */
+  std::uint32_t
+  register_format(int level, std::string_view format);
+
+  /**
+   * @brief Copy a record into the ring of the calling thread.
+   * @details When the formatter falls behind and the ring is full, the record is dropped and counted.
+   */
+  void
+  commit(std::span<const std::byte> record);
+
+  namespace detail {
+    struct header_t {
+      std::uint32_t size;
+      std::uint32_t format;
+      std::int64_t time;
+    };
+
+    // Set in header_t::format when arguments were left out of the record
+    constexpr std::uint32_t truncated_flag = 1u << 31;
+
+    class encoder_t {
+    public:
+      void
+      put(const void *data, std::size_t size) {
+        std::memcpy(buffer + size_, data, size);
+        size_ += size;
+      }
+
+      /**
+       * @param value The argument.
+       * @param after The number of arguments after this one, strings leave room for them.
+       */
+      template <typename T>
+      void
+      arg(const T &value, std::size_t after) {
+        if constexpr (std::is_same_v<T, char>) {
+          arg(std::string_view { &value, 1 }, after);
+        }
+        else if constexpr (std::is_same_v<T, bool>) {
+          tagged(arg_e::u64, (std::uint64_t) value);
+        }
+        else if constexpr (std::is_floating_point_v<T>) {
+          tagged(arg_e::f64, (double) value);
+        }
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+          tagged(arg_e::i64, (std::int64_t) value);
+        }
+        else if constexpr (std::is_integral_v<T>) {
+          tagged(arg_e::u64, (std::uint64_t) value);
+        }
+        else if constexpr (std::is_enum_v<T>) {
+          arg((std::underlying_type_t<T>) value, after);
+        }
+        else {
+          std::string_view text { value };
+          if (!fits(3)) {
+            return;
+          }
+
+          // Leave room for short arguments after this one
+          auto room = sizeof(buffer) - std::min(size_ + 3 + after * 32, sizeof(buffer));
+          std::uint16_t length = (std::uint16_t) std::min(text.size(), room);
+
+          auto tag = arg_e::str;
+          put(&tag, 1);
+          put(&length, sizeof(length));
+          put(text.data(), length);
+        }
+      }
+
+      /**
+       * @return The record, with the arguments that fit.
+       */
+      std::span<const std::byte>
+      finish() {
+        auto size = (std::uint32_t) size_;
+        std::memcpy(buffer + offsetof(header_t, size), &size, sizeof(size));
+
+        if (truncated) {
+          std::uint32_t format;
+          std::memcpy(&format, buffer + offsetof(header_t, format), sizeof(format));
+          format |= truncated_flag;
+          std::memcpy(buffer + offsetof(header_t, format), &format, sizeof(format));
+        }
+
+        return { buffer, size_ };
+      }
+
+    private:
+      /**
+       * Arguments are read back in order, once one is left out all after it are left out as well.
+       */
+      bool
+      fits(std::size_t size) {
+        if (truncated || size_ + size > sizeof(buffer)) {
+          truncated = true;
+          return false;
+        }
+
+        return true;
+      }
+
+      template <typename T>
+      void
+      tagged(arg_e tag, T value) {
+        if (!fits(1 + sizeof(value))) {
+          return;
+        }
+
+        put(&tag, 1);
+        put(&value, sizeof(value));
+      }
+
+      std::byte buffer[max_record_size];
+      std::size_t size_ {};
+      bool truncated {};
+    };
+  }  // namespace detail
+
+  /**
+   * @brief Capture a record, use BINARY_LOG() instead.
+   */
+  template <typename... Args>
+  void
+  write(std::uint32_t format, format_string_t<std::type_identity_t<Args>...>, const Args &...args) {
+    detail::encoder_t encoder;
+
+    detail::header_t header {
+      .size = 0,
+      .format = format,
+      .time = clock::now().time_since_epoch().count(),
+    };
+    encoder.put(&header, sizeof(header));
+    auto after = sizeof...(args);
+    (encoder.arg(args, --after), ...);
+
+    commit(encoder.finish());
+  }
+
+  /**
+   * @brief Start the formatter thread.
+   * @param writer Writes the formatted lines to the log.
+   * @param level Records below this level are not captured.
+   */
+  void
+  start(writer_t writer, int level);
+
+  /**
+   * @brief Write everything that was logged before this call.
+   */
+  void
+  flush();
+
+  /**
+   * @brief Write everything that was logged, and stop the formatter thread.
+   */
+  void
+  stop();
+}  // namespace binary_log
@@ -352,6 +352,7 @@ namespace config {
       "superfast"s,  // preset
       "zerolatency"s,  // tune
       11,  // superfast
+      false,  // pipeline
     },  // software
 
     {},  // nv
@@ -395,7 +396,12 @@ namespace config {
     },  // vaapi
 
     {},  // capture
+    {},  // replay_file
+    1.0,  // replay_speed
+    {},  // record_file
     {},  // encoder
+    true,  // probe_cache
+    30,  // encoder_keep_warm
     {},  // adapter_name
     {},  // output_name
     (int) display_device::parsed_config_t::device_prep_e::no_operation,  // display_device_prep
@@ -416,6 +422,7 @@ namespace config {
 
   stream_t stream {
     10s,  // ping_timeout
+    500ms,  // stall_threshold
 
     APPS_JSON_PATH,
 
@@ -1048,6 +1055,7 @@ namespace config {
       video.sw.svtav1_preset = sw::svtav1_preset_from_view(video.sw.sw_preset);
     }
     string_f(vars, "sw_tune", video.sw.sw_tune);
+    bool_f(vars, "sw_pipeline", video.sw.pipeline);
 
     int_between_f(vars, "nvenc_preset", video.nv.quality_preset, { 1, 7 });
     int_between_f(vars, "nvenc_vbv_increase", video.nv.vbv_percentage_increase, { 0, 400 });
@@ -1110,7 +1118,12 @@ namespace config {
     bool_f(vars, "vaapi_strict_rc_buffer", video.vaapi.strict_rc_buffer);
 
     string_f(vars, "capture", video.capture);
+    string_f(vars, "replay_file", video.replay_file);
+    double_between_f(vars, "replay_speed", video.replay_speed, { 0.0, 100.0 });
+    string_f(vars, "record_file", video.record_file);
     string_f(vars, "encoder", video.encoder);
+    bool_f(vars, "encoder_probe_cache", video.probe_cache);
+    int_between_f(vars, "encoder_keep_warm", video.encoder_keep_warm, { 0, 600 });
     string_f(vars, "adapter_name", video.adapter_name);
     string_f(vars, "output_name", video.output_name);
     sync_idd_f(vars, "output_name", video.output_name);
@@ -1152,6 +1165,12 @@ namespace config {
       stream.ping_timeout = std::chrono::milliseconds(to);
     }
 
+    int stall_threshold = -1;
+    int_between_f(vars, "stall_threshold", stall_threshold, { 0, std::numeric_limits<int>::max() });
+    if (stall_threshold != -1) {
+      stream.stall_threshold = std::chrono::milliseconds(stall_threshold);
+    }
+
     int_between_f(vars, "lan_encryption_mode", stream.lan_encryption_mode, { 0, 2 });
     int_between_f(vars, "wan_encryption_mode", stream.wan_encryption_mode, { 0, 2 });
 
@@ -30,6 +30,7 @@ namespace config {
       std::string sw_preset;
       std::string sw_tune;
       std::optional<int> svtav1_preset;
+      bool pipeline;  // Convert the next frame while the current one is being encoded
     } sw;
 
     nvenc::nvenc_config nv;
@@ -80,7 +81,12 @@ namespace config {
     } vaapi;
 
     std::string capture;
+    std::string replay_file;  // Recorded frames served by `capture = replay`
+    double replay_speed;  // Playback speed of the recorded frames, 0 serves them as fast as they are consumed
+    std::string record_file;  // Record the frames of the RAM capture backends to this file
     std::string encoder;
+    bool probe_cache;  // Reuse the results of encoder probing while the GPUs and configuration stay the same
+    int encoder_keep_warm;  // Seconds to keep the encoder of an ended stream for a client that reconnects
     std::string adapter_name;
 
     struct display_mode_remapping_t {
@@ -115,6 +121,9 @@ namespace config {
   struct stream_t {
     std::chrono::milliseconds ping_timeout;
 
+    // Frame gaps longer than this dump the flight recorder of the session, 0 disables automatic dumps
+    std::chrono::milliseconds stall_threshold;
+
     std::string file_apps;
 
     int fec_percentage;
@@ -27,18 +27,24 @@
 #include <Simple-Web-Server/server_https.hpp>
 #include <boost/asio/ssl/context_base.hpp>
 
+#include "asset_cache.h"
 #include "config.h"
 #include "confighttp.h"
 #include "crypto.h"
 #include "display_device/session.h"
 #include "file_handler.h"
+#include "flight_recorder.h"
 #include "globals.h"
 #include "httpcommon.h"
+#include "log_tail.h"
 #include "logging.h"
+#include "metrics.h"
 #include "network.h"
 #include "nvhttp.h"
 #include "platform/common.h"
 #include "rtsp.h"
+#include "thread_pool.h"
+#include "trace.h"
 #include "src/display_device/display_device.h"
 #include "src/display_device/to_string.h"
 #include "utility.h"
@@ -62,6 +68,9 @@ namespace confighttp {
     REMOVE  ///< Remove client
   };
 
+  // Polls the log for requests that wait for new lines, running while the server runs
+  thread_pool_util::ThreadPool log_tail_pool;
+
   void
   print_req(const req_https_t &request) {
     std::ostringstream log_stream;
@@ -192,19 +201,75 @@ namespace confighttp {
               << data.str();
   }
 
+  /**
+   * @brief Send a file of the Web UI through the asset cache.
+   * @details Clients that have the file get 304 Not Modified, others get the smallest variant they accept.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   * @param path The file.
+   * @param headers The headers of the file, the caching headers are added.
+   * @return false if the file doesn't exist, nothing was sent.
+   */
+  bool
+  sendAsset(resp_https_t response, req_https_t request, const fs::path &path, SimpleWeb::CaseInsensitiveMultimap headers) {
+    auto asset = asset_cache::get(path);
+    if (!asset) {
+      return false;
+    }
+
+    auto header = [&request](const char *name) -> std::optional<std::string_view> {
+      auto it = request->header.find(name);
+      if (it == std::end(request->header)) {
+        return std::nullopt;
+      }
+
+      return it->second;
+    };
+
+    auto encoding = asset_cache::negotiate(*asset, header("Accept-Encoding").value_or(""sv));
+    auto etag = asset_cache::etag(*asset, encoding);
+
+    headers.emplace("ETag", etag);
+    headers.emplace("Last-Modified", asset->last_modified);
+    headers.emplace("Vary", "Accept-Encoding");
+
+    if (asset_cache::not_modified(etag, asset->last_modified, header("If-None-Match"), header("If-Modified-Since"))) {
+      response->write(SimpleWeb::StatusCode::redirection_not_modified, headers);
+      return true;
+    }
+
+    if (encoding != asset_cache::encoding_e::identity) {
+      headers.emplace("Content-Encoding", std::string { asset_cache::content_encoding(encoding) });
+    }
+
+    if (auto body = asset_cache::body(*asset, encoding)) {
+      response->write(SimpleWeb::StatusCode::success_ok, *body, headers);
+    }
+    else {
+      // Too large to keep in memory
+      std::ifstream in(asset->path, std::ios::binary);
+      response->write(SimpleWeb::StatusCode::success_ok, in, headers);
+    }
+
+    return true;
+  }
+
   void
   getHtmlPage(resp_https_t response, req_https_t request, const std::string& pageName, bool requireAuth = true) {
     if (requireAuth && !authenticate(response, request)) return;
 
     print_req(request);
 
-    std::string content = file_handler::read_file((std::string(WEB_DIR) + pageName).c_str());
     SimpleWeb::CaseInsensitiveMultimap headers;
     headers.emplace("Content-Type", "text/html; charset=utf-8");
+    // Pages keep their names across versions, they are revalidated on every load
+    headers.emplace("Cache-Control", "no-cache");
     if (pageName == "apps.html") {
       headers.emplace("Access-Control-Allow-Origin", "https://images.igdb.com/");
     }
-    response->write(content, headers);
+    if (!sendAsset(response, request, WEB_DIR + pageName, std::move(headers))) {
+      response->write(SimpleWeb::StatusCode::client_error_not_found);
+    }
   }
 
   void
@@ -257,10 +322,12 @@ namespace confighttp {
   getStaticResource(resp_https_t response, req_https_t request, const std::string& path, const std::string& contentType) {
     // print_req(request);
 
-    std::ifstream in(path, std::ios::binary);
     SimpleWeb::CaseInsensitiveMultimap headers;
     headers.emplace("Content-Type", contentType);
-    response->write(SimpleWeb::StatusCode::success_ok, in, headers);
+    headers.emplace("Cache-Control", "no-cache");
+    if (!sendAsset(response, request, path, std::move(headers))) {
+      response->write(SimpleWeb::StatusCode::client_error_not_found);
+    }
   }
 
   void
@@ -323,28 +390,29 @@ namespace confighttp {
     // .relative_path is needed to shed any leading slash that might exist in the request path
     auto filePath = fs::weakly_canonical(webDirPath / fs::path(request->path).relative_path());
 
-    // Don't do anything if file does not exist or is outside the assets directory
+    // Don't do anything if the file is outside the assets directory
     if (!isChildPath(filePath, nodeModulesPath)) {
       BOOST_LOG(warning) << "Someone requested a path " << filePath << " that is outside the assets folder";
       response->write(SimpleWeb::StatusCode::client_error_bad_request, "Bad Request");
+      return;
     }
-    else if (!fs::exists(filePath)) {
+
+    // get the mime type from the file extension mime_types map
+    // remove the leading period from the extension
+    auto extension = filePath.extension().string();
+    auto mimeType = mime_types.find(extension.empty() ? extension : extension.substr(1));
+    // do not return any file if the type is not in the map
+    if (mimeType == mime_types.end()) {
       response->write(SimpleWeb::StatusCode::client_error_not_found);
+      return;
     }
-    else {
-      auto relPath = fs::relative(filePath, webDirPath);
-      // get the mime type from the file extension mime_types map
-      // remove the leading period from the extension
-      auto mimeType = mime_types.find(relPath.extension().string().substr(1));
-      // check if the extension is in the map at the x position
-      if (mimeType != mime_types.end()) {
-        // if it is, set the content type to the mime type
-        SimpleWeb::CaseInsensitiveMultimap headers;
-        headers.emplace("Content-Type", mimeType->second);
-        std::ifstream in(filePath.string(), std::ios::binary);
-        response->write(SimpleWeb::StatusCode::success_ok, in, headers);
-      }
-      // do not return any file if the type is not in the map
+
+    SimpleWeb::CaseInsensitiveMultimap headers;
+    headers.emplace("Content-Type", mimeType->second);
+    // Only the files Vite wrote with a hash in their name never change, the others are revalidated with their ETag
+    headers.emplace("Cache-Control", asset_cache::is_fingerprinted(filePath) ? "public, max-age=31536000, immutable" : "no-cache");
+    if (!sendAsset(response, request, filePath, std::move(headers))) {
+      response->write(SimpleWeb::StatusCode::client_error_not_found);
     }
   }
 
@@ -360,16 +428,191 @@ namespace confighttp {
     response->write(content, headers);
   }
 
+  /**
+   * @brief Get the log, or the range of it in the Range header.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   *
+   * Without a Range header the whole log is streamed from the file.
+   * A range longer than log_tail::max_chunk bytes is cut off, the Content-Range header tells where to continue.
+   */
   void
   getLogs(resp_https_t response, req_https_t request) {
     if (!authenticate(response, request)) return;
 
     // print_req(request);
 
-    std::string content = file_handler::read_file(config::sunshine.log_file.c_str());
+    fs::path log_file = config::sunshine.log_file;
+
     SimpleWeb::CaseInsensitiveMultimap headers;
     headers.emplace("Content-Type", "text/plain");
-    response->write(SimpleWeb::StatusCode::success_ok, content, headers);
+    headers.emplace("Accept-Ranges", "bytes");
+
+    auto range_header = request->header.find("Range");
+    if (range_header == request->header.end()) {
+      std::ifstream in(log_file, std::ios::binary);
+      response->write(SimpleWeb::StatusCode::success_ok, in, headers);
+      return;
+    }
+
+    std::error_code ec;
+    auto size = fs::file_size(log_file, ec);
+    if (ec) {
+      size = 0;
+    }
+
+    auto range = log_tail::parse_range(range_header->second, size);
+    if (!range) {
+      headers.emplace("Content-Range", "bytes */" + std::to_string(size));
+      response->write(SimpleWeb::StatusCode::client_error_range_not_satisfiable, headers);
+      return;
+    }
+
+    // Ranges are read into memory, longer ones are cut off and Content-Range tells where to continue
+    range->end = std::min(range->end, range->begin + log_tail::max_chunk);
+
+    auto content = log_tail::read_range(log_file, range->begin, range->end);
+    if (!content) {
+      response->write(SimpleWeb::StatusCode::server_error_internal_server_error);
+      return;
+    }
+
+    headers.emplace("Content-Range", "bytes " + std::to_string(range->begin) + "-" + std::to_string(range->end - 1) + "/" + std::to_string(size));
+    response->write(SimpleWeb::StatusCode::success_partial_content, *content, headers);
+  }
+
+  /**
+   * @brief Send the lines of the log after an offset, waiting for new lines until the deadline.
+   * @param response The HTTP response object.
+   * @param query The lines to send.
+   * @param deadline When to send the response, even if there are no new lines.
+   */
+  void
+  sendLogTail(resp_https_t response, log_tail::query_t query, std::chrono::steady_clock::time_point deadline) {
+    auto chunk = log_tail::read(config::sunshine.log_file, query);
+    if (!chunk) {
+      response->write(SimpleWeb::StatusCode::server_error_internal_server_error);
+      return;
+    }
+
+    // Poll the log without blocking the server or the shared task pool, lines that were filtered out are skipped
+    if (query.offset && chunk->lines.empty() && !chunk->reset && std::chrono::steady_clock::now() < deadline) {
+      query.offset = chunk->end;
+      log_tail_pool.pushDelayed([response, query, deadline]() {
+        sendLogTail(response, query, deadline);
+      },
+        250ms);
+      return;
+    }
+
+    nlohmann::json output_tree;
+    output_tree["begin"] = chunk->begin;
+    output_tree["end"] = chunk->end;
+    output_tree["size"] = chunk->size;
+    output_tree["reset"] = chunk->reset;
+    output_tree["lines"] = chunk->lines;
+
+    // Long messages can be cut off in the middle of a character
+    SimpleWeb::CaseInsensitiveMultimap headers;
+    headers.emplace("Content-Type", "application/json");
+    response->write(output_tree.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace), headers);
+  }
+
+  /**
+   * @brief Get the lines of the log after an offset.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   *
+   * The query can contain:
+   * - offset: where to continue reading, the end of the previous response. The last lines are sent without it.
+   * - level: leave out lines below this level, e.g. "warning".
+   * - filter: only send lines that contain this text.
+   * - wait: seconds to wait for new lines before responding, at most 30.
+   */
+  void
+  getLogTail(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) return;
+
+    // Polled while the Troubleshooting page is open, so the request isn't logged
+    static constexpr std::array levels { "verbose"sv, "debug"sv, "info"sv, "warning"sv, "error"sv, "fatal"sv };
+
+    auto args = request->parse_query_string();
+
+    log_tail::query_t query;
+    std::chrono::seconds wait {};
+    try {
+      if (auto it = args.find("offset"); it != args.end()) {
+        query.offset = std::stoull(it->second);
+      }
+      if (auto it = args.find("wait"); it != args.end()) {
+        wait = std::chrono::seconds(std::clamp(std::stoi(it->second), 0, 30));
+      }
+    }
+    catch (const std::exception &) {
+      response->write(SimpleWeb::StatusCode::client_error_bad_request, "Bad Request");
+      return;
+    }
+
+    if (auto it = args.find("level"); it != args.end()) {
+      auto level = std::find(std::begin(levels), std::end(levels), it->second);
+      query.min_level = level == std::end(levels) ? 0 : (int) (level - std::begin(levels));
+    }
+    if (auto it = args.find("filter"); it != args.end()) {
+      query.filter = it->second;
+    }
+
+    sendLogTail(response, std::move(query), std::chrono::steady_clock::now() + wait);
+  }
+
+  void
+  startTrace(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) return;
+
+    print_req(request);
+
+    trace::start();
+    BOOST_LOG(info) << "Recording a trace of the streaming pipeline"sv;
+
+    nlohmann::json output_tree;
+    output_tree["status"] = true;
+    send_response(response, output_tree);
+  }
+
+  void
+  getTrace(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) return;
+
+    print_req(request);
+
+    trace::stop();
+
+    // Chrome trace event format, opened by https://ui.perfetto.dev and chrome://tracing
+    SimpleWeb::CaseInsensitiveMultimap headers;
+    headers.emplace("Content-Type", "application/json");
+    headers.emplace("Content-Disposition", "attachment; filename=\"sunshine_trace.json\"");
+    response->write(SimpleWeb::StatusCode::success_ok, trace::export_chrome_json(), headers);
+  }
+
+  void
+  getFlightRecorder(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) return;
+
+    print_req(request);
+
+    SimpleWeb::CaseInsensitiveMultimap headers;
+    headers.emplace("Content-Type", "application/json");
+    headers.emplace("Content-Disposition", "attachment; filename=\"sunshine_flight_recorder.json\"");
+    response->write(SimpleWeb::StatusCode::success_ok, flight_recorder::export_all_json(), headers);
+  }
+
+  void
+  getMetrics(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) return;
+
+    // Scraped every few seconds, so the request isn't logged
+    SimpleWeb::CaseInsensitiveMultimap headers;
+    headers.emplace("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+    response->write(SimpleWeb::StatusCode::success_ok, metrics::export_prometheus(), headers);
   }
 
   void
@@ -1122,6 +1365,11 @@ namespace confighttp {
     server.resource["^/api/pin$"]["POST"] = savePin;
     server.resource["^/api/apps$"]["GET"] = getApps;
     server.resource["^/api/logs$"]["GET"] = getLogs;
+    server.resource["^/api/logs/tail$"]["GET"] = getLogTail;
+    server.resource["^/api/trace$"]["GET"] = getTrace;
+    server.resource["^/api/flight_recorder$"]["GET"] = getFlightRecorder;
+    server.resource["^/metrics$"]["GET"] = getMetrics;
+    server.resource["^/api/trace/start$"]["POST"] = startTrace;
     server.resource["^/api/apps$"]["POST"] = saveApp;
     server.resource["^/api/config$"]["GET"] = getConfig;
     server.resource["^/api/config$"]["POST"] = saveConfig;
@@ -1170,6 +1418,7 @@ namespace confighttp {
       }
     };
     std::thread tcp { accept_and_run, &server };
+    log_tail_pool.start(1);
 
     // Wait for any event
     shutdown_event->view();
@@ -1177,5 +1426,9 @@ namespace confighttp {
     server.stop();
 
     tcp.join();
+
+    // Requests that still wait for new lines are closed
+    log_tail_pool.stop();
+    log_tail_pool.join();
   }
 }  // namespace confighttp
@@ -6,21 +6,118 @@
 #include <openssl/pem.h>
 #include <openssl/rsa.h>
 
+#include <optional>
+
 namespace crypto {
   using asn1_string_t = util::safe_ptr<ASN1_STRING, ASN1_STRING_free>;
 
   cert_chain_t::cert_chain_t():
       _certs {}, _cert_ctx { X509_STORE_CTX_new() } {}
+  /**
+   * @brief Digest the subject and the public key of a certificate.
+   * A self-signed certificate is only trusted by the stores of certificates with the same subject and key.
+   */
+  static std::optional<sha256_t>
+  subject_key_digest(x509_t::element_type *cert) {
+    auto key = X509_get0_pubkey(cert);
+    if (!key) {
+      return std::nullopt;
+    }
+
+    unsigned char *subject_der = nullptr;
+    unsigned char *key_der = nullptr;
+    auto subject_size = i2d_X509_NAME(X509_get_subject_name(cert), &subject_der);
+    auto key_size = i2d_PUBKEY(key, &key_der);
+    auto fg = util::fail_guard([&]() {
+      OPENSSL_free(subject_der);
+      OPENSSL_free(key_der);
+    });
+
+    if (subject_size <= 0 || key_size <= 0) {
+      return std::nullopt;
+    }
+
+    std::string der;
+    der.append((char *) subject_der, subject_size);
+    der.append((char *) key_der, key_size);
+
+    return hash(der);
+  }
+
   void
   cert_chain_t::add(x509_t &&cert) {
     x509_store_t x509_store { X509_STORE_new() };
 
+    sha256_t fingerprint;
+    unsigned int size = fingerprint.size();
+    if (X509_digest(cert.get(), EVP_sha256(), fingerprint.data(), &size) == 1) {
+      // A certificate that was added twice is verified against its first store
+      _fingerprints.emplace(fingerprint, _certs.size());
+    }
+    if (auto digest = subject_key_digest(cert.get())) {
+      _subject_keys[*digest].emplace_back(_certs.size());
+    }
+
     X509_STORE_add_cert(x509_store.get(), cert.get());
     _certs.emplace_back(std::make_pair(std::move(cert), std::move(x509_store)));
   }
   void
   cert_chain_t::clear() {
     _certs.clear();
+    _fingerprints.clear();
+    _subject_keys.clear();
+  }
+
+  /**
+   * @brief Find the stores a certificate has to be verified against.
+   * A paired client presents the certificate it paired with, so its store is found by fingerprint,
+   * instead of verifying the certificate against the store of every paired client.
+   * A self-signed certificate can only be trusted through a paired certificate with the same subject and key,
+   * so an unknown client is rejected without going through every store.
+   * @param cert The certificate to verify.
+   * @return The stores to verify against, in the order they were added.
+   */
+  std::vector<cert_chain_t::entry_t *>
+  cert_chain_t::candidates(x509_t::element_type *cert) {
+    if (!cert || _certs.empty()) {
+      return {};
+    }
+
+    sha256_t fingerprint;
+    unsigned int size = fingerprint.size();
+    if (X509_digest(cert, EVP_sha256(), fingerprint.data(), &size) == 1) {
+      auto it = _fingerprints.find(fingerprint);
+      if (it != std::end(_fingerprints)) {
+        return { &_certs[it->second] };
+      }
+    }
+
+    // Self-signed means signed by its own key, not just issued by a certificate with the same name
+    auto self_signed = X509_NAME_cmp(X509_get_issuer_name(cert), X509_get_subject_name(cert)) == 0 &&
+                       X509_verify(cert, X509_get0_pubkey(cert)) == 1;
+    if (self_signed) {
+      if (auto digest = subject_key_digest(cert)) {
+        std::vector<entry_t *> stores;
+
+        auto it = _subject_keys.find(*digest);
+        if (it != std::end(_subject_keys)) {
+          for (auto index : it->second) {
+            stores.emplace_back(&_certs[index]);
+          }
+        }
+
+        return stores;
+      }
+    }
+
+    // The certificate could have been issued by any of the paired certificates
+    std::vector<entry_t *> stores;
+    stores.reserve(_certs.size());
+    for (auto &entry : _certs) {
+      stores.emplace_back(&entry);
+    }
+
+    return stores;
   }
 
   static int
@@ -54,8 +151,12 @@ namespace crypto {
    */
   const char *
   cert_chain_t::verify(x509_t::element_type *cert) {
-    int err_code = 0;
-    for (auto &[_, x509_store] : _certs) {
+    auto stores = candidates(cert);
+
+    // Every store rejects a self-signed certificate none of them holds the same way
+    int err_code = stores.empty() && cert && !_certs.empty() ? X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT : 0;
+    for (auto entry : stores) {
+      auto &x509_store = entry->second;
       auto fg = util::fail_guard([this]() {
         X509_STORE_CTX_cleanup(_cert_ctx.get());
       });
@@ -91,8 +192,10 @@ namespace crypto {
       if (_certs.empty()) {
           return "No certificate stores available";
       }
-      int last_err_code = X509_V_ERR_UNSPECIFIED;
-      for (auto& [name, x509_store] : _certs) {
+      auto stores = candidates(cert);
+      int last_err_code = stores.empty() ? X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT : X509_V_ERR_UNSPECIFIED;
+      for (auto* entry : stores) {
+          auto& x509_store = entry->second;
           auto ctx_deleter = [](X509_STORE_CTX* ctx) {
               if (ctx) {
                   X509_STORE_CTX_free(ctx);
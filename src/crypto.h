@@ -5,6 +5,10 @@
 #pragma once
 
 #include <array>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <openssl/sha.h>
@@ -88,7 +92,28 @@ namespace crypto {
     verify_safe(x509_t::element_type *cert);
 
   private:
-    std::vector<std::pair<x509_t, x509_store_t>> _certs;
+    using entry_t = std::pair<x509_t, x509_store_t>;
+
+    struct fingerprint_hash_t {
+      std::size_t
+      operator()(const sha256_t &fingerprint) const {
+        // The fingerprint is already uniformly distributed
+        std::size_t hash;
+        std::memcpy(&hash, fingerprint.data(), sizeof(hash));
+        return hash;
+      }
+    };
+
+    std::vector<entry_t *>
+    candidates(x509_t::element_type *cert);
+
+    std::vector<entry_t> _certs;
+
+    // SHA-256 of the DER encoding of each certificate -> its index in _certs
+    std::unordered_map<sha256_t, std::size_t, fingerprint_hash_t> _fingerprints;
+
+    // SHA-256 of the subject and the public key of each certificate -> their indices in _certs
+    std::unordered_map<sha256_t, std::vector<std::size_t>, fingerprint_hash_t> _subject_keys;
     x509_store_ctx_t _cert_ctx;
   };
 
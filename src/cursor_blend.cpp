@@ -0,0 +1,165 @@
+/**
+ * @file src/cursor_blend.cpp
+ * @brief Definitions for blending cursor sprites into captured images.
+ */
+#include <algorithm>
+
+#include "cursor_blend.h"
+
+#if defined(__x86_64) || defined(__x86_64__) || defined(__amd64) || defined(__amd64__) || defined(_M_AMD64)
+  #include <immintrin.h>
+
+  #define CURSOR_BLEND_X86
+#endif
+
+namespace cursor_blend {
+  namespace {
+    using blend_row_fn = void (*)(std::uint32_t *dst, const std::uint32_t *src, int count);
+
+    /**
+     * @brief Divide by 255 with rounding, exact for any product of two 8-bit values.
+     */
+    inline std::uint32_t
+    div255(std::uint32_t x) {
+      x += 128;
+      return (x + (x >> 8)) >> 8;
+    }
+
+#ifdef CURSOR_BLEND_X86
+    __attribute__((target("sse4.1"))) inline __m128i
+    div255_epi16(__m128i x) {
+      x = _mm_add_epi16(x, _mm_set1_epi16(128));
+      return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    }
+
+    __attribute__((target("sse4.1"))) void
+    blend_row_sse4(std::uint32_t *dst, const std::uint32_t *src, int count) {
+      // Broadcast the alpha of each pixel to all of its channels
+      const auto alpha_shuffle = _mm_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+      const auto ones = _mm_set1_epi8(-1);
+      const auto zero = _mm_setzero_si128();
+
+      int x = 0;
+      for (; x + 4 <= count; x += 4) {
+        auto s = _mm_loadu_si128((const __m128i *) (src + x));
+        auto d = _mm_loadu_si128((const __m128i *) (dst + x));
+        auto inv_alpha = _mm_xor_si128(_mm_shuffle_epi8(s, alpha_shuffle), ones);
+
+        auto lo = _mm_mullo_epi16(_mm_cvtepu8_epi16(d), _mm_cvtepu8_epi16(inv_alpha));
+        auto hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(inv_alpha, zero));
+
+        auto blended = _mm_packus_epi16(div255_epi16(lo), div255_epi16(hi));
+        _mm_storeu_si128((__m128i *) (dst + x), _mm_adds_epu8(s, blended));
+      }
+
+      blend_row_scalar(dst + x, src + x, count - x);
+    }
+
+    __attribute__((target("avx2"))) inline __m256i
+    div255_epi16(__m256i x) {
+      x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+      return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+    }
+
+    __attribute__((target("avx2"))) void
+    blend_row_avx2(std::uint32_t *dst, const std::uint32_t *src, int count) {
+      // The shuffle and unpack instructions operate on each 128-bit lane independently,
+      // so the pixel order is preserved once the lanes are packed again.
+      const auto alpha_shuffle = _mm256_setr_epi8(
+        3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15,
+        3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+      const auto ones = _mm256_set1_epi8(-1);
+      const auto zero = _mm256_setzero_si256();
+
+      int x = 0;
+      for (; x + 8 <= count; x += 8) {
+        auto s = _mm256_loadu_si256((const __m256i *) (src + x));
+        auto d = _mm256_loadu_si256((const __m256i *) (dst + x));
+        auto inv_alpha = _mm256_xor_si256(_mm256_shuffle_epi8(s, alpha_shuffle), ones);
+
+        auto lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(inv_alpha, zero));
+        auto hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(inv_alpha, zero));
+
+        auto blended = _mm256_packus_epi16(div255_epi16(lo), div255_epi16(hi));
+        _mm256_storeu_si256((__m256i *) (dst + x), _mm256_adds_epu8(s, blended));
+      }
+
+      blend_row_sse4(dst + x, src + x, count - x);
+    }
+#endif
+
+    blend_row_fn
+    select_blend_row() {
+#ifdef CURSOR_BLEND_X86
+      if (__builtin_cpu_supports("avx2")) {
+        return blend_row_avx2;
+      }
+      if (__builtin_cpu_supports("sse4.1")) {
+        return blend_row_sse4;
+      }
+#endif
+      return blend_row_scalar;
+    }
+  }  // namespace
+
+  platf::rect_t
+  clip(const platf::rect_t &rect, int width, int height) {
+    auto left = std::clamp(rect.x, 0, width);
+    auto top = std::clamp(rect.y, 0, height);
+    auto right = std::clamp(rect.x + rect.width, left, width);
+    auto bottom = std::clamp(rect.y + rect.height, top, height);
+
+    return { left, top, right - left, bottom - top };
+  }
+
+  void
+  blend_row_scalar(std::uint32_t *dst, const std::uint32_t *src, int count) {
+    for (int x = 0; x < count; ++x) {
+      auto pixel = src[x];
+      auto inv_alpha = 255 - (pixel >> 24);
+
+      // Fully opaque pixels replace the destination and fully transparent ones leave it untouched
+      if (inv_alpha == 0) {
+        dst[x] = pixel;
+        continue;
+      }
+      if (pixel == 0) {
+        continue;
+      }
+
+      std::uint32_t out = 0;
+      for (int shift = 0; shift < 32; shift += 8) {
+        auto channel = ((pixel >> shift) & 0xFF) + div255(((dst[x] >> shift) & 0xFF) * inv_alpha);
+        out |= std::min<std::uint32_t>(channel, 255) << shift;
+      }
+      dst[x] = out;
+    }
+  }
+
+  void
+  blend_row(std::uint32_t *dst, const std::uint32_t *src, int count) {
+    static const auto blend_row_best = select_blend_row();
+
+    blend_row_best(dst, src, count);
+  }
+
+  platf::rect_t
+  blend(platf::img_t &img, const std::uint32_t *pixels, int width, int height, int x, int y) {
+    auto rect = clip({ x, y, width, height }, img.width, img.height);
+
+    for (int row = rect.y; row < rect.y + rect.height; ++row) {
+      auto dst = (std::uint32_t *) (img.data + row * img.row_pitch) + rect.x;
+      auto src = pixels + (row - y) * width + (rect.x - x);
+
+      blend_row(dst, src, rect.width);
+    }
+
+    return rect;
+  }
+
+  platf::rect_t
+  blend(platf::img_t &img, const sprite_t &sprite, int x, int y) {
+    return blend(img, sprite.pixels.data(), sprite.width, sprite.height, x, y);
+  }
+
+}  // namespace cursor_blend
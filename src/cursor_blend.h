@@ -0,0 +1,65 @@
+/**
+ * @file src/cursor_blend.h
+ * @brief Declarations for blending cursor sprites into captured images.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "platform/common.h"
+
+namespace cursor_blend {
+
+  /**
+   * @brief Cursor image in premultiplied BGRA, kept until the cursor image changes.
+   */
+  struct sprite_t {
+    std::vector<std::uint32_t> pixels;
+    int width {};
+    int height {};
+
+    // Hotspot relative to the top left corner of the sprite
+    int xhot {};
+    int yhot {};
+
+    // Identifies the cursor image the sprite was made from
+    unsigned long serial {};
+  };
+
+  /**
+   * @brief Clip a rectangle to the bounds of an image.
+   * @return The clipped rectangle, with zero width and height if it lies outside the image.
+   */
+  platf::rect_t
+  clip(const platf::rect_t &rect, int width, int height);
+
+  /**
+   * @brief Blend premultiplied BGRA pixels over 32-bit BGR pixels.
+   * @details Every channel becomes `src + dst * (255 - src_alpha) / 255`, rounded to nearest.
+   * Uses the widest SIMD instruction set supported by the CPU.
+   */
+  void
+  blend_row(std::uint32_t *dst, const std::uint32_t *src, int count);
+
+  /**
+   * @brief Reference implementation of blend_row() without SIMD.
+   */
+  void
+  blend_row_scalar(std::uint32_t *dst, const std::uint32_t *src, int count);
+
+  /**
+   * @brief Blend a premultiplied BGRA cursor into a 32-bit BGR image.
+   * @param img The destination image.
+   * @param pixels The cursor pixels, tightly packed.
+   * @param width, height Dimensions of the cursor.
+   * @param x, y Top left corner of the cursor in image coordinates, the cursor may be partially outside the image.
+   * @return The part of the image that was touched.
+   */
+  platf::rect_t
+  blend(platf::img_t &img, const std::uint32_t *pixels, int width, int height, int x, int y);
+
+  platf::rect_t
+  blend(platf::img_t &img, const sprite_t &sprite, int x, int y);
+
+}  // namespace cursor_blend
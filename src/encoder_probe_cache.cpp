@@ -0,0 +1,80 @@
+/**
+ * @file src/encoder_probe_cache.cpp
+ * @brief Definitions for persisting the results of encoder probing.
+ */
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "encoder_probe_cache.h"
+#include "logging.h"
+
+using namespace std::literals;
+
+namespace video::probe_cache {
+  namespace pt = boost::property_tree;
+
+  // Bumped whenever the meaning of the stored fields changes
+  constexpr int version = 1;
+
+  std::optional<entry_t>
+  load(const std::filesystem::path &file, const std::string &key) {
+    std::error_code ec;
+    if (!std::filesystem::exists(file, ec)) {
+      return std::nullopt;
+    }
+
+    try {
+      pt::ptree tree;
+      pt::read_json(file.string(), tree);
+
+      if (tree.get<int>("version") != version || tree.get<std::string>("key") != key) {
+        BOOST_LOG(info) << "Encoder probe cache is stale"sv;
+        return std::nullopt;
+      }
+
+      return entry_t {
+        key,
+        tree.get<std::string>("encoder"),
+        tree.get<int>("hevc_mode"),
+        tree.get<int>("av1_mode"),
+        tree.get<std::uint32_t>("h264"),
+        tree.get<std::uint32_t>("hevc"),
+        tree.get<std::uint32_t>("av1"),
+      };
+    }
+    catch (const std::exception &e) {
+      BOOST_LOG(warning) << "Couldn't read encoder probe cache: "sv << e.what();
+      return std::nullopt;
+    }
+  }
+
+  int
+  save(const std::filesystem::path &file, const entry_t &entry) {
+    pt::ptree tree;
+    tree.put("version", version);
+    tree.put("key", entry.key);
+    tree.put("encoder", entry.encoder);
+    tree.put("hevc_mode", entry.hevc_mode);
+    tree.put("av1_mode", entry.av1_mode);
+    tree.put("h264", entry.h264);
+    tree.put("hevc", entry.hevc);
+    tree.put("av1", entry.av1);
+
+    try {
+      pt::write_json(file.string(), tree);
+    }
+    catch (const std::exception &e) {
+      BOOST_LOG(warning) << "Couldn't write encoder probe cache: "sv << e.what();
+      return -1;
+    }
+
+    return 0;
+  }
+
+  void
+  invalidate(const std::filesystem::path &file) {
+    std::error_code ec;
+    std::filesystem::remove(file, ec);
+  }
+
+}  // namespace video::probe_cache
@@ -0,0 +1,55 @@
+/**
+ * @file src/encoder_probe_cache.h
+ * @brief Declarations for persisting the results of encoder probing.
+ */
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace video::probe_cache {
+
+  /**
+   * @brief The outcome of a successful encoder probe.
+   */
+  struct entry_t {
+    // Identifies the hardware, drivers and configuration the probe ran with
+    std::string key;
+
+    // Name of the chosen encoder
+    std::string encoder;
+
+    int hevc_mode;
+    int av1_mode;
+
+    // Capability bits of each codec, see `encoder_t::flag_e`
+    std::uint32_t h264;
+    std::uint32_t hevc;
+    std::uint32_t av1;
+  };
+
+  /**
+   * @brief Load the cached probe result.
+   * @param file The cache file.
+   * @param key The key the result must have been stored with.
+   * @return The cached result, or `std::nullopt` if there is none for this key.
+   */
+  std::optional<entry_t>
+  load(const std::filesystem::path &file, const std::string &key);
+
+  /**
+   * @brief Replace the cached probe result.
+   * @return 0 on success, -1 if the cache file couldn't be written.
+   */
+  int
+  save(const std::filesystem::path &file, const entry_t &entry);
+
+  /**
+   * @brief Remove the cached probe result, for when it turned out to be wrong.
+   */
+  void
+  invalidate(const std::filesystem::path &file);
+
+}  // namespace video::probe_cache
@@ -0,0 +1,329 @@
+/**
+ * @file src/flight_recorder.cpp
+ * @brief Definitions for the flight recorder of streaming sessions.
+ */
+#include "flight_recorder.h"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace flight_recorder {
+  namespace {
+    // Automatic dumps of a session are at least this far apart
+    constexpr auto dump_interval = std::chrono::seconds(30);
+
+    // This many IDR requests within this time are a storm
+    constexpr auto idr_storm_window = std::chrono::seconds(5);
+
+    // Older dumps are deleted
+    constexpr std::size_t max_dumps = 10;
+
+    std::mutex recorders_mutex;
+    std::vector<recorder_t *> recorders;
+
+    std::int64_t
+    to_ns(clock::time_point time) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+
+    std::int64_t
+    to_us(clock::duration duration) {
+      return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    }
+
+    void
+    write_ms(std::ostream &out, std::int64_t us) {
+      if (us < 0) {
+        out << '-';
+        us = -us;
+      }
+      out << us / 1000 << '.' << std::setw(3) << std::setfill('0') << us % 1000;
+    }
+  }  // namespace
+
+  recorder_t::recorder_t(std::uint32_t session_id, std::string client_name, std::chrono::milliseconds stall_threshold):
+      id { session_id },
+      client_name { std::move(client_name) },
+      stall_threshold { stall_threshold },
+      slots { std::make_unique<std::array<slot_t, ring_size>>() } {}
+
+  void
+  recorder_t::record(event_e type, std::initializer_list<std::int64_t> values) {
+    auto index = head.fetch_add(1, std::memory_order_relaxed);
+    auto &slot = (*slots)[index % ring_size];
+
+    // Readers that see any part of this event see that the slot is being rewritten
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.time.store(to_ns(clock::now()), std::memory_order_relaxed);
+    slot.type.store(type, std::memory_order_relaxed);
+
+    auto value = std::begin(values);
+    for (auto &field : slot.values) {
+      field.store(value != std::end(values) ? *value++ : 0, std::memory_order_relaxed);
+    }
+
+    slot.seq.store(index + 1, std::memory_order_release);
+  }
+
+  std::optional<std::string>
+  recorder_t::trigger(std::string reason) {
+    if (stall_threshold == std::chrono::milliseconds::zero()) {
+      return std::nullopt;
+    }
+
+    auto now = to_ns(clock::now());
+    auto last = last_dump.load(std::memory_order_relaxed);
+    if ((last && now - last < std::chrono::nanoseconds(dump_interval).count()) ||
+        !last_dump.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+      return std::nullopt;
+    }
+
+    return reason;
+  }
+
+  std::optional<std::string>
+  recorder_t::frame_sent(const frame_t &frame) {
+    record(event_e::frame, {
+                             frame.index,
+                             frame.frame_type,
+                             (std::int64_t) frame.bytes,
+                             (std::int64_t) frame.shards,
+                             frame.fec_percentage,
+                             to_us(frame.processing_latency),
+                             to_us(frame.pacing_sleep),
+                           });
+
+    auto now = clock::now();
+    auto gap = last_frame ? now - *last_frame : clock::duration::zero();
+    last_frame = now;
+
+    if (stall_threshold > std::chrono::milliseconds::zero() && gap > stall_threshold) {
+      return trigger("frame gap of " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(gap).count()) + "ms");
+    }
+
+    return std::nullopt;
+  }
+
+  void
+  recorder_t::loss_report(std::int64_t lost_packets, std::int64_t interval_ms, std::int64_t last_good_frame) {
+    record(event_e::loss_report, { lost_packets, interval_ms, last_good_frame });
+  }
+
+  std::optional<std::string>
+  recorder_t::idr_request() {
+    record(event_e::idr_request, {});
+
+    auto now = clock::now();
+    std::rotate(std::begin(last_idr_requests), std::begin(last_idr_requests) + 1, std::end(last_idr_requests));
+    last_idr_requests.back() = now;
+
+    // The oldest of the remembered requests is recent as well
+    if (last_idr_requests.front() != clock::time_point {} && now - last_idr_requests.front() < idr_storm_window) {
+      return trigger(std::to_string(last_idr_requests.size()) + " IDR requests within " +
+                     std::to_string(std::chrono::duration_cast<std::chrono::seconds>(idr_storm_window).count()) + "s");
+    }
+
+    return std::nullopt;
+  }
+
+  void
+  recorder_t::rfi_request(std::int64_t first_frame, std::int64_t last_frame) {
+    record(event_e::rfi_request, { first_frame, last_frame });
+  }
+
+  void
+  recorder_t::dynamic_param(int type, std::int64_t value) {
+    record(event_e::dynamic_param, { type, value });
+  }
+
+  std::optional<std::string>
+  recorder_t::ping_timeout() {
+    record(event_e::ping_timeout, {});
+
+    return trigger("ping timeout");
+  }
+
+  std::string
+  recorder_t::export_json(std::string_view reason) const {
+    struct snapshot_t {
+      std::int64_t time;
+      event_e type;
+      std::array<std::int64_t, 7> values;
+    };
+
+    auto now = to_ns(clock::now());
+    auto since = now - std::chrono::nanoseconds(window).count();
+
+    auto end = head.load(std::memory_order_acquire);
+    auto begin = end > ring_size ? end - ring_size : 0;
+
+    std::vector<snapshot_t> events;
+    events.reserve(end - begin);
+    for (auto index = begin; index < end; ++index) {
+      auto &slot = (*slots)[index % ring_size];
+
+      // Skip events that are still being written or were overwritten while reading them
+      if (slot.seq.load(std::memory_order_acquire) != index + 1) {
+        continue;
+      }
+
+      snapshot_t event;
+      event.time = slot.time.load(std::memory_order_relaxed);
+      event.type = slot.type.load(std::memory_order_relaxed);
+      for (std::size_t x = 0; x < event.values.size(); ++x) {
+        event.values[x] = slot.values[x].load(std::memory_order_relaxed);
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != index + 1 || event.time < since) {
+        continue;
+      }
+
+      events.push_back(event);
+    }
+
+    // Writers claim slots in order, but may finish them out of order
+    std::stable_sort(std::begin(events), std::end(events), [](const snapshot_t &a, const snapshot_t &b) {
+      return a.time < b.time;
+    });
+
+    std::ostringstream out;
+    // Client names aren't necessarily valid UTF-8
+    out << R"({"session":)" << id << R"(,"client":)" << nlohmann::json(client_name).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace)
+        << R"(,"reason":)" << nlohmann::json(reason).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace)
+        << R"(,"window_ms":)" << std::chrono::milliseconds(window).count() << R"(,"events":[)";
+
+    bool first = true;
+    for (auto &event : events) {
+      if (!first) {
+        out << ',';
+      }
+      first = false;
+
+      // Milliseconds before the export
+      out << R"({"t":)";
+      write_ms(out, (event.time - now) / 1000);
+
+      auto &v = event.values;
+      switch (event.type) {
+        case event_e::frame:
+          out << R"(,"type":"frame","frame":)" << v[0] << R"(,"frame_type":)" << v[1] << R"(,"bytes":)" << v[2]
+              << R"(,"shards":)" << v[3] << R"(,"fec_percentage":)" << v[4] << R"(,"processing_ms":)";
+          write_ms(out, v[5]);
+          out << R"(,"pacing_ms":)";
+          write_ms(out, v[6]);
+          break;
+        case event_e::loss_report:
+          out << R"(,"type":"loss_report","lost_packets":)" << v[0] << R"(,"interval_ms":)" << v[1] << R"(,"last_good_frame":)" << v[2];
+          break;
+        case event_e::idr_request:
+          out << R"(,"type":"idr_request")";
+          break;
+        case event_e::rfi_request:
+          out << R"(,"type":"rfi_request","first_frame":)" << v[0] << R"(,"last_frame":)" << v[1];
+          break;
+        case event_e::dynamic_param:
+          out << R"(,"type":"dynamic_param","param":)" << v[0] << R"(,"value":)" << v[1];
+          break;
+        case event_e::ping_timeout:
+          out << R"(,"type":"ping_timeout")";
+          break;
+      }
+      out << '}';
+    }
+
+    out << "]}";
+    return out.str();
+  }
+
+  std::shared_ptr<recorder_t>
+  make_recorder(std::uint32_t session_id, std::string client_name, std::chrono::milliseconds stall_threshold) {
+    auto recorder = new recorder_t { session_id, std::move(client_name), stall_threshold };
+
+    std::lock_guard lg { recorders_mutex };
+    recorders.push_back(recorder);
+
+    return std::shared_ptr<recorder_t>(recorder, [](recorder_t *recorder) {
+      {
+        std::lock_guard lg { recorders_mutex };
+        std::erase(recorders, recorder);
+      }
+
+      delete recorder;
+    });
+  }
+
+  std::string
+  export_all_json() {
+    std::lock_guard lg { recorders_mutex };
+
+    std::string json = R"({"sessions":[)";
+    for (auto recorder : recorders) {
+      if (json.back() != '[') {
+        json += ',';
+      }
+      json += recorder->export_json("requested");
+    }
+    json += "]}";
+
+    return json;
+  }
+
+  std::filesystem::path
+  write_dump(const recorder_t &recorder, std::string_view reason, const std::filesystem::path &directory) {
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    if (ec) {
+      return {};
+    }
+
+    auto now = std::time(nullptr);
+    std::tm tm {};
+#ifdef _WIN32
+    localtime_s(&tm, &now);
+#else
+    localtime_r(&now, &tm);
+#endif
+
+    std::ostringstream name;
+    name << "session_" << recorder.session_id() << '_' << std::put_time(&tm, "%Y%m%d-%H%M%S") << ".json";
+    auto path = directory / name.str();
+
+    {
+      std::ofstream file { path, std::ios::binary | std::ios::trunc };
+      file << recorder.export_json(reason);
+      if (!file) {
+        return {};
+      }
+    }
+
+    // Keep the newest dumps, stalls tend to come in bunches
+    std::vector<std::pair<fs::file_time_type, fs::path>> dumps;
+    for (auto &entry : fs::directory_iterator { directory, ec }) {
+      auto filename = entry.path().filename().string();
+      if (filename.starts_with("session_") && entry.path().extension() == ".json") {
+        dumps.emplace_back(entry.last_write_time(ec), entry.path());
+      }
+    }
+
+    if (dumps.size() > max_dumps) {
+      std::sort(std::begin(dumps), std::end(dumps));
+      for (std::size_t x = 0; x < dumps.size() - max_dumps; ++x) {
+        fs::remove(dumps[x].second, ec);
+      }
+    }
+
+    return path;
+  }
+}  // namespace flight_recorder
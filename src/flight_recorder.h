@@ -0,0 +1,150 @@
+/**
+ * @file src/flight_recorder.h
+ * @brief Declarations for the flight recorder of streaming sessions.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace flight_recorder {
+  using clock = std::chrono::steady_clock;
+
+  // Events older than this are left out of dumps
+  constexpr auto window = std::chrono::seconds(10);
+
+  enum class event_e : std::uint32_t {
+    frame,  ///< A frame was sent
+    loss_report,  ///< The client reported lost packets
+    idr_request,  ///< The client requested an IDR frame
+    rfi_request,  ///< The client requested reference frame invalidation
+    dynamic_param,  ///< An encoder parameter was changed during the stream
+    ping_timeout,  ///< The client stopped responding
+  };
+
+  struct frame_t {
+    std::int64_t index;
+    int frame_type;  ///< As sent in the frame header: 1 for P frames, 2 for IDR frames, 5 for frames after RFI
+    std::size_t bytes;
+    std::size_t shards;
+    int fec_percentage;
+    clock::duration processing_latency;
+    clock::duration pacing_sleep;
+  };
+
+  /**
+   * @brief Keeps the recent events of a session in a ring buffer.
+   * @details Recording is lock-free and never allocates, so it's always on. The control stream,
+   * the video broadcast thread and the Web UI record into the same ring while it's being dumped.
+   */
+  class recorder_t {
+  public:
+    // Seconds of 240 FPS video with room for the requests of the client
+    static constexpr std::size_t ring_size = 4096;
+
+    recorder_t(std::uint32_t session_id, std::string client_name, std::chrono::milliseconds stall_threshold);
+
+    /**
+     * @brief Record a frame that was sent.
+     * @return The reason to dump the recorder, if the gap to the previous frame is a stall.
+     */
+    std::optional<std::string>
+    frame_sent(const frame_t &frame);
+
+    void
+    loss_report(std::int64_t lost_packets, std::int64_t interval_ms, std::int64_t last_good_frame);
+
+    /**
+     * @return The reason to dump the recorder, if the client keeps requesting IDR frames.
+     */
+    std::optional<std::string>
+    idr_request();
+
+    void
+    rfi_request(std::int64_t first_frame, std::int64_t last_frame);
+
+    void
+    dynamic_param(int type, std::int64_t value);
+
+    /**
+     * @return The reason to dump the recorder.
+     */
+    std::optional<std::string>
+    ping_timeout();
+
+    /**
+     * @brief Export the events of the last seconds.
+     * @param reason Why the recorder is dumped.
+     * @return A JSON object with the session and its events, timestamped in milliseconds before the export.
+     */
+    std::string
+    export_json(std::string_view reason) const;
+
+    std::uint32_t
+    session_id() const {
+      return id;
+    }
+
+  private:
+    struct slot_t {
+      // Index of the event plus one once it's complete, 0 while it's being written
+      std::atomic<std::uint64_t> seq;
+      std::atomic<std::int64_t> time;
+      std::atomic<event_e> type;
+      std::array<std::atomic<std::int64_t>, 7> values;
+    };
+
+    void
+    record(event_e type, std::initializer_list<std::int64_t> values);
+
+    /**
+     * @brief Limits automatic dumps, so a long stall doesn't produce a dump per frame.
+     */
+    std::optional<std::string>
+    trigger(std::string reason);
+
+    std::uint32_t id;
+    std::string client_name;
+    std::chrono::milliseconds stall_threshold;
+
+    std::unique_ptr<std::array<slot_t, ring_size>> slots;
+    std::atomic<std::uint64_t> head {};
+
+    // Only touched by the video broadcast thread
+    std::optional<clock::time_point> last_frame;
+
+    // Only touched by the control stream thread
+    std::array<clock::time_point, 3> last_idr_requests {};
+
+    // 0 until the first automatic dump
+    std::atomic<std::int64_t> last_dump {};
+  };
+
+  /**
+   * @brief Create the recorder of a new session.
+   * @details The recorder is included in export_all_json() until the returned pointer is destroyed.
+   * @param stall_threshold Frame gaps longer than this trigger a dump, 0 disables automatic dumps.
+   */
+  std::shared_ptr<recorder_t>
+  make_recorder(std::uint32_t session_id, std::string client_name, std::chrono::milliseconds stall_threshold);
+
+  /**
+   * @brief Export the recorders of all running sessions.
+   * @return A JSON object with a list of sessions.
+   */
+  std::string
+  export_all_json();
+
+  /**
+   * @brief Write a dump of the recorder to a file in directory, keeping only the newest dumps there.
+   * @return The path of the dump, or an empty path on failure.
+   */
+  std::filesystem::path
+  write_dump(const recorder_t &recorder, std::string_view reason, const std::filesystem::path &directory);
+}  // namespace flight_recorder
@@ -0,0 +1,139 @@
+/**
+ * @file src/frame_fingerprint.cpp
+ * @brief Definitions for fingerprinting captured frames.
+ */
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "frame_fingerprint.h"
+
+#if defined(__x86_64) || defined(__x86_64__) || defined(__amd64) || defined(__amd64__) || defined(_M_AMD64)
+  #include <immintrin.h>
+
+  #define FRAME_FINGERPRINT_X86
+#endif
+
+namespace video {
+  namespace {
+    // The accumulation is the one of XXH3, which keeps 4 independent 64-bit lanes per 32 bytes of input
+    using row_fn = void (*)(std::uint64_t *acc, const std::uint8_t *row, int size);
+
+    constexpr std::uint64_t prime64_1 = 0x9E3779B185EBCA87ULL;
+    constexpr std::uint64_t prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr std::uint64_t prime64_3 = 0x165667B19E3779F9ULL;
+
+    // Rotating through several keys makes the hash sensitive to blocks trading places within a row
+    constexpr int key_count = 8;
+    alignas(32) constexpr std::uint64_t keys[key_count][4] {
+      { 0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL },
+      { 0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL },
+      { 0xcb00c391bb52283cULL, 0xa32e531b8b65d088ULL, 0x4ef90da297486471ULL, 0xd8acdea946ef1938ULL },
+      { 0x3f349ce33f76faa8ULL, 0x1d4f0bc7c7bbdcf9ULL, 0x3159b4cd4be0518aULL, 0x647378d9c97e9fc8ULL },
+      { 0xc3ebd33483acc5eaULL, 0xeb6313faffa081c5ULL, 0x49daf0b751dd0d17ULL, 0x9e68d429265516d3ULL },
+      { 0xfca1477d58be162bULL, 0xce31d07ad1b8f88fULL, 0x280416958f3acb45ULL, 0x7e404bbbcafbd7afULL },
+      { 0x81dadae0c5066cbfULL, 0x8f2d00da6e3fd0beULL, 0x29bc5c30b91bc0efULL, 0xa54ca55b0d7c5227ULL },
+      { 0x3a2ff3d9da4b06c6ULL, 0xb5a0d5d7f6b0a2cbULL, 0x56bdb03ce1d1a62dULL, 0x84e4e1d9d48ab6c5ULL },
+    };
+
+    inline void
+    accumulate(std::uint64_t *acc, int lane, std::uint64_t data, std::uint64_t key) {
+      auto data_key = data ^ key;
+
+      acc[lane] += (data_key & 0xFFFFFFFF) * (data_key >> 32);
+      acc[lane ^ 1] += data;
+    }
+
+    /**
+     * @brief Accumulate the bytes that don't fill a whole block.
+     */
+    void
+    accumulate_tail(std::uint64_t *acc, const std::uint8_t *tail, int size) {
+      for (int x = 0; x < size; x += 8) {
+        std::uint64_t data = 0;
+        std::memcpy(&data, tail + x, std::min(8, size - x));
+
+        auto lane = (x / 8) & 3;
+        accumulate(acc, lane, data, keys[0][lane]);
+      }
+    }
+
+    void
+    accumulate_row_scalar(std::uint64_t *acc, const std::uint8_t *row, int size) {
+      int x = 0;
+      for (; x + 32 <= size; x += 32) {
+        auto &key = keys[(x / 32) % key_count];
+
+        for (int lane = 0; lane < 4; ++lane) {
+          std::uint64_t data;
+          std::memcpy(&data, row + x + lane * 8, 8);
+
+          accumulate(acc, lane, data, key[lane]);
+        }
+      }
+
+      accumulate_tail(acc, row + x, size - x);
+    }
+
+#ifdef FRAME_FINGERPRINT_X86
+    __attribute__((target("avx2"))) void
+    accumulate_row_avx2(std::uint64_t *acc, const std::uint8_t *row, int size) {
+      auto acc_vec = _mm256_loadu_si256((const __m256i *) acc);
+
+      int x = 0;
+      for (; x + 32 <= size; x += 32) {
+        auto data = _mm256_loadu_si256((const __m256i *) (row + x));
+        auto key = _mm256_load_si256((const __m256i *) keys[(x / 32) % key_count]);
+
+        auto data_key = _mm256_xor_si256(data, key);
+        auto data_key_hi = _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+
+        acc_vec = _mm256_add_epi64(acc_vec, _mm256_mul_epu32(data_key, data_key_hi));
+        acc_vec = _mm256_add_epi64(acc_vec, _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)));
+      }
+
+      _mm256_storeu_si256((__m256i *) acc, acc_vec);
+
+      accumulate_tail(acc, row + x, size - x);
+    }
+#endif
+
+    row_fn
+    select_accumulate_row(bool simd) {
+#ifdef FRAME_FINGERPRINT_X86
+      if (simd && __builtin_cpu_supports("avx2")) {
+        return accumulate_row_avx2;
+      }
+#endif
+      return accumulate_row_scalar;
+    }
+  }  // namespace
+
+  std::uint64_t
+  frame_fingerprint(const std::uint8_t *data, int row_pitch, int row_size, int height, bool simd) {
+    static const auto accumulate_row_best = select_accumulate_row(true);
+    auto accumulate_row = simd ? accumulate_row_best : accumulate_row_scalar;
+
+    std::uint64_t acc[4] { prime64_3, prime64_1, prime64_2, prime64_3 ^ prime64_1 };
+
+    for (int y = 0; y < height; ++y) {
+      accumulate_row(acc, data + (std::ptrdiff_t) y * row_pitch, row_size);
+
+      // Make the hash sensitive to rows trading places
+      for (auto &lane : acc) {
+        lane = std::rotl(lane, 17) * prime64_1;
+      }
+    }
+
+    std::uint64_t hash = (std::uint64_t) row_size * height * prime64_2;
+    for (auto lane : acc) {
+      hash = std::rotl(hash ^ lane, 27) * prime64_1;
+    }
+    hash ^= hash >> 29;
+    hash *= prime64_3;
+    hash ^= hash >> 32;
+
+    return hash;
+  }
+
+}  // namespace video
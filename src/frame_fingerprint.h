@@ -0,0 +1,24 @@
+/**
+ * @file src/frame_fingerprint.h
+ * @brief Declarations for fingerprinting captured frames.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace video {
+
+  /**
+   * @brief Hash the pixels of an image, to tell whether it's identical to the previous one.
+   * @details Every byte of every row is hashed, the padding at the end of the rows is ignored.
+   * Uses AVX2 when the CPU supports it, the result is the same either way.
+   * @param data The first row of the image.
+   * @param row_pitch Bytes from the start of one row to the start of the next.
+   * @param row_size Bytes of pixel data in each row.
+   * @param height Number of rows.
+   * @param simd Use AVX2 if available, only meant for testing.
+   */
+  std::uint64_t
+  frame_fingerprint(const std::uint8_t *data, int row_pitch, int row_size, int height, bool simd = true);
+
+}  // namespace video
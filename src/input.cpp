@@ -287,18 +287,27 @@ namespace input {
   void
   print(PNV_MULTI_CONTROLLER_PACKET packet) {
     // Moonlight spams controller packet even when not necessary
-    BOOST_LOG(verbose)
-      << "--begin controller packet--"sv << std::endl
-      << "controllerNumber ["sv << packet->controllerNumber << ']' << std::endl
-      << "activeGamepadMask ["sv << util::hex(packet->activeGamepadMask).to_string_view() << ']' << std::endl
-      << "buttonFlags ["sv << util::hex((uint32_t) packet->buttonFlags | (packet->buttonFlags2 << 16)).to_string_view() << ']' << std::endl
-      << "leftTrigger ["sv << util::hex(packet->leftTrigger).to_string_view() << ']' << std::endl
-      << "rightTrigger ["sv << util::hex(packet->rightTrigger).to_string_view() << ']' << std::endl
-      << "leftStickX ["sv << packet->leftStickX << ']' << std::endl
-      << "leftStickY ["sv << packet->leftStickY << ']' << std::endl
-      << "rightStickX ["sv << packet->rightStickX << ']' << std::endl
-      << "rightStickY ["sv << packet->rightStickY << ']' << std::endl
-      << "--end controller packet--"sv;
+    BINARY_LOG(verbose,
+      "--begin controller packet--\n"
+      "controllerNumber [{}]\n"
+      "activeGamepadMask [{}]\n"
+      "buttonFlags [{}]\n"
+      "leftTrigger [{}]\n"
+      "rightTrigger [{}]\n"
+      "leftStickX [{}]\n"
+      "leftStickY [{}]\n"
+      "rightStickX [{}]\n"
+      "rightStickY [{}]\n"
+      "--end controller packet--",
+      packet->controllerNumber,
+      util::hex(packet->activeGamepadMask).to_string_view(),
+      util::hex((uint32_t) packet->buttonFlags | (packet->buttonFlags2 << 16)).to_string_view(),
+      util::hex(packet->leftTrigger).to_string_view(),
+      util::hex(packet->rightTrigger).to_string_view(),
+      packet->leftStickX,
+      packet->leftStickY,
+      packet->rightStickX,
+      packet->rightStickY);
   }
 
   /**
@@ -379,14 +388,19 @@ namespace input {
    */
   void
   print(PSS_CONTROLLER_MOTION_PACKET packet) {
-    BOOST_LOG(verbose)
-      << "--begin controller motion packet--"sv << std::endl
-      << "controllerNumber ["sv << util::hex(packet->controllerNumber).to_string_view() << ']' << std::endl
-      << "motionType ["sv << util::hex(packet->motionType).to_string_view() << ']' << std::endl
-      << "x ["sv << from_netfloat(packet->x) << ']' << std::endl
-      << "y ["sv << from_netfloat(packet->y) << ']' << std::endl
-      << "z ["sv << from_netfloat(packet->z) << ']' << std::endl
-      << "--end controller motion packet--"sv;
+    BINARY_LOG(verbose,
+      "--begin controller motion packet--\n"
+      "controllerNumber [{}]\n"
+      "motionType [{}]\n"
+      "x [{}]\n"
+      "y [{}]\n"
+      "z [{}]\n"
+      "--end controller motion packet--",
+      util::hex(packet->controllerNumber).to_string_view(),
+      util::hex(packet->motionType).to_string_view(),
+      from_netfloat(packet->x),
+      from_netfloat(packet->y),
+      from_netfloat(packet->z));
   }
 
   /**
@@ -0,0 +1,227 @@
+/**
+ * @file src/log_tail.cpp
+ * @brief Definitions for reading parts of the log file.
+ */
+#include "log_tail.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+using namespace std::literals;
+
+namespace log_tail {
+  namespace bip = boost::interprocess;
+
+  namespace {
+    /**
+     * Maps a part of the log. The log keeps growing while it's mapped, only the mapped part is read.
+     */
+    class mapping_t {
+    public:
+      mapping_t(const std::filesystem::path &path, std::uint64_t begin, std::uint64_t end):
+          file { path.c_str(), bip::read_only },
+          region { file, bip::read_only, (bip::offset_t) begin, (std::size_t) (end - begin) } {}
+
+      std::string_view
+      text() const {
+        return { (const char *) region.get_address(), region.get_size() };
+      }
+
+    private:
+      bip::file_mapping file;
+      bip::mapped_region region;
+    };
+
+    std::optional<std::uint64_t>
+    to_number(std::string_view text) {
+      if (text.empty()) {
+        return std::nullopt;
+      }
+
+      std::uint64_t value;
+      auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+      if (ec != std::errc {} || ptr != text.data() + text.size()) {
+        return std::nullopt;
+      }
+
+      return value;
+    }
+  }  // namespace
+
+  std::optional<int>
+  line_level(std::string_view line) {
+    // [2024-01-01 12:00:00.000]: Info: message
+    static constexpr std::array levels {
+      "Verbose: "sv,
+      "Debug: "sv,
+      "Info: "sv,
+      "Warning: "sv,
+      "Error: "sv,
+      "Fatal: "sv,
+    };
+
+    if (!line.starts_with('[')) {
+      return std::nullopt;
+    }
+
+    auto prefix_end = line.find("]: "sv);
+    if (prefix_end == std::string_view::npos) {
+      return std::nullopt;
+    }
+    line.remove_prefix(prefix_end + 3);
+
+    for (int level = 0; level < levels.size(); ++level) {
+      if (line.starts_with(levels[level])) {
+        return level;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  std::optional<chunk_t>
+  read(const std::filesystem::path &path, const query_t &query) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    if (ec) {
+      return std::nullopt;
+    }
+
+    chunk_t chunk {
+      .begin = 0,
+      .end = 0,
+      .size = size,
+      .reset = false,
+    };
+
+    auto begin = query.offset.value_or(size > max_chunk ? size - max_chunk : 0);
+    if (begin > size) {
+      // The log was started over
+      begin = 0;
+      chunk.reset = true;
+    }
+    auto end = std::min(size, begin + max_chunk);
+
+    chunk.begin = chunk.end = begin;
+    if (begin == end) {
+      return chunk;
+    }
+
+    try {
+      mapping_t mapping { path, begin, end };
+      auto all = mapping.text();
+
+      // The last lines of the log start after the first line break
+      std::size_t first = 0;
+      if (!query.offset && begin > 0) {
+        auto line_break = all.find('\n');
+        first = line_break == std::string_view::npos ? all.size() : line_break + 1;
+      }
+
+      // A line that's still being written is read once it's complete
+      std::size_t stop = first;
+      auto last = all.rfind('\n');
+      if (last != std::string_view::npos && last + 1 > first) {
+        stop = last + 1;
+      }
+      else if (query.offset && all.size() == max_chunk) {
+        // The line won't ever fit a chunk
+        stop = all.size();
+      }
+
+      chunk.end = begin + stop;
+      auto text = all.substr(first, stop - first);
+
+      std::optional<int> level;
+      while (!text.empty()) {
+        auto line_end = text.find('\n');
+        auto line = text.substr(0, line_end);
+        text.remove_prefix(line_end == std::string_view::npos ? text.size() : line_end + 1);
+
+        if (!line.empty() && line.back() == '\r') {
+          line.remove_suffix(1);
+        }
+
+        if (auto found = line_level(line)) {
+          level = found;
+        }
+
+        // Lines that continue a message from before the chunk have an unknown level
+        if (query.min_level > 0 && (!level || *level < query.min_level)) {
+          continue;
+        }
+        if (!query.filter.empty() && line.find(query.filter) == std::string_view::npos) {
+          continue;
+        }
+
+        chunk.lines.emplace_back(line);
+      }
+    }
+    catch (const bip::interprocess_exception &) {
+      return std::nullopt;
+    }
+
+    return chunk;
+  }
+
+  std::optional<std::string>
+  read_range(const std::filesystem::path &path, std::uint64_t begin, std::uint64_t end) {
+    if (begin >= end) {
+      return std::string {};
+    }
+
+    try {
+      mapping_t mapping { path, begin, end };
+      return std::string { mapping.text() };
+    }
+    catch (const bip::interprocess_exception &) {
+      return std::nullopt;
+    }
+  }
+
+  std::optional<range_t>
+  parse_range(std::string_view header, std::uint64_t size) {
+    if (!header.starts_with("bytes="sv)) {
+      return std::nullopt;
+    }
+    header.remove_prefix(6);
+
+    auto dash = header.find('-');
+    if (dash == std::string_view::npos || header.find(',') != std::string_view::npos) {
+      return std::nullopt;
+    }
+
+    auto first = header.substr(0, dash);
+    auto last = header.substr(dash + 1);
+
+    // bytes=-100 are the last 100 bytes
+    if (first.empty()) {
+      auto length = to_number(last);
+      if (!length || *length == 0 || size == 0) {
+        return std::nullopt;
+      }
+
+      return range_t { size - std::min(*length, size), size };
+    }
+
+    auto begin = to_number(first);
+    if (!begin || *begin >= size) {
+      return std::nullopt;
+    }
+
+    if (last.empty()) {
+      return range_t { *begin, size };
+    }
+
+    auto end = to_number(last);
+    if (!end || *end < *begin) {
+      return std::nullopt;
+    }
+
+    return range_t { *begin, std::min(*end + 1, size) };
+  }
+}  // namespace log_tail
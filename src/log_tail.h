@@ -0,0 +1,87 @@
+/**
+ * @file src/log_tail.h
+ * @brief Declarations for reading parts of the log file.
+ */
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Reads the new lines of the log, so the Web UI doesn't download the whole log on every poll.
+ */
+namespace log_tail {
+  // A single read covers at most this much of the log, the rest is left for the next read
+  constexpr std::uint64_t max_chunk = 1 << 20;
+
+  struct query_t {
+    /**
+     * Where to continue reading, usually the end of the previous chunk.
+     * Without an offset, reading starts at the last lines of the log.
+     */
+    std::optional<std::uint64_t> offset;
+
+    /**
+     * Lines below this level are left out, lines that continue a multi-line message have its level.
+     */
+    int min_level = 0;
+
+    /**
+     * Only lines that contain this text are returned.
+     */
+    std::string filter;
+  };
+
+  struct chunk_t {
+    std::uint64_t begin;  ///< Offset of the first byte that was read
+    std::uint64_t end;  ///< Offset to continue reading at, after the last complete line that was read
+    std::uint64_t size;  ///< Size of the log
+    bool reset;  ///< The log was truncated since the offset, so reading started over
+    std::vector<std::string> lines;
+  };
+
+  /**
+   * @brief Read the complete lines after an offset that match the query.
+   * @param path The log file.
+   * @param query What to read.
+   * @return The lines, or std::nullopt if the log couldn't be read.
+   */
+  std::optional<chunk_t>
+  read(const std::filesystem::path &path, const query_t &query);
+
+  /**
+   * @brief Read a range of bytes of the log.
+   * @param path The log file.
+   * @param begin The first byte.
+   * @param end The byte after the last one.
+   * @return The bytes, or std::nullopt if the log couldn't be read.
+   */
+  std::optional<std::string>
+  read_range(const std::filesystem::path &path, std::uint64_t begin, std::uint64_t end);
+
+  struct range_t {
+    std::uint64_t begin;
+    std::uint64_t end;  ///< The byte after the last one
+  };
+
+  /**
+   * @brief Parse the value of a Range header with a single range of bytes.
+   * @param header The value of the header, e.g. "bytes=100-199", "bytes=100-" or "bytes=-100".
+   * @param size The size of the file.
+   * @return The range clamped to the file, or std::nullopt if it can't be satisfied.
+   */
+  std::optional<range_t>
+  parse_range(std::string_view header, std::uint64_t size);
+
+  /**
+   * @brief Get the level of a line of the log.
+   * @param line The line.
+   * @return The level, or std::nullopt if the line continues a multi-line message.
+   */
+  std::optional<int>
+  line_level(std::string_view line);
+}  // namespace log_tail
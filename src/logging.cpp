@@ -8,6 +8,8 @@
 #include <iostream>
 #include <filesystem>
 #include <ctime>
+#include <sstream>
+#include <vector>
 
 // lib includes
 #include <boost/core/null_deleter.hpp>
@@ -31,6 +33,9 @@ namespace bl = boost::log;
 
 boost::shared_ptr<boost::log::sinks::asynchronous_sink<boost::log::sinks::text_ostream_backend>> sink;
 
+// The streams of the sink, BINARY_LOG() writes to them as well
+std::vector<boost::shared_ptr<std::ostream>> streams;
+
 bl::sources::severity_logger<int> verbose(0);  // Dominating output
 bl::sources::severity_logger<int> debug(1);  // Follow what is happening
 bl::sources::severity_logger<int> info(2);  // Should be informed about
@@ -50,9 +55,11 @@ namespace logging {
 
   void
   deinit() {
+    binary_log::stop();
     log_flush();
     bl::core::get()->remove_sink(sink);
     sink.reset();
+    streams.clear();
   }
 
   /**
@@ -115,12 +122,7 @@ namespace logging {
   }
 
   void
-  formatter(const boost::log::record_view &view, boost::log::formatting_ostream &os) {
-    constexpr const char *message = "Message";
-    constexpr const char *severity = "Severity";
-
-    auto log_level = view.attribute_values()[severity].extract<int>().get();
-
+  write_prefix(std::ostream &os, int log_level, std::chrono::system_clock::time_point time) {
     std::string_view log_type;
     switch (log_level) {
       case 0:
@@ -148,15 +150,45 @@ namespace logging {
 #endif
     };
 
-    auto now = std::chrono::system_clock::now();
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-      now - std::chrono::time_point_cast<std::chrono::seconds>(now));
+      time - std::chrono::time_point_cast<std::chrono::seconds>(time));
 
-    auto t = std::chrono::system_clock::to_time_t(now);
+    auto t = std::chrono::system_clock::to_time_t(time);
     auto lt = *std::localtime(&t);
 
     os << "["sv << std::put_time(&lt, "%Y-%m-%d %H:%M:%S.") << boost::format("%03u") % ms.count() << "]: "sv
-       << log_type << view.attribute_values()[message].extract<std::string>();
+       << log_type;
+  }
+
+  void
+  formatter(const boost::log::record_view &view, boost::log::formatting_ostream &os) {
+    constexpr const char *message = "Message";
+    constexpr const char *severity = "Severity";
+
+    auto log_level = view.attribute_values()[severity].extract<int>().get();
+
+    write_prefix(os.stream(), log_level, std::chrono::system_clock::now());
+    os << view.attribute_values()[message].extract<std::string>();
+  }
+
+  /**
+   * @brief Write the lines of BINARY_LOG() to the streams of the sink.
+   * @details The lines of a batch are written at once, while the sink isn't writing lines of its own.
+   */
+  void
+  write_lines(const std::vector<binary_log::line_t> &lines) {
+    std::ostringstream batch;
+    for (auto &line : lines) {
+      write_prefix(batch, line.level, line.time);
+      batch << line.message << '\n';
+    }
+    auto text = batch.str();
+
+    auto backend = sink->locked_backend();
+    for (auto &stream : streams) {
+      stream->write(text.data(), text.size());
+      stream->flush();
+    }
   }
 
   /**
@@ -181,8 +213,7 @@ namespace logging {
     sink = boost::make_shared<text_sink>();
 
 #ifndef SUNSHINE_TESTS
-    boost::shared_ptr<std::ostream> stream { &std::cout, boost::null_deleter() };
-    sink->locked_backend()->add_stream(stream);
+    streams.emplace_back(&std::cout, boost::null_deleter());
 #endif
     
     // 转写现有日志文件
@@ -191,7 +222,10 @@ namespace logging {
     }
 
     std::ios_base::openmode mode = std::ios_base::out;
-    sink->locked_backend()->add_stream(boost::make_shared<std::ofstream>(log_file, mode));
+    streams.emplace_back(boost::make_shared<std::ofstream>(log_file, mode));
+    for (auto &stream : streams) {
+      sink->locked_backend()->add_stream(stream);
+    }
     sink->set_filter(severity >= min_log_level);
     sink->set_formatter(&formatter);
 
@@ -200,6 +234,7 @@ namespace logging {
     sink->locked_backend()->auto_flush(true);
 
     bl::core::get()->add_sink(sink);
+    binary_log::start(&write_lines, min_log_level);
     return std::make_unique<deinit_t>();
   }
 
@@ -239,6 +274,7 @@ namespace logging {
 
   void
   log_flush() {
+    binary_log::flush();
     if (sink) {
       sink->flush();
     }
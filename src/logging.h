@@ -20,6 +20,7 @@ extern boost::log::sources::severity_logger<int> fatal;
 extern boost::log::sources::severity_logger<int> tests;
 #endif
 
+#include "binary_log.h"
 #include "config.h"
 #include "stat_trackers.h"
 
@@ -47,6 +48,15 @@ namespace logging {
   void
   formatter(const boost::log::record_view &view, boost::log::formatting_ostream &os);
 
+  /**
+   * @brief Write the timestamp and level that start every line of the log.
+   * @param os The stream to write to.
+   * @param log_level The level of the line.
+   * @param time When the line was logged.
+   */
+  void
+  write_prefix(std::ostream &os, int log_level, std::chrono::system_clock::time_point time);
+
   /**
    * @brief Initialize the logging system.
    * @param min_log_level The minimum log level to output.
@@ -68,7 +78,7 @@ namespace logging {
   setup_av_logging(int min_log_level);
 
   /**
-   * @brief Flush the log.
+   * @brief Flush the log, including the lines of BINARY_LOG() that weren't written yet.
    * @examples
    * log_flush();
    * @examples_end
@@ -88,6 +98,7 @@ namespace logging {
 
   /**
    * @brief A helper class for tracking and logging numerical values across a period of time
+   * @details Besides min, max and average, the percentiles show how often the worst values occur.
    * @examples
    * min_max_avg_periodic_logger<int> logger(debug, "Test time value", "ms", 5s);
    * logger.collect_and_log(1);
@@ -96,7 +107,7 @@ namespace logging {
    * // after 5 seconds
    * logger.collect_and_log(3);
    * // In the log:
-   * // [2024:01:01:12:00:00]: Debug: Test time value (min/max/avg): 1ms/3ms/2.00ms
+   * // [2024:01:01:12:00:00]: Debug: Test time value (min/p50/p90/p99/p99.9/max/avg): 1ms/1.00ms/2.00ms/2.00ms/2.00ms/2ms/1.50ms
    * @examples_end
    */
   template <typename T>
@@ -115,13 +126,21 @@ namespace logging {
     void
     collect_and_log(const T &value) {
       if (enabled) {
-        auto print_info = [&](const T &min_value, const T &max_value, double avg_value) {
+        auto print_info = [&](const stat_trackers::percentile_tracker<T> &stats) {
           auto f = stat_trackers::two_digits_after_decimal();
+          auto percentiles = [&]() {
+            std::string text;
+            for (auto percentile : { 50.0, 90.0, 99.0, 99.9 }) {
+              text += (stat_trackers::two_digits_after_decimal() % stats.percentile(percentile)).str() + units + "/";
+            }
+            return text;
+          };
+
           if constexpr (std::is_floating_point_v<T>) {
-            BOOST_LOG(severity.get()) << message << " (min/max/avg): " << f % min_value << units << "/" << f % max_value << units << "/" << f % avg_value << units;
+            BOOST_LOG(severity.get()) << message << " (min/p50/p90/p99/p99.9/max/avg): " << f % stats.min() << units << "/" << percentiles() << f % stats.max() << units << "/" << f % stats.mean() << units;
           }
           else {
-            BOOST_LOG(severity.get()) << message << " (min/max/avg): " << min_value << units << "/" << max_value << units << "/" << f % avg_value << units;
+            BOOST_LOG(severity.get()) << message << " (min/p50/p90/p99/p99.9/max/avg): " << (T) stats.min() << units << "/" << percentiles() << (T) stats.max() << units << "/" << f % stats.mean() << units;
           }
         };
         tracker.collect_and_callback_on_interval(value, print_info, interval);
@@ -149,7 +168,7 @@ namespace logging {
     std::string units;
     std::chrono::seconds interval;
     bool enabled;
-    stat_trackers::min_max_avg_tracker<T> tracker;
+    stat_trackers::percentile_tracker<T> tracker;
   };
 
   /**
@@ -164,7 +183,7 @@ namespace logging {
    * // ...
    * logger.second_point_now_and_log();
    * // In the log:
-   * // [2024:01:01:12:00:00]: Debug: Test duration (min/max/avg): 1.23ms/3.21ms/2.31ms
+   * // [2024:01:01:12:00:00]: Debug: Test duration (min/p50/p90/p99/p99.9/max/avg): 1.23ms/2.30ms/3.21ms/3.21ms/3.21ms/3.21ms/2.31ms
    * @examples_end
    */
   class time_delta_periodic_logger {
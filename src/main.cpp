@@ -3,6 +3,7 @@
  * @brief Definitions for the main entry point for Sunshine.
  */
 // standard includes
+#include <chrono>
 #include <codecvt>
 #include <csignal>
 #include <fstream>
@@ -293,15 +294,31 @@ main(int argc, char *argv[]) {
   SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
 #endif
 
+  // Log when each phase of the startup completes, relative to the start of the first one
+  auto startup_begin = std::chrono::steady_clock::now();
+  auto startup_phase = [startup_begin](std::string_view phase) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startup_begin);
+    BOOST_LOG(info) << "Startup: "sv << phase << " at "sv << elapsed.count() << "ms"sv;
+  };
+
   proc::refresh(config::stream.file_apps);
 
   // If any of the following fail, we log an error and continue event though sunshine will not function correctly.
   // This allows access to the UI to fix configuration problems or view the logs.
+  //
+  // Everything that clients need to find and pair with the host only depends on the platform
+  // and the HTTP certificates, so it starts right away. Probing the encoders takes the longest
+  // and only matters once a client asks for its codecs or launches a stream, so it runs in the
+  // background and the requests that need it wait for it.
 
   auto platf_deinit_guard = platf::init();
   if (!platf_deinit_guard) {
     BOOST_LOG(error) << "Platform failed to initialize"sv;
   }
+  startup_phase("platform initialized"sv);
+
+  video::probe_encoders_async();
+  startup_phase("encoder probe started"sv);
 
   auto proc_deinit_guard = proc::init();
   if (!proc_deinit_guard) {
@@ -314,10 +331,7 @@ main(int argc, char *argv[]) {
   if (input::probe_gamepads()) {
     BOOST_LOG(warning) << "No gamepad input is available"sv;
   }
-
-  if (video::probe_encoders()) {
-    BOOST_LOG(error) << "Video failed to find working encoder"sv;
-  }
+  startup_phase("input initialized"sv);
 
   if (http::init()) {
     BOOST_LOG(fatal) << "HTTP interface failed to initialize"sv;
@@ -329,13 +343,15 @@ main(int argc, char *argv[]) {
 
     return -1;
   }
+  startup_phase("HTTP certificates loaded"sv);
 
   std::unique_ptr<platf::deinit_t> mDNS;
   std::future<void> sync_mDNS;
   if (config::sunshine.flags[config::flag::MDNS_BROADCAST]) {
     BOOST_LOG(info) << "mDNS broadcast enabled"sv;
-    sync_mDNS = std::async(std::launch::async, [&mDNS]() {
+    sync_mDNS = std::async(std::launch::async, [&mDNS, startup_phase]() {
       mDNS = platf::publish::start();
+      startup_phase("mDNS published"sv);
     });
   }
 
@@ -352,6 +368,7 @@ main(int argc, char *argv[]) {
   std::thread httpThread {nvhttp::start};
   std::thread configThread {confighttp::start};
   std::thread rtspThread {rtsp_stream::start};
+  startup_phase("network services started"sv);
 
 #ifdef _WIN32
   // If we're using the default port and GameStream is enabled, warn the user
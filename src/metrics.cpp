@@ -0,0 +1,244 @@
+/**
+ * @file src/metrics.cpp
+ * @brief Definitions for the runtime metrics of the streaming pipeline.
+ */
+#include "metrics.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <vector>
+
+#include "thread_safe.h"
+
+namespace metrics {
+  global_t global;
+
+  namespace {
+    struct counter_info_t {
+      const char *name;
+      const char *help;
+      counter_t session_t::*member;
+
+      // Counters kept in nanoseconds are exported in seconds
+      bool ns_to_seconds;
+    };
+
+    constexpr counter_info_t session_counters[] {
+      { "frames_sent_total", "Video frames sent to clients.", &session_t::frames_sent, false },
+      { "encoded_bytes_total", "Bytes of encoded video sent to clients, before FEC and encryption.", &session_t::encoded_bytes, false },
+      { "fec_shards_total", "Video FEC parity shards sent to clients.", &session_t::fec_shards, false },
+      { "send_errors_total", "Video and audio packets that could not be sent.", &session_t::send_errors, false },
+      { "pacing_sleep_seconds_total", "Time the video broadcast thread slept to pace out frames.", &session_t::pacing_sleep_ns, true },
+      { "client_lost_packets_total", "Video packets the clients reported as lost.", &session_t::client_lost_packets, false },
+      { "audio_packets_total", "Audio packets sent to clients.", &session_t::audio_packets, false },
+      { "input_events_total", "Input packets received from clients.", &session_t::input_events, false },
+    };
+
+    // Upper bounds of the exported buckets of latencies, from 0.5ms up to 1s
+    constexpr std::uint64_t latency_bounds_us[] { 500, 1000, 2000, 4000, 8000, 12000, 16000, 25000, 50000, 100000, 1000000 };
+
+    // Setting up an encoder takes much longer than encoding a frame
+    constexpr std::uint64_t startup_bounds_us[] { 50000, 100000, 250000, 500000, 1000000, 2000000, 5000000, 10000000 };
+
+    struct histogram_info_t {
+      const char *name;
+      const char *help;
+      histogram_t session_t::*member;
+    };
+
+    constexpr histogram_info_t session_histograms[] {
+      { "encode_latency_seconds", "Time the encoder took to return a frame.", &session_t::encode_latency },
+      { "frame_processing_latency_seconds", "Time from capturing a frame until it was packetized, as reported to the client.", &session_t::frame_processing_latency },
+    };
+
+    std::mutex sessions_mutex;
+    std::vector<session_t *> sessions;
+
+    // Collects the counters of sessions that ended, so the totals never go backwards
+    session_t retired;
+
+    void
+    retire(session_t *session) {
+      {
+        std::lock_guard lg { sessions_mutex };
+
+        std::erase(sessions, session);
+
+        for (auto &counter : session_counters) {
+          (retired.*counter.member).add((session->*counter.member).get());
+        }
+        for (auto &histogram : session_histograms) {
+          (retired.*histogram.member).merge(session->*histogram.member);
+        }
+      }
+
+      delete session;
+    }
+
+    void
+    write_seconds(std::ostream &out, std::uint64_t us) {
+      out << us / 1000000 << '.' << std::setw(6) << std::setfill('0') << us % 1000000;
+    }
+
+    /**
+     * Label values are escaped as the text format of Prometheus requires, which isn't JSON:
+     * only backslashes, quotes and line feeds are escaped.
+     */
+    void
+    write_labels(std::ostream &out, const session_t &session) {
+      out << "{session=\"" << session.id << "\",client=\"";
+      for (auto ch : session.client_name) {
+        if (ch == '\n') {
+          out << "\\n";
+          continue;
+        }
+
+        if (ch == '"' || ch == '\\') {
+          out << '\\';
+        }
+        out << ch;
+      }
+      out << "\"}";
+    }
+
+    void
+    write_family(std::ostream &out, std::string_view name, std::string_view type, std::string_view help) {
+      out << "# HELP sunshine_" << name << ' ' << help << '\n'
+          << "# TYPE sunshine_" << name << ' ' << type << '\n';
+    }
+
+    void
+    write_counter(std::ostream &out, const counter_info_t &info, std::uint64_t value) {
+      if (info.ns_to_seconds) {
+        write_seconds(out, value / 1000);
+      }
+      else {
+        out << value;
+      }
+      out << '\n';
+    }
+
+    /**
+     * The buckets are counted from the histogram, so each bound is as precise as the histogram.
+     */
+    void
+    write_histogram(std::ostream &out, std::string_view name, const std::string &labels, const histogram_t &histogram, std::span<const std::uint64_t> bounds_us) {
+      auto &us = histogram.microseconds();
+
+      // Labels are merged with le, so drop the closing brace
+      auto prefix = labels.empty() ? std::string { "{" } : labels.substr(0, labels.size() - 1) + ',';
+
+      for (auto bound : bounds_us) {
+        out << "sunshine_" << name << "_bucket" << prefix << "le=\"";
+        write_seconds(out, bound);
+        out << "\"} " << us.count_at_or_below(bound) << '\n';
+      }
+      out << "sunshine_" << name << "_bucket" << prefix << "le=\"+Inf\"} " << us.count() << '\n';
+
+      out << "sunshine_" << name << "_sum" << labels << ' ';
+      write_seconds(out, us.sum());
+      out << '\n';
+      out << "sunshine_" << name << "_count" << labels << ' ' << us.count() << '\n';
+    }
+  }  // namespace
+
+  std::shared_ptr<session_t>
+  make_session(std::uint32_t id, std::string client_name) {
+    auto session = new session_t;
+    session->id = id;
+    session->client_name = std::move(client_name);
+
+    std::lock_guard lg { sessions_mutex };
+    sessions.push_back(session);
+
+    return std::shared_ptr<session_t>(session, retire);
+  }
+
+  std::string
+  export_prometheus() {
+    std::ostringstream out;
+
+    write_family(out, "frames_captured_total", "counter", "Frames captured from the display.");
+    out << "sunshine_frames_captured_total " << global.frames_captured.get() << '\n';
+
+    write_family(out, "frames_encoded_total", "counter", "Frames encoded for all sessions.");
+    out << "sunshine_frames_encoded_total " << global.frames_encoded.get() << '\n';
+
+    write_family(out, "warm_encoders_reused_total", "counter", "Streams that reused the encoder of a stream that ended recently.");
+    out << "sunshine_warm_encoders_reused_total " << global.warm_encoders_reused.get() << '\n';
+
+    write_family(out, "time_to_first_frame_seconds", "histogram", "Time from setting up the encoder until the first frame of a stream was encoded.");
+    write_histogram(out, "time_to_first_frame_seconds", {}, global.time_to_first_frame, startup_bounds_us);
+
+    write_family(out, "queue_dropped_elements_total", "counter", "Frames, packets and events dropped by full internal queues.");
+    out << "sunshine_queue_dropped_elements_total " << safe::dropped_elements.load(std::memory_order_relaxed) << '\n';
+
+    // Sessions only register and unregister under the lock, their metrics are read without stopping them
+    std::lock_guard lg { sessions_mutex };
+
+    write_family(out, "sessions", "gauge", "Streaming sessions currently running.");
+    out << "sunshine_sessions " << sessions.size() << '\n';
+
+    std::vector<std::string> labels;
+    for (auto session : sessions) {
+      std::ostringstream label;
+      write_labels(label, *session);
+      labels.emplace_back(label.str());
+    }
+
+    // Totals include the sessions that ended, the session_ families only the running ones
+    for (auto &info : session_counters) {
+      auto total = (retired.*info.member).get();
+      for (auto session : sessions) {
+        total += (session->*info.member).get();
+      }
+
+      write_family(out, info.name, "counter", info.help);
+      out << "sunshine_" << info.name << ' ';
+      write_counter(out, info, total);
+
+      auto name = std::string { "session_" } + info.name;
+      write_family(out, name, "counter", info.help);
+      for (std::size_t x = 0; x < sessions.size(); ++x) {
+        out << "sunshine_" << name << labels[x] << ' ';
+        write_counter(out, info, (sessions[x]->*info.member).get());
+      }
+    }
+
+    for (auto &info : session_histograms) {
+      histogram_t total;
+      total.merge(retired.*info.member);
+      for (auto session : sessions) {
+        total.merge(session->*info.member);
+      }
+
+      write_family(out, info.name, "histogram", info.help);
+      write_histogram(out, info.name, {}, total, latency_bounds_us);
+
+      auto name = std::string { "session_" } + info.name;
+      write_family(out, name, "histogram", info.help);
+      for (std::size_t x = 0; x < sessions.size(); ++x) {
+        write_histogram(out, name, labels[x], sessions[x]->*info.member, latency_bounds_us);
+      }
+    }
+
+    write_family(out, "session_rtt_seconds", "gauge", "Round trip time of the control stream.");
+    for (std::size_t x = 0; x < sessions.size(); ++x) {
+      out << "sunshine_session_rtt_seconds" << labels[x] << ' ';
+      write_seconds(out, std::max<std::int64_t>(sessions[x]->rtt_ms.get(), 0) * 1000);
+      out << '\n';
+    }
+
+    write_family(out, "session_rtt_variance_seconds", "gauge", "Variance of the round trip time of the control stream.");
+    for (std::size_t x = 0; x < sessions.size(); ++x) {
+      out << "sunshine_session_rtt_variance_seconds" << labels[x] << ' ';
+      write_seconds(out, std::max<std::int64_t>(sessions[x]->rtt_variance_ms.get(), 0) * 1000);
+      out << '\n';
+    }
+
+    return out.str();
+  }
+}  // namespace metrics
@@ -0,0 +1,139 @@
+/**
+ * @file src/metrics.h
+ * @brief Declarations for the runtime metrics of the streaming pipeline.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "stat_trackers.h"
+
+namespace metrics {
+  /**
+   * @brief A monotonic count, updated with a single relaxed atomic add.
+   */
+  class counter_t {
+  public:
+    void
+    add(std::uint64_t n = 1) {
+      value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    std::uint64_t
+    get() const {
+      return value.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<std::uint64_t> value {};
+  };
+
+  /**
+   * @brief A value that goes up and down, such as the round trip time of a client.
+   */
+  class gauge_t {
+  public:
+    void
+    set(std::int64_t n) {
+      value.store(n, std::memory_order_relaxed);
+    }
+
+    std::int64_t
+    get() const {
+      return value.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<std::int64_t> value {};
+  };
+
+  /**
+   * @brief Distribution of latencies, kept in microseconds.
+   * @details Observing is lock-free, so histograms of different sessions can be read and merged
+   * without stopping the threads that fill them.
+   */
+  class histogram_t {
+  public:
+    void
+    observe(std::chrono::steady_clock::duration duration) {
+      us.record(std::max<std::int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count(), 0));
+    }
+
+    /**
+     * @brief Add the observations of another histogram to this one.
+     */
+    void
+    merge(const histogram_t &other) {
+      us.merge(other.us);
+    }
+
+    const stat_trackers::hdr_histogram &
+    microseconds() const {
+      return us;
+    }
+
+  private:
+    stat_trackers::hdr_histogram us;
+  };
+
+  /**
+   * @brief The metrics of a single streaming session.
+   * @details The threads of the session update these directly, scrapes only read them.
+   */
+  struct session_t {
+    std::uint32_t id;
+    std::string client_name;
+
+    counter_t frames_sent;
+    counter_t encoded_bytes;
+    counter_t fec_shards;
+    counter_t send_errors;
+    counter_t pacing_sleep_ns;
+    counter_t client_lost_packets;
+    counter_t audio_packets;
+    counter_t input_events;
+
+    histogram_t encode_latency;
+    histogram_t frame_processing_latency;
+
+    // Reported by ENet for the control stream
+    gauge_t rtt_ms;
+    gauge_t rtt_variance_ms;
+  };
+
+  /**
+   * @brief Metrics that aren't tied to a single session.
+   */
+  struct global_t {
+    counter_t frames_captured;
+    counter_t frames_encoded;
+
+    // Encoders of ended streams that were reused by the next stream
+    counter_t warm_encoders_reused;
+
+    // From the start of setting up the encoder until the first frame of a stream was encoded
+    histogram_t time_to_first_frame;
+  };
+
+  extern global_t global;
+
+  /**
+   * @brief Register the metrics of a new session.
+   * @details The session is exported until the returned pointer is destroyed,
+   * after which its counters are kept in the totals of all sessions.
+   */
+  std::shared_ptr<session_t>
+  make_session(std::uint32_t id, std::string client_name);
+
+  /**
+   * @brief Export all metrics.
+   * @return The metrics in the Prometheus text exposition format.
+   */
+  std::string
+  export_prometheus();
+}  // namespace metrics
@@ -774,7 +774,19 @@ namespace nvhttp {
     tree.put("root.uniqueid", http::unique_id);
     tree.put("root.HttpsPort", net::map_port(PORT_HTTPS));
     tree.put("root.ExternalPort", net::map_port(PORT_HTTP));
-    tree.put("root.MaxLumaPixelsHEVC", video::active_hevc_mode > 1 ? "1869449984" : "0");
+
+    // The server handles every request on a single thread, so the results of the background
+    // encoder probe aren't waited for. Clients poll serverinfo and see the other codecs once it is done
+    auto probed = !video::probing_encoders();
+    if (!probed) {
+      BOOST_LOG(warning) << "Encoders are still being probed, reporting H.264 support only"sv;
+    }
+
+    auto active_hevc_mode = probed ? video::active_hevc_mode : 1;
+    auto active_av1_mode = probed ? video::active_av1_mode : 1;
+    auto supported_yuv444_for_codec = probed ? video::last_encoder_probe_supported_yuv444_for_codec : std::array<bool, 3> {};
+
+    tree.put("root.MaxLumaPixelsHEVC", active_hevc_mode > 1 ? "1869449984" : "0");
 
     // Only include the MAC address for requests sent from paired clients over HTTPS.
     // For HTTP requests, use a placeholder MAC address that Moonlight knows to ignore.
@@ -802,30 +814,30 @@ namespace nvhttp {
     }
 
     uint32_t codec_mode_flags = SCM_H264;
-    if (video::last_encoder_probe_supported_yuv444_for_codec[0]) {
+    if (supported_yuv444_for_codec[0]) {
       codec_mode_flags |= SCM_H264_HIGH8_444;
     }
-    if (video::active_hevc_mode >= 2) {
+    if (active_hevc_mode >= 2) {
       codec_mode_flags |= SCM_HEVC;
-      if (video::last_encoder_probe_supported_yuv444_for_codec[1]) {
+      if (supported_yuv444_for_codec[1]) {
         codec_mode_flags |= SCM_HEVC_REXT8_444;
       }
     }
-    if (video::active_hevc_mode >= 3) {
+    if (active_hevc_mode >= 3) {
       codec_mode_flags |= SCM_HEVC_MAIN10;
-      if (video::last_encoder_probe_supported_yuv444_for_codec[1]) {
+      if (supported_yuv444_for_codec[1]) {
         codec_mode_flags |= SCM_HEVC_REXT10_444;
       }
     }
-    if (video::active_av1_mode >= 2) {
+    if (active_av1_mode >= 2) {
       codec_mode_flags |= SCM_AV1_MAIN8;
-      if (video::last_encoder_probe_supported_yuv444_for_codec[2]) {
+      if (supported_yuv444_for_codec[2]) {
         codec_mode_flags |= SCM_AV1_HIGH8_444;
       }
     }
-    if (video::active_av1_mode >= 3) {
+    if (active_av1_mode >= 3) {
       codec_mode_flags |= SCM_AV1_MAIN10;
-      if (video::last_encoder_probe_supported_yuv444_for_codec[2]) {
+      if (supported_yuv444_for_codec[2]) {
         codec_mode_flags |= SCM_AV1_HIGH10_444;
       }
     }
@@ -904,10 +916,12 @@ namespace nvhttp {
 
     apps.put("<xmlattr>.status_code", 200);
 
+    auto hdr_supported = !video::probing_encoders() && video::active_hevc_mode == 3;
+
     for (auto &proc : proc::proc.get_apps()) {
       pt::ptree app;
 
-      app.put("IsHdrSupported"s, video::active_hevc_mode == 3 ? 1 : 0);
+      app.put("IsHdrSupported"s, hdr_supported ? 1 : 0);
       app.put("AppTitle"s, proc.name);
       app.put("ID"s, proc.id);
 
@@ -1262,6 +1276,9 @@ namespace nvhttp {
     const auto launch_session = make_launch_session(host_audio, args);
 
     if (rtsp_stream::session_count() == 0) {
+      // The encoders may still be probed in the background since startup
+      video::wait_for_encoder_probe();
+
       // We want to prepare display only if there are no active sessions at
       // the moment. This should to be done before probing encoders as it could
       // change display device's state.
@@ -1362,6 +1379,9 @@ namespace nvhttp {
     const auto launch_session = make_launch_session(host_audio, args);
 
     if (no_active_sessions) {
+      // The encoders may still be probed in the background since startup
+      video::wait_for_encoder_probe();
+
       // We want to prepare display only if there are no active sessions at
       // the moment. This should be done before probing encoders as it could
       // change the active displays.
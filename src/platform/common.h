@@ -22,6 +22,7 @@
 #include "src/config.h"
 #include "src/logging.h"
 #include "src/thread_safe.h"
+#include "src/trace.h"
 #include "src/utility.h"
 #include "src/video_colorspace.h"
 
@@ -368,6 +369,19 @@ namespace platf {
     virtual ~deinit_t() = default;
   };
 
+  /**
+   * @brief A rectangle in image pixel coordinates.
+   */
+  struct rect_t {
+    std::int32_t x;
+    std::int32_t y;
+    std::int32_t width;
+    std::int32_t height;
+
+    bool
+    operator==(const rect_t &) const = default;
+  };
+
   struct img_t: std::enable_shared_from_this<img_t> {
   public:
     img_t() = default;
@@ -387,6 +401,13 @@ namespace platf {
 
     std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
 
+    // Regions that changed since the previous frame pushed by the capture backend.
+    // Empty if the backend doesn't track damage, in which case the whole image must be treated as changed.
+    std::vector<rect_t> damage;
+
+    // The capture of this image, recorded with the index of the frame it's encoded into
+    trace::deferred_t capture_trace;
+
     virtual ~img_t() = default;
   };
 
@@ -663,6 +684,20 @@ namespace platf {
   bool
   needs_encoder_reenumeration();
 
+  /**
+   * @brief Describe the GPUs, their drivers and the connected displays.
+   * @details Cached encoder probe results are only reused while this stays the same.
+   * @return The description, or an empty string if it isn't known.
+   */
+  std::string
+  gpu_identity();
+
+  /**
+   * @brief Check if several encoders can be probed at the same time, each with a display of its own.
+   */
+  bool
+  supports_concurrent_encoder_probing();
+
   boost::process::v1::child
   run_command(bool elevated, bool interactive, const std::string &cmd, boost::filesystem::path &working_dir, const boost::process::v1::environment &env, FILE *file, std::error_code &ec, boost::process::v1::group *group);
 
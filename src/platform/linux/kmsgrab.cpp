@@ -16,6 +16,7 @@
 #include <thread>
 
 #include "src/config.h"
+#include "src/cursor_blend.h"
 #include "src/logging.h"
 #include "src/platform/common.h"
 #include "src/round_robin.h"
@@ -1252,54 +1253,15 @@ namespace platf {
         return std::make_unique<avcodec_encode_device_t>();
       }
 
-      void
+      rect_t
       blend_cursor(img_t &img) {
         // TODO: Cursor scaling is not supported in this codepath.
         // We always draw the cursor at the source size.
-        auto pixels = (int *) img.data;
-
-        int32_t screen_height = img.height;
-        int32_t screen_width = img.width;
-
-        // This is the position in the target that we will start drawing the cursor
-        auto cursor_x = std::max<int32_t>(0, captured_cursor.x - img_offset_x);
-        auto cursor_y = std::max<int32_t>(0, captured_cursor.y - img_offset_y);
-
-        // If the cursor is partially off screen, the coordinates may be negative
-        // which means we will draw the top-right visible portion of the cursor only.
-        auto cursor_delta_x = cursor_x - std::max<int32_t>(-captured_cursor.src_w, captured_cursor.x - img_offset_x);
-        auto cursor_delta_y = cursor_y - std::max<int32_t>(-captured_cursor.src_h, captured_cursor.y - img_offset_y);
-
-        auto delta_height = std::min<uint32_t>(captured_cursor.src_h, std::max<int32_t>(0, screen_height - cursor_y)) - cursor_delta_y;
-        auto delta_width = std::min<uint32_t>(captured_cursor.src_w, std::max<int32_t>(0, screen_width - cursor_x)) - cursor_delta_x;
-        for (auto y = 0; y < delta_height; ++y) {
-          // Offset into the cursor image to skip drawing the parts of the cursor image that are off screen
-          //
-          // NB: We must access the elements via the data() function because cursor_end may point to the
-          // the first element beyond the valid range of the vector. Using vector's [] operator in that
-          // manner is undefined behavior (and triggers errors when using debug libc++), while doing the
-          // same with an array is fine.
-          auto cursor_begin = (uint32_t *) &captured_cursor.pixels.data()[((y + cursor_delta_y) * captured_cursor.src_w + cursor_delta_x) * 4];
-          auto cursor_end = (uint32_t *) &captured_cursor.pixels.data()[((y + cursor_delta_y) * captured_cursor.src_w + delta_width + cursor_delta_x) * 4];
-
-          auto pixels_begin = &pixels[(y + cursor_y) * (img.row_pitch / img.pixel_pitch) + cursor_x];
-
-          std::for_each(cursor_begin, cursor_end, [&](uint32_t cursor_pixel) {
-            auto colors_in = (uint8_t *) pixels_begin;
-
-            auto alpha = (*(uint *) &cursor_pixel) >> 24u;
-            if (alpha == 255) {
-              *pixels_begin = cursor_pixel;
-            }
-            else {
-              auto colors_out = (uint8_t *) &cursor_pixel;
-              colors_in[0] = colors_out[0] + (colors_in[0] * (255 - alpha) + 255 / 2) / 255;
-              colors_in[1] = colors_out[1] + (colors_in[1] * (255 - alpha) + 255 / 2) / 255;
-              colors_in[2] = colors_out[2] + (colors_in[2] * (255 - alpha) + 255 / 2) / 255;
-            }
-            ++pixels_begin;
-          });
-        }
+        return cursor_blend::blend(
+          img,
+          (const std::uint32_t *) captured_cursor.pixels.data(),
+          captured_cursor.src_w, captured_cursor.src_h,
+          captured_cursor.x - img_offset_x, captured_cursor.y - img_offset_y);
       }
 
       capture_e
@@ -1337,11 +1299,24 @@ namespace platf {
         gl::ctx.GetTextureSubImage(rgb->tex[0], 0, img_offset_x, img_offset_y, 0, width, height, 1, GL_BGRA, GL_UNSIGNED_BYTE, img_out->height * img_out->row_pitch, img_out->data);
 
         img_out->frame_timestamp = frame_timestamp;
+        img_out->damage.clear();
 
+        std::optional<rect_t> cursor_area;
         if (cursor && captured_cursor.visible) {
-          blend_cursor(*img_out);
+          if (auto rect = blend_cursor(*img_out); rect.width > 0 && rect.height > 0) {
+            cursor_area = rect;
+          }
+        }
+
+        // Changes to the primary plane aren't tracked, so the cursor rectangles alone would leave out
+        // whatever else changed. A moved cursor still proves the frame changed, so all of it is damaged.
+        if (cursor_area != last_cursor_area || (cursor_area && captured_cursor.serial != last_cursor_serial)) {
+          img_out->damage.emplace_back(rect_t { 0, 0, img_out->width, img_out->height });
         }
 
+        last_cursor_area = cursor_area;
+        last_cursor_serial = captured_cursor.serial;
+
         return capture_e::ok;
       }
 
@@ -1365,6 +1340,10 @@ namespace platf {
       gbm::gbm_t gbm;
       egl::display_t display;
       egl::ctx_t ctx;
+
+      // Cursor blended into the previous frame
+      std::optional<rect_t> last_cursor_area;
+      unsigned long last_cursor_serial {};
     };
 
     class display_vram_t: public display_t {
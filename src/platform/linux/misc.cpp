@@ -9,6 +9,7 @@
 #endif
 
 // standard includes
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -22,6 +23,7 @@
 #include <ifaddrs.h>
 #include <netinet/udp.h>
 #include <pwd.h>
+#include <sys/utsname.h>
 #include <unistd.h>
 
 // local includes
@@ -823,6 +825,7 @@ namespace platf {
 #ifdef SUNSHINE_BUILD_X11
       X11,  ///< X11
 #endif
+      REPLAY,  ///< Recorded frames
       MAX_FLAGS  ///< The maximum number of flags
     };
   }  // namespace source
@@ -877,8 +880,21 @@ namespace platf {
   }
 #endif
 
+  std::vector<std::string>
+  replay_display_names();
+  std::shared_ptr<display_t>
+  replay_display(mem_type_e hwdevice_type, const std::string &display_name, const video::config_t &config);
+  std::shared_ptr<display_t>
+  record_display(std::shared_ptr<display_t> display);
+
+  bool
+  verify_replay() {
+    return !config::video.replay_file.empty();
+  }
+
   std::vector<std::string>
   display_names(mem_type_e hwdevice_type) {
+    if (sources[source::REPLAY]) return replay_display_names();
 #ifdef SUNSHINE_BUILD_CUDA
     // display using NvFBC only supports mem_type_e::cuda
     if (sources[source::NVFBC] && hwdevice_type == mem_type_e::cuda) return nvfbc_display_names();
@@ -905,8 +921,70 @@ namespace platf {
     return true;
   }
 
+  std::string
+  gpu_identity() {
+    namespace fs = std::filesystem;
+
+    auto read_line = [](const fs::path &path) {
+      std::string line;
+      std::getline(std::ifstream { path }, line);
+      return line;
+    };
+
+    std::vector<std::string> entries;
+
+    std::error_code ec;
+    for (auto &entry : fs::directory_iterator { "/sys/class/drm", ec }) {
+      auto name = entry.path().filename().string();
+      if (!name.starts_with("card")) {
+        continue;
+      }
+
+      // Connectors are named like card0-HDMI-A-1, only connected ones are part of the identity
+      if (name.find('-') != std::string::npos) {
+        if (read_line(entry.path() / "status") == "connected") {
+          entries.emplace_back(std::move(name));
+        }
+        continue;
+      }
+
+      auto device = entry.path() / "device";
+      auto driver = fs::read_symlink(device / "driver", ec).filename().string();
+
+      entries.emplace_back(name + ' ' + read_line(device / "vendor") + ':' + read_line(device / "device") +
+                           ' ' + driver + ' ' + read_line(fs::path { "/sys/module" } / driver / "version"));
+    }
+
+    // Directory order isn't stable
+    std::sort(std::begin(entries), std::end(entries));
+
+    // In-tree drivers don't have a version of their own
+    utsname kernel;
+    if (!uname(&kernel)) {
+      entries.emplace_back(kernel.release);
+    }
+
+    std::string identity;
+    for (auto &entry : entries) {
+      identity += entry;
+      identity += ';';
+    }
+
+    return identity;
+  }
+
+  bool
+  supports_concurrent_encoder_probing() {
+    // Every capture backend opens its own connection or device
+    return true;
+  }
+
   std::shared_ptr<display_t>
   display(mem_type_e hwdevice_type, const std::string &display_name, const video::config_t &config) {
+    if (sources[source::REPLAY]) {
+      BOOST_LOG(info) << "Screencasting with recorded frames"sv;
+      return replay_display(hwdevice_type, display_name, config);
+    }
 #ifdef SUNSHINE_BUILD_CUDA
     if (sources[source::NVFBC] && hwdevice_type == mem_type_e::cuda) {
       BOOST_LOG(info) << "Screencasting with NvFBC"sv;
@@ -922,13 +1000,13 @@ namespace platf {
 #ifdef SUNSHINE_BUILD_DRM
     if (sources[source::KMS]) {
       BOOST_LOG(info) << "Screencasting with KMS"sv;
-      return kms_display(hwdevice_type, display_name, config);
+      return record_display(kms_display(hwdevice_type, display_name, config));
     }
 #endif
 #ifdef SUNSHINE_BUILD_X11
     if (sources[source::X11]) {
       BOOST_LOG(info) << "Screencasting with X11"sv;
-      return x11_display(hwdevice_type, display_name, config);
+      return record_display(x11_display(hwdevice_type, display_name, config));
     }
 #endif
 
@@ -960,6 +1038,15 @@ namespace platf {
     }
 #endif
 
+    if (config::video.capture == "replay") {
+      if (verify_replay()) {
+        sources[source::REPLAY] = true;
+      }
+      else {
+        BOOST_LOG(error) << "replay_file must be set to capture with replay"sv;
+      }
+    }
+
 #ifdef SUNSHINE_BUILD_CUDA
     if ((config::video.capture.empty() && sources.none()) || config::video.capture == "nvfbc") {
       if (verify_nvfbc()) {
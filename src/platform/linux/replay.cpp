@@ -0,0 +1,550 @@
+/**
+ * @file src/platform/linux/replay.cpp
+ * @brief Definitions for recording captured frames and replaying them as a display.
+ */
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "src/config.h"
+#include "src/logging.h"
+#include "src/platform/common.h"
+#include "src/video.h"
+
+#include "cuda.h"
+#include "misc.h"
+#include "vaapi.h"
+
+using namespace std::literals;
+
+namespace platf {
+  namespace replay {
+    /**
+     * Recordings are a header followed by fixed size frame records, so the file can be appended to
+     * without rewriting the header and any frame can be found without an index.
+     * Every record starts on a page boundary and holds the capture timestamp and the packed BGR0 pixels.
+     */
+    constexpr char magic[8] { 'S', 'U', 'N', 'R', 'P', 'L', 'Y', '1' };
+    constexpr std::size_t page_size = 4096;
+
+    // Offset of the pixels within a frame record, aligned for SIMD loads
+    constexpr std::size_t pixels_offset = 64;
+
+    struct file_header_t {
+      char magic[8];
+      std::uint32_t width;
+      std::uint32_t height;
+      std::uint32_t row_pitch;
+      std::uint32_t record_size;
+    };
+
+    struct record_header_t {
+      // Nanoseconds since the first recorded frame
+      std::int64_t timestamp;
+    };
+
+    std::size_t
+    record_size(int width, int height) {
+      auto size = pixels_offset + (std::size_t) width * 4 * height;
+      return (size + page_size - 1) / page_size * page_size;
+    }
+
+    /**
+     * @brief Writes frames to a recording on a thread of its own, so the capture loop never waits for the disk.
+     * @details Frames are copied into one of a few preallocated records.
+     * If the disk falls behind and none is free, the frame is dropped from the recording.
+     * A single recorder lives as long as the process, so every stream captured adds to the same recording.
+     */
+    class recorder_t {
+    public:
+      static constexpr std::size_t max_pending = 8;
+      static constexpr std::chrono::nanoseconds stream_gap = 100ms;
+
+      ~recorder_t() {
+        {
+          std::lock_guard lg { mutex };
+          stop = true;
+        }
+        cv.notify_all();
+
+        if (writer.joinable()) {
+          writer.join();
+        }
+
+        if (file) {
+          std::fclose(file);
+        }
+      }
+
+      /**
+       * @brief Start a new stream, the time since the previous frame isn't part of the recording.
+       * @details Called from the thread creating the display, the next frame recorded picks it up.
+       */
+      void
+      start_stream() {
+        new_stream = true;
+      }
+
+      void
+      log_progress() {
+        if (file) {
+          BOOST_LOG(info) << "Recorded "sv << recorded << " frames to "sv << config::video.record_file << ", dropped "sv << dropped;
+        }
+      }
+
+      void
+      record(const img_t &img) {
+        if (failed) {
+          return;
+        }
+
+        if (!img.data || img.pixel_pitch != 4) {
+          BOOST_LOG(warning) << "Only frames captured to RAM can be recorded, stopping the recording"sv;
+          failed = true;
+          return;
+        }
+
+        if (!file && open(img.width, img.height)) {
+          failed = true;
+          return;
+        }
+
+        if (img.width != width || img.height != height) {
+          BOOST_LOG(warning) << "The captured resolution changed, stopping the recording"sv;
+          failed = true;
+          return;
+        }
+
+        // Idle time within a stream is replayed as it was, pauses between streams are squeezed to stream_gap
+        auto timestamp = img.frame_timestamp.value_or(std::chrono::steady_clock::now());
+        if (new_stream.exchange(false)) {
+          last_timestamp.reset();
+        }
+        if (last_timestamp) {
+          elapsed += timestamp - *last_timestamp;
+        }
+        else if (started) {
+          elapsed += stream_gap;
+        }
+        last_timestamp = timestamp;
+        started = true;
+
+        std::vector<std::uint8_t> buffer;
+        {
+          std::lock_guard lg { mutex };
+          if (free_records.empty()) {
+            ++dropped;
+            return;
+          }
+
+          buffer = std::move(free_records.back());
+          free_records.pop_back();
+        }
+
+        record_header_t header { elapsed.count() };
+        std::memcpy(buffer.data(), &header, sizeof(header));
+
+        auto row_size = (std::size_t) width * 4;
+        for (int y = 0; y < height; ++y) {
+          std::memcpy(buffer.data() + pixels_offset + y * row_size, img.data + (std::size_t) y * img.row_pitch, row_size);
+        }
+
+        {
+          std::lock_guard lg { mutex };
+          pending.emplace_back(std::move(buffer));
+        }
+        cv.notify_all();
+      }
+
+    private:
+      int
+      open(int width, int height) {
+        file = std::fopen(config::video.record_file.c_str(), "wb");
+        if (!file) {
+          BOOST_LOG(error) << "Couldn't open "sv << config::video.record_file << " for recording: "sv << std::strerror(errno);
+          return -1;
+        }
+
+        this->width = width;
+        this->height = height;
+
+        file_header_t header {};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.width = width;
+        header.height = height;
+        header.row_pitch = width * 4;
+        header.record_size = record_size(width, height);
+
+        std::vector<std::uint8_t> page(page_size);
+        std::memcpy(page.data(), &header, sizeof(header));
+        std::fwrite(page.data(), 1, page.size(), file);
+
+        for (std::size_t x = 0; x < max_pending; ++x) {
+          free_records.emplace_back(header.record_size);
+        }
+
+        writer = std::thread { &recorder_t::write_loop, this };
+
+        BOOST_LOG(info) << "Recording "sv << width << 'x' << height << " frames to "sv << config::video.record_file;
+        return 0;
+      }
+
+      void
+      write_loop() {
+        std::unique_lock ul { mutex };
+        while (true) {
+          cv.wait(ul, [this]() { return stop || !pending.empty(); });
+          if (pending.empty()) {
+            break;
+          }
+
+          auto buffer = std::move(pending.front());
+          pending.pop_front();
+
+          ul.unlock();
+          auto written = std::fwrite(buffer.data(), 1, buffer.size(), file);
+          ul.lock();
+
+          if (written != buffer.size()) {
+            BOOST_LOG(error) << "Couldn't write to "sv << config::video.record_file << ": "sv << std::strerror(errno);
+            failed = true;
+            pending.clear();
+            break;
+          }
+
+          ++recorded;
+          free_records.emplace_back(std::move(buffer));
+        }
+      }
+
+      std::FILE *file {};
+      int width {};
+      int height {};
+      std::optional<std::chrono::steady_clock::time_point> last_timestamp;
+      std::chrono::nanoseconds elapsed {};
+      bool started = false;
+      std::atomic_bool new_stream = false;
+
+      std::thread writer;
+      std::mutex mutex;
+      std::condition_variable cv;
+      std::vector<std::vector<std::uint8_t>> free_records;
+      std::deque<std::vector<std::uint8_t>> pending;
+      bool stop = false;
+      std::atomic_bool failed = false;
+
+      std::atomic<std::size_t> recorded {};
+      std::size_t dropped {};
+    };
+
+    /**
+     * @brief Passes through every call to another display, recording the frames it captures.
+     */
+    class record_display_t: public display_t {
+    public:
+      record_display_t(std::shared_ptr<display_t> display, std::shared_ptr<recorder_t> recorder):
+          display { std::move(display) },
+          recorder { std::move(recorder) } {
+        offset_x = this->display->offset_x;
+        offset_y = this->display->offset_y;
+        env_width = this->display->env_width;
+        env_height = this->display->env_height;
+        width = this->display->width;
+        height = this->display->height;
+
+        this->recorder->start_stream();
+      }
+
+      capture_e
+      capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
+        return display->capture([&](std::shared_ptr<img_t> &&img, bool frame_captured) {
+          if (frame_captured && img) {
+            recorder->record(*img);
+          }
+
+          return push_captured_image_cb(std::move(img), frame_captured);
+        },
+          pull_free_image_cb, cursor);
+      }
+
+      std::shared_ptr<img_t>
+      alloc_img() override {
+        return display->alloc_img();
+      }
+
+      int
+      dummy_img(img_t *img) override {
+        return display->dummy_img(img);
+      }
+
+      ~record_display_t() override {
+        recorder->log_progress();
+      }
+
+      std::unique_ptr<avcodec_encode_device_t>
+      make_avcodec_encode_device(pix_fmt_e pix_fmt) override {
+        return display->make_avcodec_encode_device(pix_fmt);
+      }
+
+      std::unique_ptr<nvenc_encode_device_t>
+      make_nvenc_encode_device(pix_fmt_e pix_fmt) override {
+        return display->make_nvenc_encode_device(pix_fmt);
+      }
+
+      bool
+      is_hdr() override {
+        return display->is_hdr();
+      }
+
+      bool
+      get_hdr_metadata(SS_HDR_METADATA &metadata) override {
+        return display->get_hdr_metadata(metadata);
+      }
+
+      bool
+      is_codec_supported(std::string_view name, const ::video::config_t &config) override {
+        return display->is_codec_supported(name, config);
+      }
+
+    private:
+      std::shared_ptr<display_t> display;
+      std::shared_ptr<recorder_t> recorder;
+    };
+
+    /**
+     * @brief A private mapping of a recording.
+     */
+    struct mapping_t {
+      ~mapping_t() {
+        if (data) {
+          munmap(data, size);
+        }
+      }
+
+      std::uint8_t *data {};
+      std::size_t size {};
+    };
+
+    struct replay_img_t: public img_t {
+      // Keeps the recording mapped while the image points into it
+      std::shared_ptr<mapping_t> mapping;
+
+      // Backs the image when it isn't a recorded frame
+      std::vector<std::uint8_t> buffer;
+    };
+
+    /**
+     * @brief Serves the frames of a recording, in a loop, at the pace they were recorded at.
+     * @details The images point straight into the mapped file, so replaying doesn't copy the frames.
+     */
+    class replay_display_t: public display_t {
+    public:
+      explicit replay_display_t(mem_type_e mem_type):
+          mem_type { mem_type } {}
+
+      int
+      init(const ::video::config_t &config) {
+        auto &path = config::video.replay_file;
+        if (path.empty()) {
+          BOOST_LOG(error) << "replay_file must be set to capture with replay"sv;
+          return -1;
+        }
+
+        file_t fd { ::open(path.c_str(), O_RDONLY | O_CLOEXEC) };
+        if (fd.el < 0) {
+          BOOST_LOG(error) << "Couldn't open "sv << path << ": "sv << std::strerror(errno);
+          return -1;
+        }
+
+        struct stat st;
+        if (fstat(fd.el, &st) || (std::size_t) st.st_size < page_size) {
+          BOOST_LOG(error) << path << " isn't a recording"sv;
+          return -1;
+        }
+
+        mapping = std::make_shared<mapping_t>();
+
+        // The mapping is private, so nothing written to an image by mistake can end up in the file
+        auto data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd.el, 0);
+        if (data == MAP_FAILED) {
+          BOOST_LOG(error) << "Couldn't map "sv << path << ": "sv << std::strerror(errno);
+          return -1;
+        }
+        mapping->data = (std::uint8_t *) data;
+        mapping->size = st.st_size;
+
+        // Fault the frames in ahead of the first pass over them
+        madvise(data, st.st_size, MADV_WILLNEED);
+
+        file_header_t header;
+        std::memcpy(&header, mapping->data, sizeof(header));
+        if (std::memcmp(header.magic, magic, sizeof(magic)) || header.record_size != replay::record_size(header.width, header.height)) {
+          BOOST_LOG(error) << path << " isn't a recording"sv;
+          return -1;
+        }
+
+        width = env_width = header.width;
+        height = env_height = header.height;
+        row_pitch = header.row_pitch;
+        record_size = header.record_size;
+        frame_count = (mapping->size - page_size) / record_size;
+
+        if (!frame_count) {
+          BOOST_LOG(error) << path << " has no frames"sv;
+          return -1;
+        }
+
+        // When looping, the first frame follows the last one after an average frame interval
+        auto duration = timestamp(frame_count - 1);
+        loop_duration = frame_count > 1 ?
+                          duration + duration / (std::int64_t) (frame_count - 1) :
+                          std::chrono::nanoseconds { 1s } / config.framerate;
+
+        BOOST_LOG(info) << "Replaying "sv << frame_count << " frames of "sv << width << 'x' << height << " from "sv << path
+                        << " at "sv << config::video.replay_speed << "x speed"sv;
+
+        return 0;
+      }
+
+      capture_e
+      capture(const push_captured_image_cb_t &push_captured_image_cb, const pull_free_image_cb_t &pull_free_image_cb, bool *cursor) override {
+        auto speed = config::video.replay_speed;
+        auto start = std::chrono::steady_clock::now();
+
+        sleep_overshoot_logger.reset();
+
+        for (std::size_t loop = 0;; ++loop) {
+          for (std::size_t frame = 0; frame < frame_count; ++frame) {
+            if (speed > 0) {
+              auto offset = std::chrono::duration_cast<std::chrono::nanoseconds>((loop_duration * (std::int64_t) loop + timestamp(frame)) / speed);
+              auto next_frame = start + offset;
+
+              if (next_frame > std::chrono::steady_clock::now()) {
+                std::this_thread::sleep_until(next_frame);
+                sleep_overshoot_logger.first_point(next_frame);
+                sleep_overshoot_logger.second_point_now_and_log();
+              }
+            }
+
+            std::shared_ptr<img_t> img_out;
+            if (!pull_free_image_cb(img_out)) {
+              return capture_e::interrupted;
+            }
+
+            auto img = (replay_img_t *) img_out.get();
+            img->mapping = mapping;
+            img->data = record(frame) + pixels_offset;
+            img->width = width;
+            img->height = height;
+            img->pixel_pitch = 4;
+            img->row_pitch = row_pitch;
+            img->frame_timestamp = std::chrono::steady_clock::now();
+            img->damage.clear();
+
+            if (!push_captured_image_cb(std::move(img_out), true)) {
+              return capture_e::ok;
+            }
+          }
+        }
+      }
+
+      std::shared_ptr<img_t>
+      alloc_img() override {
+        return std::make_shared<replay_img_t>();
+      }
+
+      int
+      dummy_img(img_t *img) override {
+        auto replay_img = (replay_img_t *) img;
+
+        replay_img->buffer.assign((std::size_t) row_pitch * height, 0);
+        replay_img->data = replay_img->buffer.data();
+        replay_img->width = width;
+        replay_img->height = height;
+        replay_img->pixel_pitch = 4;
+        replay_img->row_pitch = row_pitch;
+
+        return 0;
+      }
+
+      std::unique_ptr<avcodec_encode_device_t>
+      make_avcodec_encode_device(pix_fmt_e pix_fmt) override {
+#ifdef SUNSHINE_BUILD_VAAPI
+        if (mem_type == mem_type_e::vaapi) {
+          return va::make_avcodec_encode_device(width, height, false);
+        }
+#endif
+
+#ifdef SUNSHINE_BUILD_CUDA
+        if (mem_type == mem_type_e::cuda) {
+          return cuda::make_avcodec_encode_device(width, height, false);
+        }
+#endif
+
+        return std::make_unique<avcodec_encode_device_t>();
+      }
+
+    private:
+      std::uint8_t *
+      record(std::size_t frame) {
+        return mapping->data + page_size + frame * record_size;
+      }
+
+      std::chrono::nanoseconds
+      timestamp(std::size_t frame) {
+        record_header_t header;
+        std::memcpy(&header, record(frame), sizeof(header));
+
+        return std::chrono::nanoseconds { header.timestamp };
+      }
+
+      mem_type_e mem_type;
+
+      std::shared_ptr<mapping_t> mapping;
+      int row_pitch {};
+      std::size_t record_size {};
+      std::size_t frame_count {};
+      std::chrono::nanoseconds loop_duration {};
+    };
+  }  // namespace replay
+
+  std::shared_ptr<display_t>
+  record_display(std::shared_ptr<display_t> display) {
+    if (!display || config::video.record_file.empty()) {
+      return display;
+    }
+
+    static auto recorder = std::make_shared<replay::recorder_t>();
+
+    return std::make_shared<replay::record_display_t>(std::move(display), recorder);
+  }
+
+  std::shared_ptr<display_t>
+  replay_display(mem_type_e hwdevice_type, const std::string &display_name, const ::video::config_t &config) {
+    if (hwdevice_type != mem_type_e::system && hwdevice_type != mem_type_e::vaapi && hwdevice_type != mem_type_e::cuda) {
+      BOOST_LOG(error) << "Could not initialize replay display with the given hw device type"sv;
+      return nullptr;
+    }
+
+    auto display = std::make_shared<replay::replay_display_t>(hwdevice_type);
+    if (display->init(config)) {
+      return nullptr;
+    }
+
+    return display;
+  }
+
+  std::vector<std::string>
+  replay_display_names() {
+    return { "0" };
+  }
+}  // namespace platf
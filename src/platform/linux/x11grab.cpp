@@ -4,12 +4,14 @@
  */
 #include "src/platform/common.h"
 
+#include <deque>
 #include <fstream>
 #include <thread>
 
 #include <X11/X.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/Xdamage.h>
 #include <X11/extensions/Xfixes.h>
 #include <X11/extensions/Xrandr.h>
 #include <sys/ipc.h>
@@ -18,6 +20,7 @@
 #include <xcb/xfixes.h>
 
 #include "src/config.h"
+#include "src/cursor_blend.h"
 #include "src/globals.h"
 #include "src/logging.h"
 #include "src/task_pool.h"
@@ -61,6 +64,15 @@ namespace platf {
     _FN(CloseDisplay, int, (Display * display));
     _FN(Free, int, (void *data));
     _FN(InitThreads, Status, (void) );
+    _FN(Pending, int, (Display * display));
+    _FN(NextEvent, int, (Display * display, XEvent *event_return));
+    _FN(QueryPointer, Bool,
+      (
+        Display * display, Window w,
+        Window *root_return, Window *child_return,
+        int *root_x_return, int *root_y_return,
+        int *win_x_return, int *win_y_return,
+        unsigned int *mask_return));
 
     namespace rr {
       _FN(GetScreenResources, XRRScreenResources *, (Display * dpy, Window window));
@@ -104,6 +116,11 @@ namespace platf {
     }  // namespace rr
     namespace fix {
       _FN(GetCursorImage, XFixesCursorImage *, (Display * dpy));
+      _FN(QueryExtension, Bool, (Display * dpy, int *event_base_return, int *error_base_return));
+      _FN(SelectCursorInput, void, (Display * dpy, Window win, unsigned long eventMask));
+      _FN(CreateRegion, XserverRegion, (Display * dpy, XRectangle *rectangles, int nrectangles));
+      _FN(DestroyRegion, void, (Display * dpy, XserverRegion region));
+      _FN(FetchRegion, XRectangle *, (Display * dpy, XserverRegion region, int *nrectanglesRet));
 
       static int
       init() {
@@ -121,6 +138,11 @@ namespace platf {
 
         std::vector<std::tuple<dyn::apiproc *, const char *>> funcs {
           { (dyn::apiproc *) &GetCursorImage, "XFixesGetCursorImage" },
+          { (dyn::apiproc *) &QueryExtension, "XFixesQueryExtension" },
+          { (dyn::apiproc *) &SelectCursorInput, "XFixesSelectCursorInput" },
+          { (dyn::apiproc *) &CreateRegion, "XFixesCreateRegion" },
+          { (dyn::apiproc *) &DestroyRegion, "XFixesDestroyRegion" },
+          { (dyn::apiproc *) &FetchRegion, "XFixesFetchRegion" },
         };
 
         if (dyn::load(handle, funcs)) {
@@ -131,6 +153,41 @@ namespace platf {
         return 0;
       }
     }  // namespace fix
+    namespace damage {
+      _FN(QueryExtension, Bool, (Display * dpy, int *event_base_return, int *error_base_return));
+      _FN(Create, Damage, (Display * dpy, Drawable drawable, int level));
+      _FN(Destroy, void, (Display * dpy, Damage damage));
+      _FN(Subtract, void, (Display * dpy, Damage damage, XserverRegion repair, XserverRegion parts));
+
+      static int
+      init() {
+        static void *handle { nullptr };
+        static bool funcs_loaded = false;
+
+        if (funcs_loaded) return 0;
+
+        if (!handle) {
+          handle = dyn::handle({ "libXdamage.so.1", "libXdamage.so" });
+          if (!handle) {
+            return -1;
+          }
+        }
+
+        std::vector<std::tuple<dyn::apiproc *, const char *>> funcs {
+          { (dyn::apiproc *) &QueryExtension, "XDamageQueryExtension" },
+          { (dyn::apiproc *) &Create, "XDamageCreate" },
+          { (dyn::apiproc *) &Destroy, "XDamageDestroy" },
+          { (dyn::apiproc *) &Subtract, "XDamageSubtract" },
+        };
+
+        if (dyn::load(handle, funcs)) {
+          return -1;
+        }
+
+        funcs_loaded = true;
+        return 0;
+      }
+    }  // namespace damage
 
     static int
     init() {
@@ -153,6 +210,9 @@ namespace platf {
         { (dyn::apiproc *) &Free, "XFree" },
         { (dyn::apiproc *) &CloseDisplay, "XCloseDisplay" },
         { (dyn::apiproc *) &InitThreads, "XInitThreads" },
+        { (dyn::apiproc *) &Pending, "XPending" },
+        { (dyn::apiproc *) &NextEvent, "XNextEvent" },
+        { (dyn::apiproc *) &QueryPointer, "XQueryPointer" },
       };
 
       if (dyn::load(handle, funcs)) {
@@ -190,6 +250,10 @@ namespace platf {
         uint32_t shmid,
         uint8_t read_only));
 
+    _FN(shm_detach, xcb_void_cookie_t,
+      (xcb_connection_t * c,
+        xcb_shm_seg_t shmseg));
+
     _FN(get_extension_data, xcb_query_extension_reply_t *,
       (xcb_connection_t * c, xcb_extension_t *ext));
 
@@ -219,6 +283,7 @@ namespace platf {
         { (dyn::apiproc *) &shm_get_image_reply, "xcb_shm_get_image_reply" },
         { (dyn::apiproc *) &shm_get_image_unchecked, "xcb_shm_get_image_unchecked" },
         { (dyn::apiproc *) &shm_attach, "xcb_shm_attach" },
+        { (dyn::apiproc *) &shm_detach, "xcb_shm_detach" },
       };
 
       if (dyn::load(handle, funcs)) {
@@ -269,7 +334,6 @@ namespace platf {
   void
   freeX(XFixesCursorImage *);
 
-  using xcb_connect_t = util::dyn_safe_ptr<xcb_connection_t, &xcb::disconnect>;
   using xcb_img_t = util::c_ptr<xcb_shm_get_image_reply_t>;
 
   using ximg_t = util::safe_ptr<XImage, freeImage>;
@@ -326,11 +390,50 @@ namespace platf {
 
   struct shm_img_t: public img_t {
     ~shm_img_t() override {
-      delete[] data;
+      if (xcb) {
+        xcb::shm_detach(xcb.get(), seg);
+      }
+      else {
+        delete[] data;
+      }
       data = nullptr;
     }
+
+    // Only set when the image memory is a SHM segment attached to the X server.
+    // Holding the connection keeps the segment valid after the display is reinitialized.
+    std::shared_ptr<xcb_connection_t> xcb;
+    std::uint32_t seg {};
+    shm_id_t shm_id;
+    shm_data_t shm_data;
+
+    // Serial of the captured frame held by this image, 0 if it doesn't hold one yet
+    std::uint64_t frame_serial {};
+
+    // The cursor was blended over these pixels, so they must be fetched again before the image is reused
+    std::optional<rect_t> cursor_area;
   };
 
+  static bool
+  is_empty(const rect_t &rect) {
+    return rect.width <= 0 || rect.height <= 0;
+  }
+
+  /**
+   * @brief Convert the cursor image to a sprite that can be blended into captured images.
+   */
+  static void
+  make_sprite(const XFixesCursorImage &overlay, cursor_blend::sprite_t &sprite) {
+    // XFixes hands out premultiplied ARGB, widened to longs
+    sprite.pixels.resize(overlay.width * overlay.height);
+    std::copy_n(overlay.pixels, sprite.pixels.size(), std::begin(sprite.pixels));
+
+    sprite.width = overlay.width;
+    sprite.height = overlay.height;
+    sprite.xhot = overlay.xhot;
+    sprite.yhot = overlay.yhot;
+    sprite.serial = overlay.cursor_serial;
+  }
+
   static void
   blend_cursor(Display *display, img_t &img, int offsetX, int offsetY) {
     xcursor_t overlay { x11::fix::GetCursorImage(display) };
@@ -340,47 +443,155 @@ namespace platf {
       return;
     }
 
-    overlay->x -= overlay->xhot;
-    overlay->y -= overlay->yhot;
+    cursor_blend::sprite_t sprite;
+    make_sprite(*overlay, sprite);
 
-    overlay->x -= offsetX;
-    overlay->y -= offsetY;
+    cursor_blend::blend(img, sprite, overlay->x - overlay->xhot - offsetX, overlay->y - overlay->yhot - offsetY);
+  }
 
-    overlay->x = std::max((short) 0, overlay->x);
-    overlay->y = std::max((short) 0, overlay->y);
+  /**
+   * @brief Tracks which parts of the root window changed through the XDamage extension.
+   */
+  class damage_tracker_t {
+  public:
+    static std::unique_ptr<damage_tracker_t>
+    make(Display *xdisplay) {
+      int event_base, error_base;
+      if (!x11::damage::QueryExtension(xdisplay, &event_base, &error_base)) {
+        return nullptr;
+      }
 
-    auto pixels = (int *) img.data;
+      auto tracker = std::make_unique<damage_tracker_t>();
+      tracker->xdisplay = xdisplay;
+      tracker->event_base = event_base;
 
-    auto screen_height = img.height;
-    auto screen_width = img.width;
+      // We only need to be woken up when the damage goes from empty to non-empty,
+      // the damaged area itself is fetched once per frame by collect()
+      tracker->damage = x11::damage::Create(xdisplay, DefaultRootWindow(xdisplay), XDamageReportNonEmpty);
+      tracker->region = x11::fix::CreateRegion(xdisplay, nullptr, 0);
 
-    auto delta_height = std::min<uint16_t>(overlay->height, std::max(0, screen_height - overlay->y));
-    auto delta_width = std::min<uint16_t>(overlay->width, std::max(0, screen_width - overlay->x));
-    for (auto y = 0; y < delta_height; ++y) {
-      auto overlay_begin = &overlay->pixels[y * overlay->width];
-      auto overlay_end = &overlay->pixels[y * overlay->width + delta_width];
+      return tracker;
+    }
 
-      auto pixels_begin = &pixels[(y + overlay->y) * (img.row_pitch / img.pixel_pitch) + overlay->x];
+    ~damage_tracker_t() {
+      if (region) {
+        x11::fix::DestroyRegion(xdisplay, region);
+      }
+      if (damage) {
+        x11::damage::Destroy(xdisplay, damage);
+      }
+    }
 
-      std::for_each(overlay_begin, overlay_end, [&](long pixel) {
-        int *pixel_p = (int *) &pixel;
+    void
+    handle_event(const XEvent &event) {
+      notified |= event.type == event_base + XDamageNotify;
+    }
 
-        auto colors_in = (uint8_t *) pixels_begin;
+    /**
+     * @brief Collect the damage accumulated since the previous call.
+     * @param area The captured area in root window coordinates.
+     * @param rects Receives the damaged parts of area, relative to area.
+     */
+    void
+    collect(const rect_t &area, std::vector<rect_t> &rects) {
+      // No notification means the damage is still empty, so we can skip the round trip
+      if (!notified) {
+        return;
+      }
+      notified = false;
+
+      x11::damage::Subtract(xdisplay, damage, None, region);
+
+      int count = 0;
+      auto xrects = x11::fix::FetchRegion(xdisplay, region, &count);
+      for (int x = 0; x < count; ++x) {
+        auto left = std::max<int>(xrects[x].x, area.x);
+        auto top = std::max<int>(xrects[x].y, area.y);
+        auto right = std::min<int>(xrects[x].x + xrects[x].width, area.x + area.width);
+        auto bottom = std::min<int>(xrects[x].y + xrects[x].height, area.y + area.height);
 
-        auto alpha = (*(uint *) pixel_p) >> 24u;
-        if (alpha == 255) {
-          *pixels_begin = *pixel_p;
+        rect_t rect { left - area.x, top - area.y, right - left, bottom - top };
+        if (!is_empty(rect)) {
+          rects.emplace_back(rect);
         }
-        else {
-          auto colors_out = (uint8_t *) pixel_p;
-          colors_in[0] = colors_out[0] + (colors_in[0] * (255 - alpha) + 255 / 2) / 255;
-          colors_in[1] = colors_out[1] + (colors_in[1] * (255 - alpha) + 255 / 2) / 255;
-          colors_in[2] = colors_out[2] + (colors_in[2] * (255 - alpha) + 255 / 2) / 255;
+      }
+
+      if (xrects) {
+        x11::Free(xrects);
+      }
+    }
+
+    Display *xdisplay {};
+    int event_base {};
+    Damage damage {};
+    XserverRegion region {};
+    bool notified = false;
+  };
+
+  /**
+   * @brief Keeps the cursor sprite around until XFixes reports a different cursor image.
+   */
+  class cursor_cache_t {
+  public:
+    static std::unique_ptr<cursor_cache_t>
+    make(Display *xdisplay) {
+      int event_base, error_base;
+      if (!x11::fix::QueryExtension(xdisplay, &event_base, &error_base)) {
+        return nullptr;
+      }
+
+      auto cache = std::make_unique<cursor_cache_t>();
+      cache->xdisplay = xdisplay;
+      cache->event_base = event_base;
+
+      x11::fix::SelectCursorInput(xdisplay, DefaultRootWindow(xdisplay), XFixesDisplayCursorNotifyMask);
+
+      return cache;
+    }
+
+    void
+    handle_event(const XEvent &event) {
+      dirty |= event.type == event_base + XFixesCursorNotify;
+    }
+
+    /**
+     * @brief Update the cursor position, and the sprite if the cursor image changed.
+     * @return false if the cursor couldn't be queried.
+     */
+    bool
+    update() {
+      if (dirty) {
+        xcursor_t overlay { x11::fix::GetCursorImage(xdisplay) };
+        if (!overlay) {
+          BOOST_LOG(error) << "Couldn't get cursor from XFixesGetCursorImage"sv;
+          return false;
         }
-        ++pixels_begin;
-      });
+
+        make_sprite(*overlay, sprite);
+        x = overlay->x;
+        y = overlay->y;
+        dirty = false;
+
+        return true;
+      }
+
+      // Only the position may have changed, which is much cheaper to query than the cursor image
+      Window root, child;
+      int win_x, win_y;
+      unsigned int mask;
+      return x11::QueryPointer(xdisplay, DefaultRootWindow(xdisplay), &root, &child, &x, &y, &win_x, &win_y, &mask);
     }
-  }
+
+    Display *xdisplay {};
+    int event_base {};
+    bool dirty = true;
+
+    cursor_blend::sprite_t sprite;
+
+    // Pointer position in root window coordinates
+    int x {};
+    int y {};
+  };
 
   struct x11_attr_t: public display_t {
     std::chrono::nanoseconds delay;
@@ -594,15 +805,32 @@ namespace platf {
   };
 
   struct shm_attr_t: public x11_attr_t {
+    static constexpr std::size_t damage_history_size = 16;
+
     x11::xdisplay_t shm_xdisplay;  // Prevent race condition with x11_attr_t::xdisplay
-    xcb_connect_t xcb;
+    std::shared_ptr<xcb_connection_t> xcb;
     xcb_screen_t *display;
-    std::uint32_t seg;
 
+    // Staging segment for partial updates and for images without a segment of their own
+    std::uint32_t seg;
     shm_id_t shm_id;
-
     shm_data_t data;
 
+    // Destroyed before shm_xdisplay
+    std::unique_ptr<damage_tracker_t> damage;
+    std::unique_ptr<cursor_cache_t> cursor_cache;
+
+    // Damage of the most recent frames, the last element belongs to frame_serial
+    std::deque<std::vector<rect_t>> damage_history;
+    std::uint64_t frame_serial {};
+
+    // Cursor blended into the previous frame
+    std::optional<rect_t> last_cursor_area;
+    unsigned long last_cursor_serial {};
+
+    std::vector<rect_t> refresh_rects;
+    std::vector<xcb_shm_get_image_cookie_t> img_cookies;
+
     task_pool_util::TaskPool::task_id_t refresh_task_id;
 
     void
@@ -668,6 +896,24 @@ namespace platf {
       return capture_e::ok;
     }
 
+    /**
+     * @brief Dispatch the XDamage and XFixes events received since the previous frame.
+     */
+    void
+    process_events() {
+      while (x11::Pending(shm_xdisplay.get())) {
+        XEvent event;
+        x11::NextEvent(shm_xdisplay.get(), &event);
+
+        if (damage) {
+          damage->handle_event(event);
+        }
+        if (cursor_cache) {
+          cursor_cache->handle_event(event);
+        }
+      }
+    }
+
     capture_e
     snapshot(const pull_free_image_cb_t &pull_free_image_cb, std::shared_ptr<platf::img_t> &img_out, std::chrono::milliseconds timeout, bool cursor) {
       // The whole X server changed, so we must reinit everything
@@ -675,9 +921,89 @@ namespace platf {
         BOOST_LOG(warning) << "X dimensions changed in SHM mode, request reinit"sv;
         return capture_e::reinit;
       }
+
+      process_events();
+
+      std::vector<rect_t> frame_damage;
+      if (!damage || frame_serial == 0) {
+        frame_damage.emplace_back(rect_t { 0, 0, width, height });
+      }
       else {
-        auto img_cookie = xcb::shm_get_image_unchecked(xcb.get(), display->root, offset_x, offset_y, width, height, ~0, XCB_IMAGE_FORMAT_Z_PIXMAP, seg, 0);
-        auto frame_timestamp = std::chrono::steady_clock::now();
+        damage->collect({ offset_x, offset_y, width, height }, frame_damage);
+      }
+
+      // Top left corner of the cursor in image coordinates
+      int cursor_x = 0;
+      int cursor_y = 0;
+      unsigned long cursor_serial = 0;
+      std::optional<rect_t> cursor_area;
+      if (cursor && cursor_cache && cursor_cache->update()) {
+        auto &sprite = cursor_cache->sprite;
+
+        cursor_x = cursor_cache->x - sprite.xhot - offset_x;
+        cursor_y = cursor_cache->y - sprite.yhot - offset_y;
+        cursor_serial = sprite.serial;
+
+        if (auto rect = cursor_blend::clip({ cursor_x, cursor_y, sprite.width, sprite.height }, width, height); !is_empty(rect)) {
+          cursor_area = rect;
+        }
+      }
+
+      // The cursor isn't part of the damage reported by the X server
+      if (cursor_area != last_cursor_area || (cursor_area && cursor_serial != last_cursor_serial)) {
+        if (last_cursor_area) {
+          frame_damage.emplace_back(*last_cursor_area);
+        }
+        if (cursor_area) {
+          frame_damage.emplace_back(*cursor_area);
+        }
+      }
+
+      // Nothing changed, the encoder will reuse the previous frame
+      if (frame_damage.empty()) {
+        return capture_e::timeout;
+      }
+
+      if (!pull_free_image_cb(img_out)) {
+        return platf::capture_e::interrupted;
+      }
+      auto img = (shm_img_t *) img_out.get();
+
+      ++frame_serial;
+      damage_history.emplace_back(frame_damage);
+      if (damage_history.size() > damage_history_size) {
+        damage_history.pop_front();
+      }
+
+      // Collect everything that changed since the image was last filled
+      refresh_rects.clear();
+      bool full_frame = img->frame_serial == 0 || frame_serial - img->frame_serial > damage_history.size();
+      if (!full_frame) {
+        for (auto it = damage_history.end() - (frame_serial - img->frame_serial); it != damage_history.end(); ++it) {
+          refresh_rects.insert(std::end(refresh_rects), std::begin(*it), std::end(*it));
+        }
+        if (img->cursor_area) {
+          refresh_rects.emplace_back(*img->cursor_area);
+        }
+
+        std::int64_t area = 0;
+        for (auto &rect : refresh_rects) {
+          area += (std::int64_t) rect.width * rect.height;
+        }
+
+        // The rectangles must fit into the SHM segment, and fetching most of the frame
+        // piecewise is slower than fetching all of it at once
+        full_frame = area * 2 >= (std::int64_t) width * height;
+      }
+
+      img->frame_serial = 0;
+      img->cursor_area.reset();
+
+      auto frame_timestamp = std::chrono::steady_clock::now();
+      if (full_frame) {
+        // Images with their own segment receive the frame directly from the X server
+        auto img_cookie = xcb::shm_get_image_unchecked(xcb.get(), display->root, offset_x, offset_y, width, height, ~0, XCB_IMAGE_FORMAT_Z_PIXMAP, img->xcb ? img->seg : seg, 0);
+        frame_timestamp = std::chrono::steady_clock::now();
 
         xcb_img_t img_reply { xcb::shm_get_image_reply(xcb.get(), img_cookie, nullptr) };
         if (!img_reply) {
@@ -685,19 +1011,49 @@ namespace platf {
           return capture_e::reinit;
         }
 
-        if (!pull_free_image_cb(img_out)) {
-          return platf::capture_e::interrupted;
+        if (!img->xcb) {
+          std::copy_n((std::uint8_t *) data.data, frame_size(), img->data);
         }
+      }
+      else {
+        // Pack all rectangles into the SHM segment, then wait for the replies
+        img_cookies.clear();
+        std::uint32_t offset = 0;
+        for (auto &rect : refresh_rects) {
+          img_cookies.emplace_back(xcb::shm_get_image_unchecked(xcb.get(), display->root, offset_x + rect.x, offset_y + rect.y, rect.width, rect.height, ~0, XCB_IMAGE_FORMAT_Z_PIXMAP, seg, offset));
+          offset += rect.width * rect.height * 4;
+        }
+        frame_timestamp = std::chrono::steady_clock::now();
+
+        offset = 0;
+        for (std::size_t x = 0; x < refresh_rects.size(); ++x) {
+          xcb_img_t img_reply { xcb::shm_get_image_reply(xcb.get(), img_cookies[x], nullptr) };
+          if (!img_reply) {
+            BOOST_LOG(error) << "Could not get image reply"sv;
+            return capture_e::reinit;
+          }
 
-        std::copy_n((std::uint8_t *) data.data, frame_size(), img_out->data);
-        img_out->frame_timestamp = frame_timestamp;
-
-        if (cursor) {
-          blend_cursor(shm_xdisplay.get(), *img_out, offset_x, offset_y);
+          auto &rect = refresh_rects[x];
+          auto src = (std::uint8_t *) data.data + offset;
+          for (int y = 0; y < rect.height; ++y) {
+            std::copy_n(src + y * rect.width * 4, rect.width * 4, img->data + (rect.y + y) * img->row_pitch + rect.x * 4);
+          }
+          offset += rect.width * rect.height * 4;
         }
+      }
 
-        return capture_e::ok;
+      img->frame_serial = frame_serial;
+      img->frame_timestamp = frame_timestamp;
+      img->damage = std::move(frame_damage);
+
+      if (cursor_area) {
+        img->cursor_area = cursor_blend::blend(*img, cursor_cache->sprite, cursor_x, cursor_y);
       }
+
+      last_cursor_area = cursor_area;
+      last_cursor_serial = cursor_serial;
+
+      return capture_e::ok;
     }
 
     std::shared_ptr<img_t>
@@ -707,7 +1063,25 @@ namespace platf {
       img->height = height;
       img->pixel_pitch = 4;
       img->row_pitch = img->pixel_pitch * width;
-      img->data = new std::uint8_t[height * img->row_pitch];
+
+      // Back the image with a SHM segment, so xcb_shm_get_image() can write into it without a copy
+      img->shm_id.id = shmget(IPC_PRIVATE, frame_size(), IPC_CREAT | 0777);
+      if (img->shm_id.id != -1) {
+        img->shm_data.data = shmat(img->shm_id.id, nullptr, 0);
+      }
+
+      if (img->shm_id.id == -1 || (std::uintptr_t) img->shm_data.data == -1) {
+        BOOST_LOG(warning) << "Couldn't create a SHM segment for the image, frames will be copied"sv;
+
+        img->data = new std::uint8_t[height * img->row_pitch];
+        return img;
+      }
+
+      img->seg = xcb::generate_id(xcb.get());
+      xcb::shm_attach(xcb.get(), img->seg, img->shm_id.id, false);
+
+      img->xcb = xcb;
+      img->data = (std::uint8_t *) img->shm_data.data;
 
       return img;
     }
@@ -724,7 +1098,7 @@ namespace platf {
       }
 
       shm_xdisplay.reset(x11::OpenDisplay(nullptr));
-      xcb.reset(xcb::connect(nullptr, nullptr));
+      xcb.reset(xcb::connect(nullptr, nullptr), xcb::disconnect);
       if (xcb::connection_has_error(xcb.get())) {
         return -1;
       }
@@ -754,6 +1128,18 @@ namespace platf {
         return -1;
       }
 
+      if (!x11::damage::init()) {
+        damage = damage_tracker_t::make(shm_xdisplay.get());
+      }
+      if (!damage) {
+        BOOST_LOG(info) << "XDamage is unavailable, every frame will be captured in full"sv;
+      }
+
+      cursor_cache = cursor_cache_t::make(shm_xdisplay.get());
+      if (!cursor_cache) {
+        BOOST_LOG(warning) << "XFixes is unavailable, the cursor won't be captured"sv;
+      }
+
       return 0;
     }
 
@@ -2,6 +2,8 @@
  * @file src/platform/macos/display.mm
  * @brief Definitions for display capture on macOS.
  */
+#include <sys/sysctl.h>
+
 #include "src/platform/common.h"
 #include "src/platform/macos/av_img_t.h"
 #include "src/platform/macos/av_video.h"
@@ -207,6 +209,43 @@ namespace platf {
     return display_names;
   }
 
+  std::string
+  gpu_identity() {
+    auto sysctl_string = [](const char *name) {
+      std::size_t size = 0;
+      if (sysctlbyname(name, nullptr, &size, nullptr, 0) || !size) {
+        return std::string {};
+      }
+
+      std::string value(size, '\0');
+      if (sysctlbyname(name, value.data(), &size, nullptr, 0)) {
+        return std::string {};
+      }
+      value.resize(size - 1);
+
+      return value;
+    };
+
+    // The GPU drivers ship with the operating system
+    std::string identity = sysctl_string("hw.model") + ';' + sysctl_string("kern.osversion") + ';';
+
+    uint32_t display_count = 0;
+    CGGetActiveDisplayList(0, nullptr, &display_count);
+    std::vector<CGDirectDisplayID> displays(display_count);
+    CGGetActiveDisplayList(display_count, displays.data(), &display_count);
+
+    for (auto display : displays) {
+      identity += std::to_string(display) + ' ' + std::to_string(CGDisplayPixelsWide(display)) + 'x' + std::to_string(CGDisplayPixelsHigh(display)) + ';';
+    }
+
+    return identity;
+  }
+
+  bool
+  supports_concurrent_encoder_probing() {
+    return false;
+  }
+
   /**
    * @brief Returns if GPUs/drivers have changed since the last call to this function.
    * @return `true` if a change has occurred or if it is unknown whether a change occurred.
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cmath>
 #include <initguid.h>
+#include <sstream>
 #include <thread>
 
 #include <boost/algorithm/string/join.hpp>
@@ -1134,6 +1135,53 @@ namespace platf {
     return adapter_names;
   }
 
+  std::string
+  gpu_identity() {
+    dxgi::factory1_t factory;
+    auto status = CreateDXGIFactory1(IID_IDXGIFactory1, (void **) &factory);
+    if (FAILED(status)) {
+      BOOST_LOG(error) << "Failed to create DXGIFactory1 [0x"sv << util::hex(status).to_string_view() << ']';
+      return {};
+    }
+
+    std::stringstream identity;
+
+    dxgi::adapter_t adapter;
+    for (int x = 0; factory->EnumAdapters1(x, &adapter) != DXGI_ERROR_NOT_FOUND; ++x) {
+      DXGI_ADAPTER_DESC1 adapter_desc;
+      adapter->GetDesc1(&adapter_desc);
+
+      // The user mode driver version
+      LARGE_INTEGER driver_version {};
+      adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driver_version);
+
+      identity << to_utf8(adapter_desc.Description)
+               << ' ' << util::hex(adapter_desc.VendorId).to_string_view()
+               << ':' << util::hex(adapter_desc.DeviceId).to_string_view()
+               << " driver "sv << util::hex(driver_version.QuadPart).to_string_view();
+
+      dxgi::output_t output;
+      for (int y = 0; adapter->EnumOutputs(y, &output) != DXGI_ERROR_NOT_FOUND; ++y) {
+        DXGI_OUTPUT_DESC output_desc;
+        output->GetDesc(&output_desc);
+
+        if (output_desc.AttachedToDesktop) {
+          identity << ' ' << to_utf8(output_desc.DeviceName);
+        }
+      }
+
+      identity << ';';
+    }
+
+    return identity.str();
+  }
+
+  bool
+  supports_concurrent_encoder_probing() {
+    // Several duplications of the same output from one process can't be relied on
+    return false;
+  }
+
   /**
    * @brief Returns if GPUs/drivers have changed since the last call to this function.
    * @return `true` if a change has occurred or if it is unknown whether a change occurred.
@@ -4,6 +4,10 @@
  */
 #include "stat_trackers.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
 namespace stat_trackers {
 
   boost::format
@@ -16,4 +20,165 @@ namespace stat_trackers {
     return boost::format("%1$.2f");
   }
 
+  hdr_histogram::hdr_histogram():
+      state { std::make_unique<state_t>() } {}
+
+  std::size_t
+  hdr_histogram::bucket_index(std::uint64_t value) {
+    value = std::min(value, max_value);
+    if (value < sub_bucket_count) {
+      return value;
+    }
+
+    // The top bits of the value pick the linear bucket within its power of two
+    int magnitude = std::bit_width(value) - 1;
+    int shift = magnitude - (sub_bucket_bits - 1);
+
+    return sub_bucket_count + (magnitude - sub_bucket_bits) * sub_bucket_half + ((value >> shift) - sub_bucket_half);
+  }
+
+  std::uint64_t
+  hdr_histogram::lowest_equivalent_value(std::size_t index) {
+    if (index < sub_bucket_count) {
+      return index;
+    }
+
+    auto magnitude = (index - sub_bucket_count) / sub_bucket_half + sub_bucket_bits;
+    auto shift = magnitude - (sub_bucket_bits - 1);
+
+    return (sub_bucket_half + (index - sub_bucket_count) % sub_bucket_half) << shift;
+  }
+
+  std::uint64_t
+  hdr_histogram::highest_equivalent_value(std::size_t index) {
+    if (index + 1 >= bucket_count) {
+      return max_value;
+    }
+
+    return lowest_equivalent_value(index + 1) - 1;
+  }
+
+  void
+  hdr_histogram::record(std::uint64_t value) {
+    value = std::min(value, max_value);
+
+    auto index = bucket_index(value);
+    state->buckets[index].fetch_add(1, std::memory_order_relaxed);
+    state->sums[index].fetch_add(value, std::memory_order_relaxed);
+    state->count.fetch_add(1, std::memory_order_relaxed);
+    state->sum.fetch_add(value, std::memory_order_relaxed);
+
+    auto min = state->min.load(std::memory_order_relaxed);
+    while (value < min && !state->min.compare_exchange_weak(min, value, std::memory_order_relaxed)) {}
+
+    auto max = state->max.load(std::memory_order_relaxed);
+    while (value > max && !state->max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+  }
+
+  void
+  hdr_histogram::merge(const hdr_histogram &other) {
+    if (other.count() == 0) {
+      return;
+    }
+
+    for (std::size_t x = 0; x < bucket_count; ++x) {
+      if (auto count = other.state->buckets[x].load(std::memory_order_relaxed)) {
+        state->buckets[x].fetch_add(count, std::memory_order_relaxed);
+        state->sums[x].fetch_add(other.state->sums[x].load(std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+    }
+    state->count.fetch_add(other.state->count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    state->sum.fetch_add(other.state->sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    auto other_min = other.state->min.load(std::memory_order_relaxed);
+    auto min = state->min.load(std::memory_order_relaxed);
+    while (other_min < min && !state->min.compare_exchange_weak(min, other_min, std::memory_order_relaxed)) {}
+
+    auto other_max = other.state->max.load(std::memory_order_relaxed);
+    auto max = state->max.load(std::memory_order_relaxed);
+    while (other_max > max && !state->max.compare_exchange_weak(max, other_max, std::memory_order_relaxed)) {}
+  }
+
+  void
+  hdr_histogram::reset() {
+    for (auto &bucket : state->buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    for (auto &sum : state->sums) {
+      sum.store(0, std::memory_order_relaxed);
+    }
+    state->count.store(0, std::memory_order_relaxed);
+    state->sum.store(0, std::memory_order_relaxed);
+    state->min.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_relaxed);
+    state->max.store(0, std::memory_order_relaxed);
+  }
+
+  std::uint64_t
+  hdr_histogram::count() const {
+    return state->count.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t
+  hdr_histogram::sum() const {
+    return state->sum.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t
+  hdr_histogram::min() const {
+    return count() ? state->min.load(std::memory_order_relaxed) : 0;
+  }
+
+  std::uint64_t
+  hdr_histogram::max() const {
+    return state->max.load(std::memory_order_relaxed);
+  }
+
+  double
+  hdr_histogram::mean() const {
+    auto count = this->count();
+    return count ? (double) sum() / count : 0;
+  }
+
+  std::uint64_t
+  hdr_histogram::percentile(double percentile) const {
+    // Counted from the buckets, which may be ahead of count() while values are being recorded
+    std::uint64_t total = 0;
+    for (auto &bucket : state->buckets) {
+      total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+      return 0;
+    }
+
+    // Rounded like HdrHistogram does, so 99.9 / 100 * 1000 doesn't become 1000 through 0.9990000000000001
+    auto target = std::max<std::uint64_t>(std::llround(std::clamp(percentile, 0.0, 100.0) / 100 * total), 1);
+
+    std::uint64_t seen = 0;
+    for (std::size_t x = 0; x < bucket_count; ++x) {
+      auto count = state->buckets[x].load(std::memory_order_relaxed);
+      seen += count;
+      if (seen >= target) {
+        // The count and the sum of the bucket may be a value apart while it's being recorded into
+        auto mean = (std::uint64_t) std::llround((double) state->sums[x].load(std::memory_order_relaxed) / count);
+        mean = std::clamp(mean, lowest_equivalent_value(x), highest_equivalent_value(x));
+
+        return std::clamp(mean, min(), std::max(min(), max()));
+      }
+    }
+
+    return max();
+  }
+
+  std::uint64_t
+  hdr_histogram::count_at_or_below(std::uint64_t value) const {
+    auto last = bucket_index(value);
+
+    std::uint64_t count = 0;
+    for (std::size_t x = 0; x <= last; ++x) {
+      count += state->buckets[x].load(std::memory_order_relaxed);
+    }
+
+    return count;
+  }
+
 }  // namespace stat_trackers
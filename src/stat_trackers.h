@@ -4,9 +4,14 @@
  */
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <functional>
 #include <limits>
+#include <memory>
 
 #include <boost/format.hpp>
 
@@ -18,39 +23,156 @@ namespace stat_trackers {
   boost::format
   two_digits_after_decimal();
 
+  /**
+   * @brief A histogram of non-negative integers in the style of HdrHistogram.
+   * @details Values below 128 get a bucket each, every power of two above is split into 64 linear buckets,
+   * so any value is known within 1/64 of itself. Every bucket also sums its values, so percentiles report
+   * the mean of the values in their bucket, which is exact when they're all the same.
+   * The buckets are allocated once and never grow.
+   * Recording is lock-free, so other threads can read or merge a histogram while it's being filled.
+   */
+  class hdr_histogram {
+  public:
+    static constexpr int sub_bucket_bits = 7;
+    static constexpr std::uint64_t sub_bucket_count = 1 << sub_bucket_bits;
+    static constexpr std::uint64_t sub_bucket_half = sub_bucket_count / 2;
+
+    // Larger values are recorded as this
+    static constexpr std::uint64_t max_value = (std::uint64_t { 1 } << 40) - 1;
+
+    static constexpr std::size_t bucket_count = sub_bucket_count + (40 - sub_bucket_bits) * sub_bucket_half;
+
+    hdr_histogram();
+
+    void
+    record(std::uint64_t value);
+
+    /**
+     * @brief Add the values recorded by another histogram to this one.
+     */
+    void
+    merge(const hdr_histogram &other);
+
+    /**
+     * @brief Forget all recorded values, must not race with record().
+     */
+    void
+    reset();
+
+    std::uint64_t
+    count() const;
+
+    std::uint64_t
+    sum() const;
+
+    /**
+     * @return The smallest value recorded, or 0 if there are none.
+     */
+    std::uint64_t
+    min() const;
+
+    std::uint64_t
+    max() const;
+
+    double
+    mean() const;
+
+    /**
+     * @brief Get the value that the given percentage of recorded values are at or below.
+     * @param percentile Between 0 and 100, e.g. 99.9.
+     * @return The mean of the recorded values that share the bucket of the percentile.
+     */
+    std::uint64_t
+    percentile(double percentile) const;
+
+    /**
+     * @brief Count the recorded values up to a value, e.g. for the buckets of a Prometheus histogram.
+     * @return The number of values in the buckets up to the one of value, values that share its bucket are counted too.
+     */
+    std::uint64_t
+    count_at_or_below(std::uint64_t value) const;
+
+    static std::size_t
+    bucket_index(std::uint64_t value);
+
+    /**
+     * @return The lowest value that falls into the bucket at index.
+     */
+    static std::uint64_t
+    lowest_equivalent_value(std::size_t index);
+
+    /**
+     * @return The highest value that falls into the bucket at index.
+     */
+    static std::uint64_t
+    highest_equivalent_value(std::size_t index);
+
+  private:
+    struct state_t {
+      std::array<std::atomic<std::uint64_t>, bucket_count> buckets {};
+      std::array<std::atomic<std::uint64_t>, bucket_count> sums {};
+      std::atomic<std::uint64_t> count {};
+      std::atomic<std::uint64_t> sum {};
+      std::atomic<std::uint64_t> min { std::numeric_limits<std::uint64_t>::max() };
+      std::atomic<std::uint64_t> max {};
+    };
+
+    // On the heap, so trackers can be moved and don't weigh on the stack of the threads using them
+    std::unique_ptr<state_t> state;
+  };
+
+  /**
+   * @brief Collects values in a hdr_histogram and hands it to a callback at an interval.
+   * @details Values are kept with three decimal digits, whatever their type.
+   */
   template <typename T>
-  class min_max_avg_tracker {
+  class percentile_tracker {
   public:
-    using callback_function = std::function<void(T stat_min, T stat_max, double stat_avg)>;
+    using callback_function = std::function<void(const percentile_tracker<T> &tracker)>;
 
     void
     collect_and_callback_on_interval(T stat, const callback_function &callback, std::chrono::seconds interval_in_seconds) {
-      if (data.calls == 0) {
-        data.last_callback_time = std::chrono::steady_clock::now();
+      if (histogram.count() == 0) {
+        last_callback_time = std::chrono::steady_clock::now();
       }
-      else if (std::chrono::steady_clock::now() > data.last_callback_time + interval_in_seconds) {
-        callback(data.stat_min, data.stat_max, data.stat_total / data.calls);
-        data = {};
+      else if (std::chrono::steady_clock::now() > last_callback_time + interval_in_seconds) {
+        callback(*this);
+        reset();
       }
-      data.stat_min = std::min(data.stat_min, stat);
-      data.stat_max = std::max(data.stat_max, stat);
-      data.stat_total += stat;
-      data.calls += 1;
+      histogram.record(std::llround(std::max<double>(stat, 0) * scale));
     }
 
     void
     reset() {
-      data = {};
+      histogram.reset();
+      last_callback_time = std::chrono::steady_clock::now();
+    }
+
+    double
+    min() const {
+      return histogram.min() / scale;
+    }
+
+    double
+    max() const {
+      return histogram.max() / scale;
+    }
+
+    double
+    mean() const {
+      return histogram.mean() / scale;
+    }
+
+    double
+    percentile(double percentile) const {
+      return histogram.percentile(percentile) / scale;
     }
 
   private:
-    struct {
-      std::chrono::steady_clock::time_point last_callback_time = std::chrono::steady_clock::now();
-      T stat_min = std::numeric_limits<T>::max();
-      T stat_max = std::numeric_limits<T>::min();
-      double stat_total = 0;
-      uint32_t calls = 0;
-    } data;
+    static constexpr double scale = 1000;
+
+    std::chrono::steady_clock::time_point last_callback_time = std::chrono::steady_clock::now();
+    hdr_histogram histogram;
   };
 
 }  // namespace stat_trackers
@@ -21,14 +21,18 @@ extern "C" {
 
 #include "config.h"
 #include "display_device/session.h"
+#include "flight_recorder.h"
 #include "globals.h"
 #include "input.h"
 #include "logging.h"
+#include "metrics.h"
 #include "network.h"
 #include "stream.h"
+#include "stream_packets.h"
 #include "sync.h"
 #include "system_tray.h"
 #include "thread_safe.h"
+#include "trace.h"
 #include "utility.h"
 
 #include "platform/common.h"
@@ -92,55 +96,6 @@ namespace stream {
 
 #pragma pack(push, 1)
 
-  struct video_short_frame_header_t {
-    uint8_t *
-    payload() {
-      return (uint8_t *) (this + 1);
-    }
-
-    std::uint8_t headerType;  // Always 0x01 for short headers
-
-    // Sunshine extension
-    // Frame processing latency, in 1/10 ms units
-    //     zero when the frame is repeated or there is no backend implementation
-    boost::endian::little_uint16_at frame_processing_latency;
-
-    // Currently known values:
-    // 1 = Normal P-frame
-    // 2 = IDR-frame
-    // 4 = P-frame with intra-refresh blocks
-    // 5 = P-frame after reference frame invalidation
-    std::uint8_t frameType;
-
-    // Length of the final packet payload for codecs that cannot handle
-    // zero padding, such as AV1 (Sunshine extension).
-    boost::endian::little_uint16_at lastPayloadLen;
-
-    std::uint8_t unknown[2];
-  };
-
-  static_assert(
-    sizeof(video_short_frame_header_t) == 8,
-    "Short frame header must be 8 bytes");
-
-  struct video_packet_raw_t {
-    uint8_t *
-    payload() {
-      return (uint8_t *) (this + 1);
-    }
-
-    RTP_PACKET rtp;
-    char reserved[4];
-
-    NV_VIDEO_PACKET packet;
-  };
-
-  struct video_packet_enc_prefix_t {
-    std::uint8_t iv[12];  // 12-byte IV is ideal for AES-GCM
-    std::uint32_t frameNumber;
-    std::uint8_t tag[16];
-  };
-
   struct audio_packet_t {
     RTP_PACKET rtp;
   };
@@ -454,8 +409,30 @@ namespace stream {
     safe::signal_t controlEnd;
 
     std::atomic<session::state_e> state;
+
+    std::shared_ptr<metrics::session_t> metrics;
+    std::shared_ptr<flight_recorder::recorder_t> flight_recorder;
   };
 
+  /**
+   * @brief Dump the flight recorder of the session next to the log file, without blocking the calling thread.
+   */
+  static void
+  dump_flight_recorder(session_t *session, const std::string &reason) {
+    BOOST_LOG(warning) << "Dumping the flight recorder of session "sv << session->launch_session_id << ": "sv << reason;
+
+    auto directory = std::filesystem::path { config::sunshine.log_file }.parent_path() / "flight_recorder";
+    task_pool.push([recorder = session->flight_recorder, reason, directory]() {
+      auto path = flight_recorder::write_dump(*recorder, reason, directory);
+      if (path.empty()) {
+        BOOST_LOG(error) << "Couldn't write the flight recorder to "sv << directory.string();
+        return;
+      }
+
+      BOOST_LOG(info) << "Flight recorder written to "sv << path.string();
+    });
+  }
+
   /**
    * First part of cipher must be struct of type control_encrypted_t
    *
@@ -657,36 +634,7 @@ namespace stream {
   namespace fec {
     using rs_t = util::safe_ptr<reed_solomon, [](reed_solomon *rs) { reed_solomon_release(rs); }>;
 
-    struct fec_t {
-      size_t data_shards;
-      size_t nr_shards;
-      size_t percentage;
-
-      size_t blocksize;
-      size_t prefixsize;
-      util::buffer_t<char> shards;
-      util::buffer_t<char> headers;
-      util::buffer_t<uint8_t *> shards_p;
-
-      std::vector<platf::buffer_descriptor_t> payload_buffers;
-
-      char *
-      data(size_t el) {
-        return (char *) shards_p[el];
-      }
-
-      char *
-      prefix(size_t el) {
-        return prefixsize ? &headers[el * prefixsize] : nullptr;
-      }
-
-      size_t
-      size() const {
-        return nr_shards;
-      }
-    };
-
-    static fec_t
+    fec_t
     encode(const std::string_view &payload, size_t blocksize, size_t fecpercentage, size_t minparityshards, size_t prefixsize) {
       auto payload_size = payload.size();
 
@@ -831,6 +779,336 @@ namespace stream {
     return replaced;
   }
 
+  video_fec_blocks_t
+  split_video_frame(video_short_frame_header_t &frame_header, std::string_view frame, int packetsize, int fec_percentage) {
+    frame_header.lastPayloadLen = (frame.size() + sizeof(frame_header)) % (packetsize - sizeof(NV_VIDEO_PACKET));
+    if (frame_header.lastPayloadLen == 0) {
+      frame_header.lastPayloadLen = packetsize - sizeof(NV_VIDEO_PACKET);
+    }
+
+    video_fec_blocks_t blocks {};
+    blocks.fec_percentage = fec_percentage;
+
+    // Insert space for packet headers
+    blocks.blocksize = packetsize + MAX_RTP_HEADER_SIZE;
+    auto blocksize = blocks.blocksize;
+    auto payload_blocksize = blocksize - sizeof(video_packet_raw_t);
+    blocks.payload = concat_and_insert(sizeof(video_packet_raw_t), payload_blocksize,
+      std::string_view { (char *) &frame_header, sizeof(frame_header) }, frame);
+
+    std::string_view payload { (char *) blocks.payload.data(), blocks.payload.size() };
+
+    // The max number of data shards per block is found by solving this system of equations for D:
+    // D = 255 - P
+    // P = D * F
+    // which results in the solution:
+    // D = 255 / (1 + F)
+    // multiplied by 100 since F is the percentage as an integer:
+    // D = (255 * 100) / (100 + F)
+    auto max_data_shards_per_fec_block = (DATA_SHARDS_MAX * 100) / (100 + fec_percentage);
+
+    // Compute the number of FEC blocks needed for this frame using the block size and max shards
+    auto max_data_per_fec_block = max_data_shards_per_fec_block * blocksize;
+    blocks.count = (payload.size() + (max_data_per_fec_block - 1)) / max_data_per_fec_block;
+
+    // If the number of FEC blocks needed exceeds the protocol limit, turn off FEC for this frame.
+    // For normal FEC percentages, this should only happen for enormous frames (over 800 packets at 20%).
+    if (blocks.count > MAX_FEC_BLOCKS) {
+      BOOST_LOG(warning) << "Skipping FEC for abnormally large encoded frame (needed "sv << blocks.count << " FEC blocks)"sv;
+      blocks.fec_percentage = 0;
+      blocks.count = MAX_FEC_BLOCKS;
+    }
+
+    BINARY_LOG(verbose, "Generating {} FEC blocks", blocks.count);
+
+    // Align individual FEC blocks to blocksize
+    auto unaligned_size = payload.size() / blocks.count;
+    auto aligned_size = ((unaligned_size + (blocksize - 1)) / blocksize) * blocksize;
+
+    // If we exceed the 10-bit FEC packet index (which means our frame exceeded 4096 packets),
+    // the frame will be unrecoverable. Log an error for this case.
+    if (aligned_size / blocksize >= 1024) {
+      BOOST_LOG(error) << "Encoder produced a frame too large to send! Is the encoder broken? (needed "sv << (aligned_size / blocksize) << " packets)"sv;
+    }
+
+    // Split the data into aligned FEC blocks
+    for (int x = 0; x < blocks.count; ++x) {
+      if (x == blocks.count - 1) {
+        // The last block must extend to the end of the payload
+        blocks.blocks[x] = payload.substr(x * aligned_size);
+      }
+      else {
+        // Earlier blocks just extend to the next block offset
+        blocks.blocks[x] = payload.substr(x * aligned_size, aligned_size);
+      }
+    }
+
+    return blocks;
+  }
+
+  fec::fec_t
+  encode_video_fec_block(const video_fec_blocks_t &blocks, std::size_t block_index, int lowseq, std::uint32_t frame_index, std::size_t min_parity_shards, std::size_t prefixsize) {
+    auto &block_payload = blocks.blocks[block_index];
+    auto blocksize = blocks.blocksize;
+    auto packets = (block_payload.size() + (blocksize - 1)) / blocksize;
+
+    for (int x = 0; x < packets; ++x) {
+      auto *inspect = (video_packet_raw_t *) &block_payload[x * blocksize];
+
+      inspect->packet.frameIndex = frame_index;
+      inspect->packet.streamPacketIndex = ((uint32_t) lowseq + x) << 8;
+
+      // Match multiFecFlags with Moonlight
+      inspect->packet.multiFecFlags = 0x10;
+      inspect->packet.multiFecBlocks = (block_index << 4) | ((blocks.count - 1) << 6);
+
+      inspect->packet.flags = FLAG_CONTAINS_PIC_DATA;
+      if (x == 0) {
+        inspect->packet.flags |= FLAG_SOF;
+      }
+      if (x == packets - 1) {
+        inspect->packet.flags |= FLAG_EOF;
+      }
+    }
+
+    return fec::encode(block_payload, blocksize, blocks.fec_percentage, min_parity_shards, prefixsize);
+  }
+
+  void
+  finish_video_fec_block(fec::fec_t &shards, const video_fec_blocks_t &blocks, std::size_t block_index, int lowseq, std::uint32_t frame_index, std::uint32_t timestamp) {
+    // set FEC info now that we know for sure what our percentage will be for this frame
+    for (auto x = 0; x < shards.size(); ++x) {
+      auto *inspect = (video_packet_raw_t *) shards.data(x);
+
+      inspect->packet.fecInfo =
+        (x << 12 |
+          shards.data_shards << 22 |
+          shards.percentage << 4);
+
+      inspect->rtp.header = 0x80 | FLAG_EXTENSION;
+      inspect->rtp.sequenceNumber = util::endian::big<uint16_t>(lowseq + x);
+      inspect->rtp.timestamp = util::endian::big<uint32_t>(timestamp);
+
+      inspect->packet.multiFecBlocks = (block_index << 4) | ((blocks.count - 1) << 6);
+      inspect->packet.frameIndex = frame_index;
+    }
+  }
+
+  video_sender_t::video_sender_t(std::unique_ptr<platf::high_precision_timer> timer, std::chrono::steady_clock::time_point epoch):
+      timer { std::move(timer) },
+      epoch { epoch },
+      ratecontrol_next_frame_start { std::chrono::steady_clock::now() },
+      iv(12),
+      fec_worker { 1 },
+      frame_send_batch_latency_logger { debug, "Network: each send_batch() latency" },
+      frame_fec_latency_logger { debug, "Network: each FEC block latency" } {}
+
+  video_frame_sent_t
+  video_sender_t::send_frame(video::packet_raw_t &packet, const video_fec_blocks_t &fec_blocks, const video_destination_t &destination) {
+    auto lowseq = destination.lowseq;
+
+    auto blocksize = fec_blocks.blocksize;
+    auto fec_blocks_needed = fec_blocks.count;
+
+    // Use around 80% of 1Gbps          1Gbps            percent    ms     packet      byte
+    size_t ratecontrol_packets_in_1ms = std::giga::num * 80 / 100 / 1000 / blocksize / 8;
+
+    // Send less than 64K in a single batch.
+    // On Windows, batches above 64K seem to bypass SO_SNDBUF regardless of its size,
+    // appear in "Other I/O" and begin waiting for interrupts.
+    // This gives inconsistent performance so we'd rather avoid it.
+    size_t send_batch_size = 64 * 1024 / blocksize;
+    // Also don't exceed 64 packets, which can happen when Moonlight requests
+    // unusually small packet size.
+    // Generic Segmentation Offload on Linux can't do more than 64.
+    send_batch_size = std::min<size_t>(64, send_batch_size);
+
+    // Don't ignore the last ratecontrol group of the previous frame
+    auto ratecontrol_frame_start = std::max(ratecontrol_next_frame_start, std::chrono::steady_clock::now());
+
+    size_t ratecontrol_frame_packets_sent = 0;
+    size_t ratecontrol_group_packets_sent = 0;
+
+    video_frame_sent_t sent {
+      .shards = 0,
+      .fec_percentage = fec_blocks.fec_percentage,
+      .pacing_sleep = {},
+    };
+
+    // Stamp the packet headers of a FEC block and generate its parity shards
+    auto encode_fec_block = [&](int block_index, int block_lowseq) {
+      // If video encryption is enabled, we allocate space for the encryption header before each shard
+      return encode_video_fec_block(fec_blocks, block_index, block_lowseq, packet.frame_index(), destination.min_parity_shards,
+        destination.cipher ? sizeof(video_packet_enc_prefix_t) : 0);
+    };
+
+    // The parity shards of the next FEC block are generated while the current one is
+    // encrypted and paced out, so large frames don't wait on Reed-Solomon between blocks.
+    // The blocks cover disjoint parts of the payload, so this needs no synchronization.
+    std::future<fec::fec_t> next_block_shards;
+
+    // The worker uses the payload of this frame, it must be done before the payload goes away
+    auto wait_for_next_block = util::fail_guard([&]() {
+      if (next_block_shards.valid()) {
+        next_block_shards.wait();
+      }
+    });
+
+    auto peer_address = destination.peer.address();
+    auto local_address = destination.local_address;
+
+    for (int blockIndex = 0; blockIndex < fec_blocks_needed; ++blockIndex) {
+      frame_fec_latency_logger.first_point_now();
+      auto fec_begin = trace::now();
+      auto shards = next_block_shards.valid() ? next_block_shards.get() : encode_fec_block(blockIndex, lowseq);
+      trace::record("fec", packet.frame_index(), fec_begin, trace::now());
+      frame_fec_latency_logger.second_point_now_and_log();
+
+      destination.metrics.fec_shards.add(shards.size() - shards.data_shards);
+      sent.shards += shards.size();
+
+      if (blockIndex + 1 < fec_blocks_needed) {
+        next_block_shards = fec_worker.push(encode_fec_block, blockIndex + 1, lowseq + (int) shards.size());
+      }
+
+      auto batch_info = platf::batched_send_info_t {
+        shards.headers.begin(),
+        shards.prefixsize,
+        shards.payload_buffers,
+        shards.blocksize,
+        0,
+        0,
+        destination.sock,
+        peer_address,
+        destination.peer.port(),
+        local_address,
+      };
+
+      size_t next_shard_to_send = 0;
+
+      // Shards are encrypted one at a time right before their batch is sent
+      auto encrypt_begin = trace::now();
+
+      // RTP video timestamps use a 90 KHz clock and the frame_timestamp from when the frame was captured
+      // When a timestamp isn't available (duplicate frames), the timestamp from rate control is used instead.
+      bool frame_is_dupe = false;
+      if (!packet.frame_timestamp) {
+        packet.frame_timestamp = ratecontrol_next_frame_start;
+        frame_is_dupe = true;
+      }
+      using rtp_tick = std::chrono::duration<uint32_t, std::ratio<1, 90000>>;
+      uint32_t timestamp = std::chrono::round<rtp_tick>(*packet.frame_timestamp - epoch).count();
+
+      finish_video_fec_block(shards, fec_blocks, blockIndex, lowseq, packet.frame_index(), timestamp);
+
+      for (auto x = 0; x < shards.size(); ++x) {
+        auto *inspect = (video_packet_raw_t *) shards.data(x);
+
+        // Encrypt this shard if video encryption is enabled
+        if (destination.cipher) {
+          // We use the deterministic IV construction algorithm specified in NIST SP 800-38D
+          // Section 8.2.1. The sequence number is our "invocation" field and the 'V' in the
+          // high bytes is the "fixed" field. Because each client provides their own unique
+          // key, our values in the fixed field need only uniquely identify each independent
+          // use of the client's key with AES-GCM in our code.
+          //
+          // The IV counter is 64 bits long which allows for 2^64 encrypted video packets
+          // to be sent to each client before the IV repeats.
+          std::copy_n((uint8_t *) &destination.gcm_iv_counter, sizeof(destination.gcm_iv_counter), std::begin(iv));
+          iv[11] = 'V';  // Video stream
+          destination.gcm_iv_counter++;
+
+          // Encrypt the target buffer in place
+          auto *prefix = (video_packet_enc_prefix_t *) shards.prefix(x);
+          prefix->frameNumber = packet.frame_index();
+          std::copy(std::begin(iv), std::end(iv), prefix->iv);
+          destination.cipher->encrypt(std::string_view { (char *) inspect, (size_t) blocksize },
+            prefix->tag, (uint8_t *) inspect, &iv);
+        }
+
+        if (x - next_shard_to_send + 1 >= send_batch_size ||
+            x + 1 == shards.size()) {
+          if (destination.cipher) {
+            trace::record("encrypt", packet.frame_index(), encrypt_begin, trace::now());
+          }
+
+          // Do pacing within the frame.
+          // Also trigger pacing before the first send_batch() of the frame
+          // to account for the last send_batch() of the previous frame.
+          if (ratecontrol_group_packets_sent >= ratecontrol_packets_in_1ms ||
+              ratecontrol_frame_packets_sent == 0) {
+            auto due = ratecontrol_frame_start +
+                       std::chrono::duration_cast<std::chrono::nanoseconds>(1ms) *
+                         ratecontrol_frame_packets_sent / ratecontrol_packets_in_1ms;
+
+            auto now = std::chrono::steady_clock::now();
+            if (now < due) {
+              timer->sleep_for(due - now);
+
+              auto slept = trace::clock::now();
+              trace::record("pacing sleep", packet.frame_index(), now, slept);
+              destination.metrics.pacing_sleep_ns.add(std::chrono::duration_cast<std::chrono::nanoseconds>(slept - now).count());
+              sent.pacing_sleep += slept - now;
+            }
+
+            ratecontrol_group_packets_sent = 0;
+          }
+
+          size_t current_batch_size = x - next_shard_to_send + 1;
+          batch_info.block_offset = next_shard_to_send;
+          batch_info.block_count = current_batch_size;
+
+          frame_send_batch_latency_logger.first_point_now();
+          trace::scope_t trace_send_batch { "send_batch", packet.frame_index() };
+          // Use a batched send if it's supported on this platform
+          if (!platf::send_batch(batch_info)) {
+            // Batched send is not available, so send each packet individually
+            BINARY_LOG(verbose, "Falling back to unbatched send");
+            for (auto y = 0; y < current_batch_size; y++) {
+              auto send_info = platf::send_info_t {
+                shards.prefix(next_shard_to_send + y),
+                shards.prefixsize,
+                shards.data(next_shard_to_send + y),
+                shards.blocksize,
+                destination.sock,
+                peer_address,
+                destination.peer.port(),
+                local_address,
+              };
+
+              if (!platf::send(send_info)) {
+                destination.metrics.send_errors.add();
+              }
+            }
+          }
+          frame_send_batch_latency_logger.second_point_now_and_log();
+
+          ratecontrol_group_packets_sent += current_batch_size;
+          ratecontrol_frame_packets_sent += current_batch_size;
+          next_shard_to_send = x + 1;
+          encrypt_begin = trace::now();
+        }
+      }
+
+      // remember this in case the next frame comes immediately
+      ratecontrol_next_frame_start = ratecontrol_frame_start +
+                                     std::chrono::duration_cast<std::chrono::nanoseconds>(1ms) *
+                                       ratecontrol_frame_packets_sent / ratecontrol_packets_in_1ms;
+
+      BINARY_LOG(verbose, "Sent Frame seq [{}] pts [{}] shards [{}/{}%]{}{}{}",
+        packet.frame_index(), timestamp, shards.size(), shards.percentage,
+        frame_is_dupe ? " Dupe" : "",
+        packet.is_idr() ? " Key" : "",
+        packet.after_ref_frame_invalidation ? " RFI" : "");
+
+      lowseq += shards.size();
+    }
+
+    destination.lowseq = lowseq;
+
+    return sent;
+  }
+
   /**
    * @brief Pass gamepad feedback data back to the client.
    * @param session The session object.
@@ -986,7 +1264,7 @@ namespace stream {
   void
   controlBroadcastThread(control_server_t *server) {
     server->map(packetTypes[IDX_PERIODIC_PING], [](session_t *session, const std::string_view &payload) {
-      BOOST_LOG(verbose) << "type [IDX_PERIODIC_PING]"sv;
+      BINARY_LOG(verbose, "type [IDX_PERIODIC_PING]");
     });
 
     server->map(packetTypes[IDX_START_A], [&](session_t *session, const std::string_view &payload) {
@@ -1004,18 +1282,28 @@ namespace stream {
 
       auto lastGoodFrame = stats[3];
 
-      BOOST_LOG(verbose)
-        << "type [IDX_LOSS_STATS]"sv << std::endl
-        << "---begin stats---" << std::endl
-        << "loss count since last report [" << count << ']' << std::endl
-        << "time in milli since last report [" << t.count() << ']' << std::endl
-        << "last good frame [" << lastGoodFrame << ']' << std::endl
-        << "---end stats---";
+      if (count > 0) {
+        session->metrics->client_lost_packets.add(count);
+      }
+      session->flight_recorder->loss_report(count, t.count(), lastGoodFrame);
+
+      BINARY_LOG(verbose,
+        "type [IDX_LOSS_STATS]\n"
+        "---begin stats---\n"
+        "loss count since last report [{}]\n"
+        "time in milli since last report [{}]\n"
+        "last good frame [{}]\n"
+        "---end stats---",
+        count, t.count(), lastGoodFrame);
     });
 
     server->map(packetTypes[IDX_REQUEST_IDR_FRAME], [&](session_t *session, const std::string_view &payload) {
       BOOST_LOG(debug) << "type [IDX_REQUEST_IDR_FRAME]"sv;
 
+      if (auto reason = session->flight_recorder->idr_request()) {
+        dump_flight_recorder(session, *reason);
+      }
+
       session->video.idr_events->raise(true);
     });
 
@@ -1032,6 +1320,7 @@ namespace stream {
           param.type = video::dynamic_param_type_e::BITRATE;
           param.value.int_value = new_bitrate;
           param.valid = true;
+          session->flight_recorder->dynamic_param((int) param.type, new_bitrate);
           session->video.dynamic_param_change_events->raise(param);
         }
         else {
@@ -1053,6 +1342,7 @@ namespace stream {
         << "firstFrame [" << firstFrame << ']' << std::endl
         << "lastFrame [" << lastFrame << ']';
 
+      session->flight_recorder->rfi_request(firstFrame, lastFrame);
       session->video.invalidate_ref_frames_events->raise(std::make_pair(firstFrame, lastFrame));
     });
 
@@ -1079,11 +1369,12 @@ namespace stream {
         std::copy(payload.end() - 16, payload.end(), std::begin(iv));
       }
 
+      session->metrics->input_events.add();
       input::passthrough(session->input, std::move(plaintext));
     });
 
     server->map(packetTypes[IDX_ENCRYPTED], [server](session_t *session, const std::string_view &payload) {
-      BOOST_LOG(verbose) << "type [IDX_ENCRYPTED]"sv;
+      BINARY_LOG(verbose, "type [IDX_ENCRYPTED]");
 
       auto header = (control_encrypted_p) (payload.data() - 2);
 
@@ -1143,6 +1434,7 @@ namespace stream {
       // IDX_INPUT_DATA callback will attempt to decrypt unencrypted data, therefore we need pass it directly
       if (type == packetTypes[IDX_INPUT_DATA]) {
         plaintext.erase(std::begin(plaintext), std::begin(plaintext) + 4);
+        session->metrics->input_events.add();
         input::passthrough(session->input, std::move(plaintext));
       }
       else {
@@ -1177,6 +1469,9 @@ namespace stream {
           if (now > session->pingTimeout) {
             auto address = session->control.peer ? platf::from_sockaddr((sockaddr *) &session->control.peer->address.address) : session->control.expected_peer_address;
             BOOST_LOG(info) << address << ": Ping Timeout"sv;
+            if (auto reason = session->flight_recorder->ping_timeout()) {
+              dump_flight_recorder(session, *reason);
+            }
             session::stop(*session);
           }
 
@@ -1203,6 +1498,9 @@ namespace stream {
             has_session_awaiting_peer = true;
           }
           else {
+            session->metrics->rtt_ms.set(session->control.peer->roundTripTime);
+            session->metrics->rtt_variance_ms.set(session->control.peer->roundTripTimeVariance);
+
             auto &feedback_queue = session->control.feedback_queue;
             while (feedback_queue->peek()) {
               auto feedback_msg = feedback_queue->pop();
@@ -1297,7 +1595,7 @@ namespace stream {
         }
       });
 
-      BOOST_LOG(verbose) << "Mic Recv: "sv << peer.address().to_string() << ':' << peer.port();
+      BINARY_LOG(verbose, "Mic Recv: {}:{}", peer.address().to_string(), peer.port());
 
       if (ec == boost::system::errc::connection_refused ||
           ec == boost::system::errc::connection_reset) {
@@ -1477,7 +1775,7 @@ namespace stream {
           }
         });
 
-        BOOST_LOG(verbose) << "Recv: "sv << peer.address().to_string() << ':' << peer.port() << " :: " << type_str;
+        BINARY_LOG(verbose, "Recv: {}:{} :: {}", peer.address().to_string(), peer.port(), type_str);
 
         update_session_map(message_queue_queue, peer_to_video_session, peer_to_audio_session);
 
@@ -1524,20 +1822,19 @@ namespace stream {
     platf::adjust_thread_priority(platf::thread_priority_e::high);
 
     logging::min_max_avg_periodic_logger<double> frame_processing_latency_logger(debug, "Frame processing latency", "ms");
+    logging::min_max_avg_periodic_logger<double> frame_size_logger(debug, "Encoded frame size", "KB");
 
-    logging::time_delta_periodic_logger frame_send_batch_latency_logger(debug, "Network: each send_batch() latency");
-    logging::time_delta_periodic_logger frame_fec_latency_logger(debug, "Network: each FEC block latency");
     logging::time_delta_periodic_logger frame_network_latency_logger(debug, "Network: frame's overall network latency");
 
-    crypto::aes_t iv(12);
-
     auto timer = platf::create_high_precision_timer();
     if (!timer || !*timer) {
       BOOST_LOG(error) << "Failed to create timer, aborting video broadcast thread";
       return;
     }
 
-    auto ratecontrol_next_frame_start = std::chrono::steady_clock::now();
+    video_sender_t sender { std::move(timer), video_epoch };
+
+    trace::name_thread("video broadcast");
 
     while (auto packet = packets->pop()) {
       if (shutdown_event->peek()) {
@@ -1545,9 +1842,9 @@ namespace stream {
       }
 
       frame_network_latency_logger.first_point_now();
+      auto packetize_begin = trace::now();
 
       auto session = (session_t *) packet->channel_data;
-      auto lowseq = session->video.lowseq;
 
       std::string_view payload { (char *) packet->data(), packet->data_size() };
       std::vector<uint8_t> payload_with_replacements;
@@ -1571,270 +1868,66 @@ namespace stream {
       frame_header.frameType = packet->is_idr()                     ? 2 :
                                packet->after_ref_frame_invalidation ? 5 :
                                                                       1;
-      frame_header.lastPayloadLen = (payload.size() + sizeof(frame_header)) % (session->config.packetsize - sizeof(NV_VIDEO_PACKET));
-      if (frame_header.lastPayloadLen == 0) {
-        frame_header.lastPayloadLen = session->config.packetsize - sizeof(NV_VIDEO_PACKET);
-      }
 
+      std::chrono::steady_clock::duration processing_duration {};
       if (packet->frame_timestamp) {
         auto duration_to_latency = [](const std::chrono::steady_clock::duration &duration) {
           const auto duration_us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
           return (uint16_t) std::clamp<decltype(duration_us)>((duration_us + 50) / 100, 0, std::numeric_limits<uint16_t>::max());
         };
 
-        uint16_t latency = duration_to_latency(std::chrono::steady_clock::now() - *packet->frame_timestamp);
+        processing_duration = std::chrono::steady_clock::now() - *packet->frame_timestamp;
+        uint16_t latency = duration_to_latency(processing_duration);
         frame_header.frame_processing_latency = latency;
         frame_processing_latency_logger.collect_and_log(latency / 10.);
+        session->metrics->frame_processing_latency.observe(processing_duration);
       }
       else {
         frame_header.frame_processing_latency = 0;
       }
 
-      auto fecPercentage = config::stream.fec_percentage;
-
-      // Insert space for packet headers
-      auto blocksize = session->config.packetsize + MAX_RTP_HEADER_SIZE;
-      auto payload_blocksize = blocksize - sizeof(video_packet_raw_t);
-      auto payload_new = concat_and_insert(sizeof(video_packet_raw_t), payload_blocksize,
-        std::string_view { (char *) &frame_header, sizeof(frame_header) }, payload);
-
-      payload = std::string_view { (char *) payload_new.data(), payload_new.size() };
+      // The peak shows how large IDR frames get compared to intra refresh waves
+      frame_size_logger.collect_and_log(payload.size() / 1024.);
 
-      // There are 2 bits for FEC block count for a maximum of 4 FEC blocks
-      constexpr auto MAX_FEC_BLOCKS = 4;
-
-      // The max number of data shards per block is found by solving this system of equations for D:
-      // D = 255 - P
-      // P = D * F
-      // which results in the solution:
-      // D = 255 / (1 + F)
-      // multiplied by 100 since F is the percentage as an integer:
-      // D = (255 * 100) / (100 + F)
-      auto max_data_shards_per_fec_block = (DATA_SHARDS_MAX * 100) / (100 + fecPercentage);
-
-      // Compute the number of FEC blocks needed for this frame using the block size and max shards
-      auto max_data_per_fec_block = max_data_shards_per_fec_block * blocksize;
-      auto fec_blocks_needed = (payload.size() + (max_data_per_fec_block - 1)) / max_data_per_fec_block;
-
-      // If the number of FEC blocks needed exceeds the protocol limit, turn off FEC for this frame.
-      // For normal FEC percentages, this should only happen for enormous frames (over 800 packets at 20%).
-      if (fec_blocks_needed > MAX_FEC_BLOCKS) {
-        BOOST_LOG(warning) << "Skipping FEC for abnormally large encoded frame (needed "sv << fec_blocks_needed << " FEC blocks)"sv;
-        fecPercentage = 0;
-        fec_blocks_needed = MAX_FEC_BLOCKS;
+      auto encoded_size = payload.size();
+      session->metrics->encoded_bytes.add(encoded_size);
+      if (packet->encode_duration != std::chrono::steady_clock::duration::zero()) {
+        session->metrics->encode_latency.observe(packet->encode_duration);
       }
 
-      std::array<std::string_view, MAX_FEC_BLOCKS> fec_blocks;
-      decltype(fec_blocks)::iterator
-        fec_blocks_begin = std::begin(fec_blocks),
-        fec_blocks_end = std::begin(fec_blocks) + fec_blocks_needed;
+      auto fec_blocks = split_video_frame(frame_header, payload, session->config.packetsize, config::stream.fec_percentage);
 
-      BOOST_LOG(verbose) << "Generating "sv << fec_blocks_needed << " FEC blocks"sv;
+      trace::record("packetize", packet->frame_index(), packetize_begin, trace::now());
 
-      // Align individual FEC blocks to blocksize
-      auto unaligned_size = payload.size() / fec_blocks_needed;
-      auto aligned_size = ((unaligned_size + (blocksize - 1)) / blocksize) * blocksize;
-
-      // If we exceed the 10-bit FEC packet index (which means our frame exceeded 4096 packets),
-      // the frame will be unrecoverable. Log an error for this case.
-      if (aligned_size / blocksize >= 1024) {
-        BOOST_LOG(error) << "Encoder produced a frame too large to send! Is the encoder broken? (needed "sv << (aligned_size / blocksize) << " packets)"sv;
-      }
-
-      // Split the data into aligned FEC blocks
-      for (int x = 0; x < fec_blocks_needed; ++x) {
-        if (x == fec_blocks_needed - 1) {
-          // The last block must extend to the end of the payload
-          fec_blocks[x] = payload.substr(x * aligned_size);
-        }
-        else {
-          // Earlier blocks just extend to the next block offset
-          fec_blocks[x] = payload.substr(x * aligned_size, aligned_size);
-        }
-      }
+      video_destination_t destination {
+        .sock = (uintptr_t) sock.native_handle(),
+        .peer = session->video.peer,
+        .local_address = session->localAddress,
+        .min_parity_shards = session->config.minRequiredFecPackets,
+        .cipher = session->video.cipher ? &*session->video.cipher : nullptr,
+        .gcm_iv_counter = session->video.gcm_iv_counter,
+        .lowseq = session->video.lowseq,
+        .metrics = *session->metrics,
+      };
 
       try {
-        // Use around 80% of 1Gbps          1Gbps            percent    ms     packet      byte
-        size_t ratecontrol_packets_in_1ms = std::giga::num * 80 / 100 / 1000 / blocksize / 8;
-
-        // Send less than 64K in a single batch.
-        // On Windows, batches above 64K seem to bypass SO_SNDBUF regardless of its size,
-        // appear in "Other I/O" and begin waiting for interrupts.
-        // This gives inconsistent performance so we'd rather avoid it.
-        size_t send_batch_size = 64 * 1024 / blocksize;
-        // Also don't exceed 64 packets, which can happen when Moonlight requests
-        // unusually small packet size.
-        // Generic Segmentation Offload on Linux can't do more than 64.
-        send_batch_size = std::min<size_t>(64, send_batch_size);
-
-        // Don't ignore the last ratecontrol group of the previous frame
-        auto ratecontrol_frame_start = std::max(ratecontrol_next_frame_start, std::chrono::steady_clock::now());
-
-        size_t ratecontrol_frame_packets_sent = 0;
-        size_t ratecontrol_group_packets_sent = 0;
-
-        auto blockIndex = 0;
-        std::for_each(fec_blocks_begin, fec_blocks_end, [&](std::string_view &current_payload) {
-          auto packets = (current_payload.size() + (blocksize - 1)) / blocksize;
-
-          for (int x = 0; x < packets; ++x) {
-            auto *inspect = (video_packet_raw_t *) &current_payload[x * blocksize];
-
-            inspect->packet.frameIndex = packet->frame_index();
-            inspect->packet.streamPacketIndex = ((uint32_t) lowseq + x) << 8;
-
-            // Match multiFecFlags with Moonlight
-            inspect->packet.multiFecFlags = 0x10;
-            inspect->packet.multiFecBlocks = (blockIndex << 4) | ((fec_blocks_needed - 1) << 6);
-
-            inspect->packet.flags = FLAG_CONTAINS_PIC_DATA;
-            if (x == 0) {
-              inspect->packet.flags |= FLAG_SOF;
-            }
-            if (x == packets - 1) {
-              inspect->packet.flags |= FLAG_EOF;
-            }
-          }
-
-          frame_fec_latency_logger.first_point_now();
-          // If video encryption is enabled, we allocate space for the encryption header before each shard
-          auto shards = fec::encode(current_payload, blocksize, fecPercentage, session->config.minRequiredFecPackets,
-            session->video.cipher ? sizeof(video_packet_enc_prefix_t) : 0);
-          frame_fec_latency_logger.second_point_now_and_log();
-
-          auto peer_address = session->video.peer.address();
-          auto batch_info = platf::batched_send_info_t {
-            shards.headers.begin(),
-            shards.prefixsize,
-            shards.payload_buffers,
-            shards.blocksize,
-            0,
-            0,
-            (uintptr_t) sock.native_handle(),
-            peer_address,
-            session->video.peer.port(),
-            session->localAddress,
-          };
-
-          size_t next_shard_to_send = 0;
-
-          // RTP video timestamps use a 90 KHz clock and the frame_timestamp from when the frame was captured
-          // When a timestamp isn't available (duplicate frames), the timestamp from rate control is used instead.
-          bool frame_is_dupe = false;
-          if (!packet->frame_timestamp) {
-            packet->frame_timestamp = ratecontrol_next_frame_start;
-            frame_is_dupe = true;
-          }
-          using rtp_tick = std::chrono::duration<uint32_t, std::ratio<1, 90000>>;
-          uint32_t timestamp = std::chrono::round<rtp_tick>(*packet->frame_timestamp - video_epoch).count();
-
-          // set FEC info now that we know for sure what our percentage will be for this frame
-          for (auto x = 0; x < shards.size(); ++x) {
-            auto *inspect = (video_packet_raw_t *) shards.data(x);
-
-            inspect->packet.fecInfo =
-              (x << 12 |
-                shards.data_shards << 22 |
-                shards.percentage << 4);
-
-            inspect->rtp.header = 0x80 | FLAG_EXTENSION;
-            inspect->rtp.sequenceNumber = util::endian::big<uint16_t>(lowseq + x);
-            inspect->rtp.timestamp = util::endian::big<uint32_t>(timestamp);
-
-            inspect->packet.multiFecBlocks = (blockIndex << 4) | ((fec_blocks_needed - 1) << 6);
-            inspect->packet.frameIndex = packet->frame_index();
-
-            // Encrypt this shard if video encryption is enabled
-            if (session->video.cipher) {
-              // We use the deterministic IV construction algorithm specified in NIST SP 800-38D
-              // Section 8.2.1. The sequence number is our "invocation" field and the 'V' in the
-              // high bytes is the "fixed" field. Because each client provides their own unique
-              // key, our values in the fixed field need only uniquely identify each independent
-              // use of the client's key with AES-GCM in our code.
-              //
-              // The IV counter is 64 bits long which allows for 2^64 encrypted video packets
-              // to be sent to each client before the IV repeats.
-              std::copy_n((uint8_t *) &session->video.gcm_iv_counter, sizeof(session->video.gcm_iv_counter), std::begin(iv));
-              iv[11] = 'V';  // Video stream
-              session->video.gcm_iv_counter++;
-
-              // Encrypt the target buffer in place
-              auto *prefix = (video_packet_enc_prefix_t *) shards.prefix(x);
-              prefix->frameNumber = packet->frame_index();
-              std::copy(std::begin(iv), std::end(iv), prefix->iv);
-              session->video.cipher->encrypt(std::string_view { (char *) inspect, (size_t) blocksize },
-                prefix->tag, (uint8_t *) inspect, &iv);
-            }
-
-            if (x - next_shard_to_send + 1 >= send_batch_size ||
-                x + 1 == shards.size()) {
-              // Do pacing within the frame.
-              // Also trigger pacing before the first send_batch() of the frame
-              // to account for the last send_batch() of the previous frame.
-              if (ratecontrol_group_packets_sent >= ratecontrol_packets_in_1ms ||
-                  ratecontrol_frame_packets_sent == 0) {
-                auto due = ratecontrol_frame_start +
-                           std::chrono::duration_cast<std::chrono::nanoseconds>(1ms) *
-                             ratecontrol_frame_packets_sent / ratecontrol_packets_in_1ms;
-
-                auto now = std::chrono::steady_clock::now();
-                if (now < due) {
-                  timer->sleep_for(due - now);
-                }
-
-                ratecontrol_group_packets_sent = 0;
-              }
-
-              size_t current_batch_size = x - next_shard_to_send + 1;
-              batch_info.block_offset = next_shard_to_send;
-              batch_info.block_count = current_batch_size;
-
-              frame_send_batch_latency_logger.first_point_now();
-              // Use a batched send if it's supported on this platform
-              if (!platf::send_batch(batch_info)) {
-                // Batched send is not available, so send each packet individually
-                BOOST_LOG(verbose) << "Falling back to unbatched send"sv;
-                for (auto y = 0; y < current_batch_size; y++) {
-                  auto send_info = platf::send_info_t {
-                    shards.prefix(next_shard_to_send + y),
-                    shards.prefixsize,
-                    shards.data(next_shard_to_send + y),
-                    shards.blocksize,
-                    (uintptr_t) sock.native_handle(),
-                    peer_address,
-                    session->video.peer.port(),
-                    session->localAddress,
-                  };
-
-                  platf::send(send_info);
-                }
-              }
-              frame_send_batch_latency_logger.second_point_now_and_log();
-
-              ratecontrol_group_packets_sent += current_batch_size;
-              ratecontrol_frame_packets_sent += current_batch_size;
-              next_shard_to_send = x + 1;
-            }
-          }
-
-          // remember this in case the next frame comes immediately
-          ratecontrol_next_frame_start = ratecontrol_frame_start +
-                                         std::chrono::duration_cast<std::chrono::nanoseconds>(1ms) *
-                                           ratecontrol_frame_packets_sent / ratecontrol_packets_in_1ms;
-
-          frame_network_latency_logger.second_point_now_and_log();
-
-          BOOST_LOG(verbose) << "Sent Frame seq ["sv << packet->frame_index() << "] pts ["sv << timestamp
-                             << "] shards ["sv << shards.size() << "/"sv << shards.percentage << "%]"sv
-                             << (frame_is_dupe ? " Dupe" : "")
-                             << (packet->is_idr() ? " Key" : "")
-                             << (packet->after_ref_frame_invalidation ? " RFI" : "");
-
-          ++blockIndex;
-          lowseq += shards.size();
+        auto sent = sender.send_frame(*packet, fec_blocks, destination);
+
+        frame_network_latency_logger.second_point_now_and_log();
+        session->metrics->frames_sent.add();
+
+        auto stall = session->flight_recorder->frame_sent({
+          packet->frame_index(),
+          frame_header.frameType,
+          encoded_size,
+          sent.shards,
+          sent.fec_percentage,
+          processing_duration,
+          sent.pacing_sleep,
         });
-
-        session->video.lowseq = lowseq;
+        if (stall) {
+          dump_flight_recorder(session, *stall);
+        }
       }
       catch (const std::exception &e) {
         BOOST_LOG(error) << "Broadcast video failed "sv << e.what();
@@ -1891,7 +1984,7 @@ namespace stream {
         break;
       }
 
-      BOOST_LOG(verbose) << "Audio [seq "sv << sequenceNumber << ", pts "sv << timestamp << "] ::  send..."sv;
+      BINARY_LOG(verbose, "Audio [seq {}, pts {}] ::  send...", sequenceNumber, timestamp);
 
       audio_packet.rtp.sequenceNumber = util::endian::big(sequenceNumber);
       audio_packet.rtp.timestamp = util::endian::big(timestamp);
@@ -1911,7 +2004,10 @@ namespace stream {
           session->audio.peer.port(),
           session->localAddress,
         };
-        platf::send(send_info);
+        if (!platf::send(send_info)) {
+          session->metrics->send_errors.add();
+        }
+        session->metrics->audio_packets.add();
 
         auto &fec_packet = session->audio.fec_packet;
         // initialize the FEC header at the beginning of the FEC block
@@ -1938,8 +2034,10 @@ namespace stream {
               session->audio.peer.port(),
               session->localAddress,
             };
-            platf::send(send_info);
-            BOOST_LOG(verbose) << "Audio FEC ["sv << (sequenceNumber & ~(RTPA_DATA_SHARDS - 1)) << ' ' << x << "] ::  send..."sv;
+            if (!platf::send(send_info)) {
+              session->metrics->send_errors.add();
+            }
+            BINARY_LOG(verbose, "Audio FEC [{} {}] ::  send...", sequenceNumber & ~(RTPA_DATA_SHARDS - 1), x);
           }
         }
       }
@@ -2345,6 +2443,8 @@ namespace stream {
       session->client_name = launch_session.client_name;
 
       session->config = config;
+      session->metrics = metrics::make_session(launch_session.id, launch_session.client_name);
+      session->flight_recorder = flight_recorder::make_recorder(launch_session.id, launch_session.client_name, config::stream.stall_threshold);
 
       session->control.connect_data = launch_session.control_connect_data;
       session->control.feedback_queue = mail->queue<platf::gamepad_feedback_msg_t>(mail::gamepad_feedback);
@@ -2420,6 +2520,7 @@ namespace stream {
       for (auto session_p : *broadcast_ref->control_server._sessions) {
         if (session_p->client_name == client_name &&
             session_p->state.load(std::memory_order_relaxed) == state_e::RUNNING) {
+          session_p->flight_recorder->dynamic_param((int) param.type, param.value.int_value);
           session_p->video.dynamic_param_change_events->raise(param);
           BOOST_LOG(info) << "Sent dynamic parameter change event to client '" << client_name
                           << "': type=" << (int) param.type;
@@ -52,6 +52,49 @@ namespace stream {
     int app_id;
   };
 
+  namespace fec {
+    struct fec_t {
+      size_t data_shards;
+      size_t nr_shards;
+      size_t percentage;
+
+      size_t blocksize;
+      size_t prefixsize;
+      util::buffer_t<char> shards;
+      util::buffer_t<char> headers;
+      util::buffer_t<uint8_t *> shards_p;
+
+      std::vector<platf::buffer_descriptor_t> payload_buffers;
+
+      char *
+      data(size_t el) {
+        return (char *) shards_p[el];
+      }
+
+      char *
+      prefix(size_t el) {
+        return prefixsize ? &headers[el * prefixsize] : nullptr;
+      }
+
+      size_t
+      size() const {
+        return nr_shards;
+      }
+    };
+
+    /**
+     * @brief Split a FEC block into data shards and generate its parity shards.
+     * @param payload The FEC block, the last data shard is zero-padded if it's short.
+     * @param blocksize The size of each shard.
+     * @param fecpercentage The percentage of parity shards relative to the data shards.
+     * @param minparityshards The minimum number of parity shards.
+     * @param prefixsize The space to reserve before each shard for the encryption header.
+     * @return The shards.
+     */
+    fec_t
+    encode(const std::string_view &payload, size_t blocksize, size_t fecpercentage, size_t minparityshards, size_t prefixsize);
+  }  // namespace fec
+
   namespace session {
     enum class state_e : int {
       STOPPED,  ///< The session is stopped
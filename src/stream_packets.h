@@ -0,0 +1,190 @@
+/**
+ * @file src/stream_packets.h
+ * @brief Declarations for the packets of the video stream.
+ */
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <boost/endian/arithmetic.hpp>
+
+extern "C" {
+#include <moonlight-common-c/src/Limelight-internal.h>
+}
+
+#include "logging.h"
+#include "metrics.h"
+#include "stream.h"
+#include "thread_pool.h"
+
+namespace stream {
+#pragma pack(push, 1)
+
+  struct video_short_frame_header_t {
+    uint8_t *
+    payload() {
+      return (uint8_t *) (this + 1);
+    }
+
+    std::uint8_t headerType;  // Always 0x01 for short headers
+
+    // Sunshine extension
+    // Frame processing latency, in 1/10 ms units
+    //     zero when the frame is repeated or there is no backend implementation
+    boost::endian::little_uint16_at frame_processing_latency;
+
+    // Currently known values:
+    // 1 = Normal P-frame
+    // 2 = IDR-frame
+    // 4 = P-frame with intra-refresh blocks
+    // 5 = P-frame after reference frame invalidation
+    std::uint8_t frameType;
+
+    // Length of the final packet payload for codecs that cannot handle
+    // zero padding, such as AV1 (Sunshine extension).
+    boost::endian::little_uint16_at lastPayloadLen;
+
+    std::uint8_t unknown[2];
+  };
+
+  static_assert(
+    sizeof(video_short_frame_header_t) == 8,
+    "Short frame header must be 8 bytes");
+
+  struct video_packet_raw_t {
+    uint8_t *
+    payload() {
+      return (uint8_t *) (this + 1);
+    }
+
+    RTP_PACKET rtp;
+    char reserved[4];
+
+    NV_VIDEO_PACKET packet;
+  };
+
+  struct video_packet_enc_prefix_t {
+    std::uint8_t iv[12];  // 12-byte IV is ideal for AES-GCM
+    std::uint32_t frameNumber;
+    std::uint8_t tag[16];
+  };
+
+#pragma pack(pop)
+
+  // There are 2 bits for FEC block count for a maximum of 4 FEC blocks
+  constexpr auto MAX_FEC_BLOCKS = 4;
+
+  /**
+   * @brief An encoded frame with room for the header of each packet, split into FEC blocks.
+   */
+  struct video_fec_blocks_t {
+    std::vector<uint8_t> payload;  ///< The frame header and the frame, with room for a packet header before every packetsize bytes
+    std::array<std::string_view, MAX_FEC_BLOCKS> blocks;
+    std::size_t count;
+    std::size_t blocksize;  ///< The size of a packet, with its headers
+    int fec_percentage;  ///< 0 if the frame is too large for FEC
+  };
+
+  /**
+   * @brief Split an encoded frame into FEC blocks, as it is sent to the client.
+   * @param frame_header The header of the frame, its lastPayloadLen is set here.
+   * @param frame The encoded frame.
+   * @param packetsize The packet size requested by the client.
+   * @param fec_percentage The percentage of parity shards relative to the data shards.
+   * @return The FEC blocks.
+   */
+  video_fec_blocks_t
+  split_video_frame(video_short_frame_header_t &frame_header, std::string_view frame, int packetsize, int fec_percentage);
+
+  /**
+   * @brief Stamp the packet headers of a FEC block and generate its parity shards.
+   * @details Different blocks of a frame can be encoded on different threads at the same time.
+   * @param blocks The FEC blocks of the frame.
+   * @param block_index The FEC block to encode.
+   * @param lowseq The sequence number of the first packet of the block.
+   * @param frame_index The index of the frame.
+   * @param min_parity_shards The minimum number of parity shards.
+   * @param prefixsize The space to reserve before each shard for the encryption header.
+   * @return The shards.
+   */
+  fec::fec_t
+  encode_video_fec_block(const video_fec_blocks_t &blocks, std::size_t block_index, int lowseq, std::uint32_t frame_index, std::size_t min_parity_shards, std::size_t prefixsize);
+
+  /**
+   * @brief Set the headers that depend on the parity shards of a FEC block, before the shards are encrypted.
+   * @param shards The shards of the FEC block.
+   * @param blocks The FEC blocks of the frame.
+   * @param block_index The FEC block of the shards.
+   * @param lowseq The sequence number of the first packet of the block.
+   * @param frame_index The index of the frame.
+   * @param timestamp The RTP timestamp of the frame, in 90 kHz ticks.
+   */
+  void
+  finish_video_fec_block(fec::fec_t &shards, const video_fec_blocks_t &blocks, std::size_t block_index, int lowseq, std::uint32_t frame_index, std::uint32_t timestamp);
+
+  /**
+   * @brief Where the video packets of a session are sent, and the state of the session that sending them updates.
+   */
+  struct video_destination_t {
+    std::uintptr_t sock;
+    boost::asio::ip::udp::endpoint peer;
+    boost::asio::ip::address local_address;
+
+    int min_parity_shards;
+
+    crypto::cipher::gcm_t *cipher;  ///< nullptr if video isn't encrypted
+    std::uint64_t &gcm_iv_counter;  ///< The invocation field of the IV of the next packet
+    int &lowseq;  ///< The sequence number of the next packet
+
+    metrics::session_t &metrics;
+  };
+
+  /**
+   * @brief How a frame was sent, for the flight recorder.
+   */
+  struct video_frame_sent_t {
+    std::size_t shards;
+    int fec_percentage;
+    std::chrono::steady_clock::duration pacing_sleep;
+  };
+
+  /**
+   * @brief Sends encoded frames as video packets, paced to share the link with the previous frames.
+   */
+  class video_sender_t {
+  public:
+    /**
+     * @param timer The timer that paces the packets, it must be valid.
+     * @param epoch The capture time of RTP timestamp 0.
+     */
+    video_sender_t(std::unique_ptr<platf::high_precision_timer> timer, std::chrono::steady_clock::time_point epoch);
+
+    /**
+     * @brief Generate the parity shards of a frame, then encrypt and send the shards in paced batches.
+     * @details The parity shards of the next FEC block are generated while the current one is sent.
+     * @param packet The encoded frame, it gets the timestamp from rate control if it has none.
+     * @param fec_blocks The frame split by split_video_frame().
+     * @param destination The session to send the frame to.
+     * @return How the frame was sent.
+     */
+    video_frame_sent_t
+    send_frame(video::packet_raw_t &packet, const video_fec_blocks_t &fec_blocks, const video_destination_t &destination);
+
+  private:
+    std::unique_ptr<platf::high_precision_timer> timer;
+    std::chrono::steady_clock::time_point epoch;
+    std::chrono::steady_clock::time_point ratecontrol_next_frame_start;
+    crypto::aes_t iv;
+
+    // Generates the parity shards of the next FEC block of a frame while the current one is sent
+    thread_pool_util::ThreadPool fec_worker;
+
+    logging::time_delta_periodic_logger frame_send_batch_latency_logger;
+    logging::time_delta_periodic_logger frame_fec_latency_logger;
+  };
+}  // namespace stream
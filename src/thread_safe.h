@@ -7,6 +7,7 @@
 #include <array>
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <mutex>
@@ -15,6 +16,11 @@
 #include "utility.h"
 
 namespace safe {
+  /**
+   * @brief Number of elements every queue_t has discarded because nobody popped them in time.
+   */
+  inline std::atomic<std::uint64_t> dropped_elements;
+
   template <class T>
   class event_t {
   public:
@@ -275,6 +281,7 @@ namespace safe {
       }
 
       if (_queue.size() == _max_elements) {
+        dropped_elements.fetch_add(_queue.size(), std::memory_order_relaxed);
         _queue.clear();
       }
 
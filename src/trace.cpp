@@ -0,0 +1,255 @@
+/**
+ * @file src/trace.cpp
+ * @brief Definitions for tracing the stages of the streaming pipeline.
+ */
+#include "trace.h"
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace trace {
+  std::atomic_bool recording;
+
+  namespace {
+    // Tens of seconds even for the video broadcast thread, which records a few dozen stages per frame
+    constexpr std::size_t ring_size = 65536;
+
+    /**
+     * Every field is atomic, so the exporter can read a slot while its thread overwrites it.
+     * Torn events are detected with the head of the ring and dropped.
+     */
+    struct event_t {
+      std::atomic<const char *> name;
+      std::atomic<std::int64_t> frame;
+      std::atomic<std::int64_t> begin;
+      std::atomic<std::int64_t> end;
+
+      // The thread that ran a deferred stage, 0 for the thread owning the ring
+      std::atomic<std::uint64_t> thread;
+    };
+
+    struct ring_t {
+      std::array<event_t, ring_size> events;
+
+      // Number of events ever written, only the thread owning the ring writes to it
+      std::atomic<std::uint64_t> head {};
+
+      std::uint64_t tid {};
+      std::atomic_bool exited {};
+
+      // Guarded by rings_mutex
+      std::string name;
+    };
+
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<ring_t>> rings;
+    std::uint64_t next_tid = 1;
+
+    // Events older than this are left out of exports
+    std::atomic<std::int64_t> start_time;
+
+    struct thread_ring_t {
+      ~thread_ring_t() {
+        if (ring) {
+          ring->exited = true;
+        }
+      }
+
+      std::shared_ptr<ring_t> ring;
+      std::string name;
+    };
+
+    thread_local thread_ring_t thread_ring;
+
+    std::int64_t
+    to_ns(clock::time_point time) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+
+    /**
+     * Rings are only allocated for threads that record while a trace is being recorded.
+     */
+    ring_t &
+    current_ring() {
+      if (!thread_ring.ring) {
+        auto ring = std::make_shared<ring_t>();
+
+        std::lock_guard lg { rings_mutex };
+        ring->tid = next_tid++;
+        ring->name = thread_ring.name.empty() ? "thread " + std::to_string(ring->tid) : thread_ring.name;
+        rings.emplace_back(ring);
+
+        thread_ring.ring = std::move(ring);
+      }
+
+      return *thread_ring.ring;
+    }
+
+    struct snapshot_t {
+      const char *name;
+      std::int64_t frame;
+      std::int64_t begin;
+      std::int64_t end;
+      std::uint64_t thread;
+    };
+
+    void
+    write_event(const char *name, std::int64_t frame, clock::time_point begin, clock::time_point end, std::uint64_t thread) {
+      auto &ring = current_ring();
+      auto head = ring.head.load(std::memory_order_relaxed);
+      auto &event = ring.events[head % ring_size];
+
+      // Readers that see any part of this event also see that the event it replaces is gone
+      std::atomic_thread_fence(std::memory_order_release);
+      event.name.store(name, std::memory_order_relaxed);
+      event.frame.store(frame, std::memory_order_relaxed);
+      event.begin.store(to_ns(begin), std::memory_order_relaxed);
+      event.end.store(to_ns(end), std::memory_order_relaxed);
+      event.thread.store(thread, std::memory_order_relaxed);
+
+      ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    std::vector<snapshot_t>
+    read_ring(const ring_t &ring) {
+      auto head = ring.head.load(std::memory_order_acquire);
+      auto first = head > ring_size ? head - ring_size : 0;
+
+      std::vector<snapshot_t> events;
+      events.reserve(head - first);
+      for (auto x = first; x < head; ++x) {
+        auto &event = ring.events[x % ring_size];
+        events.push_back({
+          event.name.load(std::memory_order_relaxed),
+          event.frame.load(std::memory_order_relaxed),
+          event.begin.load(std::memory_order_relaxed),
+          event.end.load(std::memory_order_relaxed),
+          event.thread.load(std::memory_order_relaxed),
+        });
+      }
+
+      // Pairs with the fence in record(), anything a newer event overwrote is below the head read here
+      std::atomic_thread_fence(std::memory_order_acquire);
+      auto new_head = ring.head.load(std::memory_order_relaxed);
+
+      // The slot of the event being written right now is unreliable too
+      auto valid_from = new_head + 1 > ring_size ? new_head + 1 - ring_size : 0;
+      if (valid_from > first) {
+        events.erase(events.begin(), events.begin() + std::min<std::size_t>(valid_from - first, events.size()));
+      }
+
+      return events;
+    }
+  }  // namespace
+
+  void
+  start() {
+    std::lock_guard lg { rings_mutex };
+
+    // The rings of threads that are gone only hold events from before this trace
+    std::erase_if(rings, [](const std::shared_ptr<ring_t> &ring) {
+      return ring->exited.load();
+    });
+
+    start_time = to_ns(clock::now());
+    recording = true;
+  }
+
+  void
+  stop() {
+    recording = false;
+  }
+
+  void
+  record(const char *name, std::int64_t frame, clock::time_point begin, clock::time_point end) {
+    // The trace started while the stage ran
+    if (!active() || begin == clock::time_point {}) {
+      return;
+    }
+
+    write_event(name, frame, begin, end, 0);
+  }
+
+  deferred_t
+  defer(const char *name, clock::time_point begin, clock::time_point end) {
+    if (!active() || begin == clock::time_point {}) {
+      return {};
+    }
+
+    return { name, current_ring().tid, begin, end };
+  }
+
+  void
+  record(const deferred_t &stage, std::int64_t frame) {
+    if (!active() || !stage.name) {
+      return;
+    }
+
+    write_event(stage.name, frame, stage.begin, stage.end, stage.thread);
+  }
+
+  void
+  name_thread(std::string name) {
+    std::lock_guard lg { rings_mutex };
+    if (thread_ring.ring) {
+      thread_ring.ring->name = name;
+    }
+    thread_ring.name = std::move(name);
+  }
+
+  std::string
+  export_chrome_json() {
+    std::vector<std::pair<std::shared_ptr<ring_t>, std::string>> threads;
+    {
+      std::lock_guard lg { rings_mutex };
+      for (auto &ring : rings) {
+        threads.emplace_back(ring, ring->name);
+      }
+    }
+
+    auto since = start_time.load();
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+
+    bool first = true;
+    auto separate = [&]() {
+      if (!first) {
+        out << ',';
+      }
+      first = false;
+    };
+
+    for (auto &[ring, name] : threads) {
+      separate();
+      out << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << ring->tid << R"(,"args":{"name":)"
+          << nlohmann::json(name).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) << R"(}})";
+
+      for (auto &event : read_ring(*ring)) {
+        if (event.begin < since) {
+          continue;
+        }
+
+        // Timestamps are in microseconds
+        separate();
+        out << R"({"name":")" << event.name << R"(","ph":"X","pid":1,"tid":)" << (event.thread ? event.thread : ring->tid)
+            << R"(,"ts":)" << (event.begin - since) / 1000.0 << R"(,"dur":)" << (event.end - event.begin) / 1000.0;
+        if (event.frame >= 0) {
+          out << R"(,"args":{"frame":)" << event.frame << '}';
+        }
+        out << '}';
+      }
+    }
+
+    out << "]}";
+    return out.str();
+  }
+}  // namespace trace
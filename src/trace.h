@@ -0,0 +1,128 @@
+/**
+ * @file src/trace.h
+ * @brief Declarations for tracing the stages of the streaming pipeline.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace trace {
+  using clock = std::chrono::steady_clock;
+
+  extern std::atomic_bool recording;
+
+  /**
+   * @brief Check whether a trace is being recorded.
+   * @details Stages check this first, so tracing costs a single load while it's off.
+   */
+  inline bool
+  active() {
+    return recording.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Get the time for the beginning or end of a stage.
+   * @return The current time, or a default time point while no trace is being recorded, record() ignores these.
+   */
+  inline clock::time_point
+  now() {
+    return active() ? clock::now() : clock::time_point {};
+  }
+
+  /**
+   * @brief A stage whose frame isn't known yet on the thread that ran it, e.g. capturing an image that is encoded later.
+   */
+  struct deferred_t {
+    const char *name {};
+    std::uint64_t thread {};
+    clock::time_point begin;
+    clock::time_point end;
+  };
+
+  /**
+   * @brief Discard the events recorded so far and record new ones.
+   */
+  void
+  start();
+
+  /**
+   * @brief Stop recording, the events recorded so far can still be exported.
+   */
+  void
+  stop();
+
+  /**
+   * @brief Record a stage of the pipeline that ran on this thread.
+   * @details Each thread writes into a ring buffer of its own without locking.
+   * When the ring is full, the oldest events of the thread are overwritten.
+   * @param name Name of the stage, must be a string literal.
+   * @param frame Index of the frame the stage worked on, or -1.
+   * @param begin When the stage started, the stage is left out if it's a default time point.
+   * @param end When the stage ended.
+   */
+  void
+  record(const char *name, std::int64_t frame, clock::time_point begin, clock::time_point end);
+
+  /**
+   * @brief Remember a stage that ran on this thread, to record it once its frame is known.
+   * @param name Name of the stage, must be a string literal.
+   * @param begin When the stage started.
+   * @param end When the stage ended.
+   * @return The stage, or an empty one that record() ignores if no trace is being recorded.
+   */
+  deferred_t
+  defer(const char *name, clock::time_point begin, clock::time_point end);
+
+  /**
+   * @brief Record a deferred stage, it's shown on the thread that ran it.
+   * @param stage The stage.
+   * @param frame Index of the frame the stage worked on.
+   */
+  void
+  record(const deferred_t &stage, std::int64_t frame);
+
+  /**
+   * @brief Name the calling thread in exported traces.
+   */
+  void
+  name_thread(std::string name);
+
+  /**
+   * @brief Export the recorded events.
+   * @return The events in the Chrome trace event JSON format, which chrome://tracing and Perfetto open.
+   */
+  std::string
+  export_chrome_json();
+
+  /**
+   * @brief Records the lifetime of the scope as a stage, if a trace is being recorded when it begins.
+   */
+  class scope_t {
+  public:
+    explicit scope_t(const char *name, std::int64_t frame = -1):
+        name { name },
+        frame { frame } {
+      if (active()) {
+        begin = clock::now();
+      }
+    }
+
+    ~scope_t() {
+      if (begin != clock::time_point {}) {
+        record(name, frame, begin, clock::now());
+      }
+    }
+
+    scope_t(const scope_t &) = delete;
+    scope_t &
+    operator=(const scope_t &) = delete;
+
+  private:
+    const char *name;
+    std::int64_t frame;
+    clock::time_point begin;
+  };
+}  // namespace trace
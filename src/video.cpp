@@ -5,7 +5,11 @@
 // standard includes
 #include <atomic>
 #include <bitset>
+#include <fstream>
+#include <future>
 #include <list>
+#include <map>
+#include <sstream>
 #include <thread>
 
 #include <boost/pointer_cast.hpp>
@@ -21,13 +25,19 @@ extern "C" {
 #include "cbs.h"
 #include "config.h"
 #include "display_device/display_device.h"
+#include "encoder_probe_cache.h"
+#include "frame_fingerprint.h"
 #include "globals.h"
 #include "input.h"
 #include "logging.h"
+#include "metrics.h"
 #include "nvenc/nvenc_encoder.h"
 #include "platform/common.h"
 #include "sync.h"
+#include "trace.h"
+#include "version.h"
 #include "video.h"
+#include "video_convert.h"
 
 #ifdef _WIN32
 extern "C" {
@@ -69,6 +79,36 @@ namespace video {
       BOOST_LOG(error) << "No display devices are active at the moment! Cannot probe the encoders.";
       return false;
     }
+
+    std::filesystem::path
+    probe_cache_file() {
+      return platf::appdata() / "encoder_probe_cache.json";
+    }
+
+    /**
+     * @brief Identify everything the outcome of encoder probing depends on.
+     * @return The key for the probe cache, or `std::nullopt` if the GPUs can't be identified.
+     */
+    std::optional<std::string>
+    probe_cache_key() {
+      auto gpus = platf::gpu_identity();
+      if (gpus.empty()) {
+        return std::nullopt;
+      }
+
+      // Encoder options are part of the configuration file, so any change to it invalidates the cache
+      std::ifstream config_file { config::sunshine.config_file, std::ios::binary };
+      std::string config_contents { std::istreambuf_iterator<char> { config_file }, std::istreambuf_iterator<char> {} };
+
+      std::stringstream key;
+      key << PROJECT_VER << '|'
+          << av_version_info() << '|'
+          << gpus << '|'
+          << display_device::get_display_name(config::video.output_name) << '|'
+          << std::hash<std::string> {}(config_contents);
+
+      return key.str();
+    }
   }  // namespace
 
   void
@@ -134,36 +174,23 @@ namespace video {
   public:
     int
     convert(platf::img_t &img) override {
-      // If we need to add aspect ratio padding, we need to scale into an intermediate output buffer
-      bool requires_padding = (sw_frame->width != sws_output_frame->width || sw_frame->height != sws_output_frame->height);
+      // Write straight into the letterboxed region, the padding around it was filled once by prefill()
+      std::uint8_t *data[4];
+      int linesize[4];
+      letterbox_planes(pending_frame ? pending_frame.get() : sw_frame.get(), data, linesize);
 
-      // Setup the input frame using the caller's img_t
-      sws_input_frame->data[0] = img.data;
-      sws_input_frame->linesize[0] = img.row_pitch;
-
-      // Perform color conversion and scaling to the final size
-      auto status = sws_scale_frame(sws.get(), requires_padding ? sws_output_frame.get() : sw_frame.get(), sws_input_frame.get());
-      if (status < 0) {
-        char string[AV_ERROR_MAX_STRING_SIZE];
-        BOOST_LOG(error) << "Couldn't scale frame: "sv << av_make_error_string(string, AV_ERROR_MAX_STRING_SIZE, status);
-        return -1;
+      if (converter) {
+        converter->convert(img.data, img.row_pitch, sws_output_frame->width, sws_output_frame->height, data, linesize);
       }
+      else {
+        const std::uint8_t *src_data[] { img.data };
+        const int src_linesize[] { img.row_pitch };
 
-      // If we require aspect ratio padding, copy the output frame into the final padded frame
-      if (requires_padding) {
-        auto fmt_desc = av_pix_fmt_desc_get((AVPixelFormat) sws_output_frame->format);
-        auto planes = av_pix_fmt_count_planes((AVPixelFormat) sws_output_frame->format);
-        for (int plane = 0; plane < planes; plane++) {
-          auto shift_h = plane == 0 ? 0 : fmt_desc->log2_chroma_h;
-          auto shift_w = plane == 0 ? 0 : fmt_desc->log2_chroma_w;
-          auto offset = ((offsetW >> shift_w) * fmt_desc->comp[plane].step) + (offsetH >> shift_h) * sw_frame->linesize[plane];
-
-          // Copy line-by-line to preserve leading padding for each row
-          for (int line = 0; line < sws_output_frame->height >> shift_h; line++) {
-            memcpy(sw_frame->data[plane] + offset + (line * sw_frame->linesize[plane]),
-              sws_output_frame->data[plane] + (line * sws_output_frame->linesize[plane]),
-              (size_t) (sws_output_frame->width >> shift_w) * fmt_desc->comp[plane].step);
-          }
+        auto status = sws_scale(sws.get(), src_data, src_linesize, 0, sws_input_frame->height, data, linesize);
+        if (status < 0) {
+          char string[AV_ERROR_MAX_STRING_SIZE];
+          BOOST_LOG(error) << "Couldn't scale frame: "sv << av_make_error_string(string, AV_ERROR_MAX_STRING_SIZE, status);
+          return -1;
         }
       }
 
@@ -181,6 +208,76 @@ namespace video {
       return 0;
     }
 
+    /**
+     * @brief Get the planes of the region of the frame that receives the image.
+     */
+    void
+    letterbox_planes(AVFrame *frame, std::uint8_t **data, int *linesize) {
+      auto fmt_desc = av_pix_fmt_desc_get((AVPixelFormat) frame->format);
+      auto planes = av_pix_fmt_count_planes((AVPixelFormat) frame->format);
+      for (int plane = 0; plane < 4; plane++) {
+        if (plane >= planes) {
+          data[plane] = nullptr;
+          linesize[plane] = 0;
+          continue;
+        }
+
+        auto shift_h = plane == 0 ? 0 : fmt_desc->log2_chroma_h;
+        auto shift_w = plane == 0 ? 0 : fmt_desc->log2_chroma_w;
+        auto offset = ((offsetW >> shift_w) * fmt_desc->comp[plane].step) + (offsetH >> shift_h) * frame->linesize[plane];
+
+        data[plane] = frame->data[plane] + offset;
+        linesize[plane] = frame->linesize[plane];
+      }
+    }
+
+    /**
+     * @brief Let convert() fill a second frame, so the next image can be converted while the current frame is encoded.
+     * @return 0 on success, -1 if the device can't be pipelined.
+     */
+    int
+    enable_pipelining() {
+      // The transfer to the hardware frame must happen on the encoding thread
+      if (!frame || frame->hw_frames_ctx) {
+        return -1;
+      }
+
+      pending_frame.reset(av_frame_alloc());
+      pending_frame->format = sw_frame->format;
+      pending_frame->width = sw_frame->width;
+      pending_frame->height = sw_frame->height;
+
+      if (av_frame_copy_props(pending_frame.get(), sw_frame.get()) < 0) {
+        pending_frame.reset();
+        return -1;
+      }
+
+      prefill(pending_frame.get());
+
+      return 0;
+    }
+
+    /**
+     * @brief Let convert() fill the frame that gets encoded again.
+     */
+    void
+    disable_pipelining() {
+      pending_frame.reset();
+    }
+
+    /**
+     * @brief Make the frame filled by the last call to convert() the one that gets encoded.
+     */
+    void
+    present_pending_frame() {
+      // Keep a pending IDR request
+      pending_frame->pict_type = frame->pict_type;
+      pending_frame->flags = (pending_frame->flags & ~AV_FRAME_FLAG_KEY) | (frame->flags & AV_FRAME_FLAG_KEY);
+
+      std::swap(sw_frame, pending_frame);
+      frame = sw_frame.get();
+    }
+
     int
     set_frame(AVFrame *frame, AVBufferRef *hw_frames_ctx) override {
       this->frame = frame;
@@ -200,6 +297,11 @@ namespace video {
 
     void
     apply_colorspace() override {
+      if (converter) {
+        converter->set_colorspace(colorspace);
+        return;
+      }
+
       auto avcodec_colorspace = avcodec_colorspace_from_sunshine_colorspace(colorspace);
       sws_setColorspaceDetails(sws.get(),
         sws_getCoefficients(SWS_CS_DEFAULT), 0,
@@ -211,8 +313,7 @@ namespace video {
      * When preserving aspect ratio, ensure that padding is black
      */
     void
-    prefill() {
-      auto frame = sw_frame ? sw_frame.get() : this->frame;
+    prefill(AVFrame *frame) {
       av_frame_get_buffer(frame, 0);
       av_frame_make_writable(frame);
       ptrdiff_t linesize[4] = { frame->linesize[0], frame->linesize[1], frame->linesize[2], frame->linesize[3] };
@@ -234,7 +335,7 @@ namespace video {
       }
 
       // Fill aspect ratio padding in the destination frame
-      prefill();
+      prefill(sw_frame ? sw_frame.get() : this->frame);
 
       auto out_width = frame->width;
       auto out_height = frame->height;
@@ -258,6 +359,14 @@ namespace video {
       offsetW = (frame->width - out_width) / 2;
       offsetH = (frame->height - out_height) / 2;
 
+      // Without scaling, the colorspace conversion doesn't need swscale
+      if (in_width == out_width && in_height == out_height) {
+        converter = bgr0_converter_t::make(format, config::video.min_threads);
+        if (converter) {
+          return 0;
+        }
+      }
+
       sws.reset(sws_alloc_context());
       if (!sws) {
         return -1;
@@ -295,9 +404,15 @@ namespace video {
     avcodec_frame_t hw_frame;
 
     avcodec_frame_t sw_frame;
+
+    // Receives the next image while sw_frame is being encoded, if pipelining is enabled
+    avcodec_frame_t pending_frame;
+
+    // Only describe the dimensions, the image is converted straight into sw_frame
     avcodec_frame_t sws_input_frame;
     avcodec_frame_t sws_output_frame;
     sws_t sws;
+    std::unique_ptr<bgr0_converter_t> converter;
 
     // Offset of input image to output frame in pixels
     int offsetW;
@@ -317,6 +432,8 @@ namespace video {
     ALWAYS_REPROBE = 1 << 9,  ///< This is an encoder of last resort and we want to aggressively probe for a better one
     YUV444_SUPPORT = 1 << 10,  ///< Encoder may support 4:4:4 chroma sampling depending on hardware
     ASYNC_TEARDOWN = 1 << 11,  ///< Encoder supports async teardown on a different thread
+    REUSABLE_SESSION = 1 << 12,  ///< Encode sessions can be kept warm for another stream of the same display
+    INTRA_REFRESH_RFI = 1 << 13,  ///< Recovers from reference frames invalidation with intra refresh, if the encoder of each codec has it
   };
 
   class avcodec_encode_session_t: public encode_session_t {
@@ -348,6 +465,12 @@ namespace video {
       vps = std::move(other.vps);
 
       inject = other.inject;
+      pts_base = other.pts_base;
+      last_pts = other.last_pts;
+      dynamic_params_changed = other.dynamic_params_changed;
+      intra_refresh_period = other.intra_refresh_period;
+      last_refresh_recovery = other.last_refresh_recovery;
+      after_ref_frame_invalidation = other.after_ref_frame_invalidation;
 
       return *this;
     }
@@ -378,13 +501,39 @@ namespace video {
 
     void
     invalidate_ref_frames(int64_t first_frame, int64_t last_frame) override {
-      BOOST_LOG(error) << "Encoder doesn't support reference frame invalidation";
+      // libavcodec can't tell libx264/libx265 to stop referencing the lost frames, but with intra refresh
+      // the following frames are decodable with artifacts that the refresh wave repairs
+      if (recover_with_intra_refresh(last_frame)) {
+        BOOST_LOG(debug) << "Recovering from invalidated frames "sv << first_frame << '-' << last_frame << " with intra refresh"sv;
+        after_ref_frame_invalidation = true;
+        return;
+      }
+
+      BOOST_LOG(debug) << "Encoder can't invalidate reference frames without intra refresh, generating IDR"sv;
       request_idr_frame();
     }
 
+    bool
+    recover_with_intra_refresh(int64_t frame_nr) override {
+      if (!intra_refresh_period) {
+        return false;
+      }
+
+      // The client asking again before two refresh waves went by means the refresh didn't repair its picture
+      if (last_refresh_recovery && frame_nr - *last_refresh_recovery <= intra_refresh_period * 2) {
+        last_refresh_recovery.reset();
+        return false;
+      }
+
+      last_refresh_recovery = frame_nr;
+      return true;
+    }
+
     void
     set_bitrate(int bitrate_kbps) override {
       if (avcodec_ctx) {
+        dynamic_params_changed = true;
+
         // 考虑FEC影响，调整编码码率
         // 当FEC百分比为X%时，实际编码码率需要调整为原始码率的(100-X)%
         auto adjusted_bitrate_kbps = bitrate_kbps;
@@ -407,6 +556,8 @@ namespace video {
     set_dynamic_param(const dynamic_param_t &param) override {
       if (!avcodec_ctx) return;
 
+      dynamic_params_changed = true;
+
       switch (param.type) {
         case dynamic_param_type_e::BITRATE: {
           // 码率调整通过set_bitrate处理
@@ -448,6 +599,21 @@ namespace video {
 
     // inject sps/vps data into idr pictures
     int inject;
+
+    // Timestamps must keep increasing when the session is reused for another stream,
+    // whose frame numbers start over. Packets are stamped with the frame numbers again.
+    int64_t pts_base = 0;
+    int64_t last_pts = 0;
+
+    // The encoder no longer matches the config it was created with
+    bool dynamic_params_changed = false;
+
+    // Number of frames a refresh wave takes to cover the picture, 0 if intra refresh is disabled
+    int intra_refresh_period = 0;
+    std::optional<int64_t> last_refresh_recovery;
+
+    // The next packet tells the client to resume decoding after its reference frame invalidation
+    bool after_ref_frame_invalidation = false;
   };
 
   class nvenc_encode_session_t: public encode_session_t {
@@ -562,9 +728,77 @@ namespace video {
     void *channel_data;
   };
 
+  /**
+   * @brief Runs jobs for a synced session on a thread of its own, one at a time.
+   */
+  class sync_encode_worker_t {
+  public:
+    sync_encode_worker_t():
+        thread { &sync_encode_worker_t::run, this } {}
+
+    ~sync_encode_worker_t() {
+      {
+        std::lock_guard lock { mutex };
+        stop = true;
+      }
+      cv.notify_all();
+
+      thread.join();
+    }
+
+    void
+    post(std::function<void()> &&job) {
+      {
+        std::lock_guard lock { mutex };
+        this->job = std::move(job);
+      }
+      cv.notify_all();
+    }
+
+    /**
+     * @brief Wait for the posted job to complete.
+     */
+    void
+    wait() {
+      std::unique_lock lock { mutex };
+      cv.wait(lock, [this]() { return !job; });
+    }
+
+  private:
+    void
+    run() {
+      std::unique_lock lock { mutex };
+      while (true) {
+        cv.wait(lock, [this]() { return stop || job; });
+        if (stop) {
+          return;
+        }
+
+        lock.unlock();
+        job();
+        lock.lock();
+
+        job = nullptr;
+        cv.notify_all();
+      }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::function<void()> job;
+    bool stop = false;
+
+    std::thread thread;
+  };
+
   struct sync_session_t {
     sync_session_ctx_t *ctx;
     std::unique_ptr<encode_session_t> session;
+
+    // Encodes this session alongside the others, created once more than one session shares the capture
+    std::unique_ptr<sync_encode_worker_t> worker;
+
+    logging::time_delta_periodic_logger encode_logger { debug, "Synced session encode" };
   };
 
   using encode_session_ctx_queue_t = safe::queue_t<sync_session_ctx_t>;
@@ -1002,7 +1236,7 @@ namespace video {
       {},  // Fallback options
       "libx264"s,
     },
-    H264_ONLY | PARALLEL_ENCODING | ALWAYS_REPROBE | YUV444_SUPPORT
+    H264_ONLY | PARALLEL_ENCODING | INTRA_REFRESH_RFI | ALWAYS_REPROBE | YUV444_SUPPORT | REUSABLE_SESSION
   };
 
 #ifdef __linux__
@@ -1056,7 +1290,7 @@ namespace video {
       "h264_vaapi"s,
     },
     // RC buffer size will be set in platform code if supported
-    LIMITED_GOP_SIZE | PARALLEL_ENCODING | NO_RC_BUF_LIMIT
+    LIMITED_GOP_SIZE | PARALLEL_ENCODING | NO_RC_BUF_LIMIT | REUSABLE_SESSION
   };
 #endif
 
@@ -1142,17 +1376,59 @@ namespace video {
   };
 
   static encoder_t *chosen_encoder;
+
+  // The encoder that was chosen from the probe cache, until it fails to open
+  static std::atomic<const encoder_t *> cached_probe_encoder;
+
+  // Set once the cached encoder failed, so the next probe runs even though an encoder was chosen
+  static std::atomic_bool reprobe_requested;
+
+  /**
+   * @brief Drop the cached probe result if it chose an encoder that fails to open.
+   * @param encoder The encoder that failed.
+   */
+  static void
+  invalidate_cached_probe(const encoder_t &encoder) {
+    const encoder_t *expected = &encoder;
+    if (!cached_probe_encoder.compare_exchange_strong(expected, nullptr)) {
+      return;
+    }
+
+    BOOST_LOG(warning) << "Cached encoder ["sv << encoder.name << "] failed to open, encoders will be probed again"sv;
+    probe_cache::invalidate(probe_cache_file());
+    reprobe_requested = true;
+  }
+
   int active_hevc_mode;
   int active_av1_mode;
   bool last_encoder_probe_supported_ref_frames_invalidation = false;
   std::array<bool, 3> last_encoder_probe_supported_yuv444_for_codec = {};
 
+  // Replaces the capture backends of the platform when set
+  static display_factory_t display_factory;
+  static std::vector<std::string> display_factory_names;
+
+  void
+  override_displays(display_factory_t factory, std::vector<std::string> display_names) {
+    display_factory = std::move(factory);
+    display_factory_names = std::move(display_names);
+  }
+
+  std::shared_ptr<platf::display_t>
+  make_display(platf::mem_type_e type, const std::string &display_name, const config_t &config) {
+    if (display_factory) {
+      return display_factory(type, display_name, config);
+    }
+
+    return platf::display(type, display_name, config);
+  }
+
   void
   reset_display(std::shared_ptr<platf::display_t> &disp, const platf::mem_type_e &type, const std::string &display_name, const config_t &config) {
     // We try this twice, in case we still get an error on reinitialization
     for (int x = 0; x < 2; ++x) {
       disp.reset();
-      disp = platf::display(type, display_name, config);
+      disp = make_display(type, display_name, config);
       if (disp) {
         BOOST_LOG(debug) << "[reset_display] 成功重置显示器: " << display_name;
         break;
@@ -1183,7 +1459,7 @@ namespace video {
 
     // Refresh the display names
     auto old_display_names = std::move(display_names);
-    display_names = platf::display_names(dev_type);
+    display_names = display_factory ? display_factory_names : platf::display_names(dev_type);
 
     // If we now have no displays, let's put the old display array back and fail
     if (display_names.empty() && !old_display_names.empty()) {
@@ -1228,6 +1504,8 @@ namespace video {
     const encoder_t &encoder) {
     std::vector<capture_ctx_t> capture_ctxs;
 
+    trace::name_thread("capture");
+
     auto fg = util::fail_guard([&]() {
       capture_ctx_queue->stop();
 
@@ -1254,7 +1532,7 @@ namespace video {
     std::vector<std::string> display_names;
     int display_p = -1;
     refresh_displays(encoder.platform_formats->dev_type, display_names, display_p);
-    auto disp = platf::display(encoder.platform_formats->dev_type, display_names[display_p], capture_ctxs.front().config);
+    auto disp = make_display(encoder.platform_formats->dev_type, display_names[display_p], capture_ctxs.front().config);
     if (!disp) {
       return;
     }
@@ -1311,6 +1589,9 @@ namespace video {
       }
     };
 
+    // The backend starts capturing a frame once it has an image to capture it into
+    trace::clock::time_point capture_begin;
+
     auto pull_free_image_callback = [&](std::shared_ptr<platf::img_t> &img_out) -> bool {
       img_out.reset();
       while (capture_ctx_queue->running()) {
@@ -1346,6 +1627,8 @@ namespace video {
           // trim allocated but unused portion of the pool based on timeouts
           trim_imgs();
           img_out->frame_timestamp.reset();
+          img_out->damage.clear();
+          capture_begin = trace::now();
           return true;
         }
         else {
@@ -1363,6 +1646,11 @@ namespace video {
       bool artificial_reinit = false;
 
       auto push_captured_image_callback = [&](std::shared_ptr<platf::img_t> &&img, bool frame_captured) -> bool {
+        if (frame_captured) {
+          img->capture_trace = trace::defer("capture", capture_begin, trace::now());
+          metrics::global.frames_captured.add();
+        }
+
         KITTY_WHILE_LOOP(auto capture_ctx = std::begin(capture_ctxs), capture_ctx != std::end(capture_ctxs), {
           if (!capture_ctx->images->running()) {
             capture_ctx = capture_ctxs.erase(capture_ctx);
@@ -1477,7 +1765,8 @@ namespace video {
   int
   encode_avcodec(int64_t frame_nr, avcodec_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
     auto &frame = session.device->frame;
-    frame->pts = frame_nr;
+    frame->pts = session.pts_base + frame_nr;
+    session.last_pts = frame->pts;
 
     auto &ctx = session.avcodec_ctx;
 
@@ -1485,7 +1774,9 @@ namespace video {
     auto &vps = session.vps;
 
     // send the frame to the encoder
+    auto send_begin = trace::now();
     auto ret = avcodec_send_frame(ctx.get(), frame);
+    trace::record("encode submit", frame_nr, send_begin, trace::now());
     if (ret < 0) {
       char err_str[AV_ERROR_MAX_STRING_SIZE] { 0 };
       BOOST_LOG(error) << "Could not send a frame for encoding: "sv << av_make_error_string(err_str, AV_ERROR_MAX_STRING_SIZE, ret);
@@ -1497,7 +1788,9 @@ namespace video {
       auto packet = std::make_unique<packet_raw_avcodec>();
       auto av_packet = packet.get()->av_packet;
 
+      auto receive_begin = trace::now();
       ret = avcodec_receive_packet(ctx.get(), av_packet);
+      trace::record("encode receive", frame_nr, receive_begin, trace::now());
       if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
         return 0;
       }
@@ -1505,6 +1798,11 @@ namespace video {
         return ret;
       }
 
+      av_packet->pts -= session.pts_base;
+      if (av_packet->dts != AV_NOPTS_VALUE) {
+        av_packet->dts -= session.pts_base;
+      }
+
       if (av_packet->flags & AV_PKT_FLAG_KEY) {
         BOOST_LOG(debug) << "Frame "sv << frame_nr << ": IDR Keyframe (AV_FRAME_FLAG_KEY)"sv;
       }
@@ -1541,8 +1839,11 @@ namespace video {
         packet->frame_timestamp = frame_timestamp;
       }
 
+      packet->after_ref_frame_invalidation = std::exchange(session.after_ref_frame_invalidation, false);
       packet->replacements = &session.replacements;
+      packet->encode_duration = std::chrono::steady_clock::now() - send_begin;
       packet->channel_data = channel_data;
+      metrics::global.frames_encoded.add();
       packets->raise(std::move(packet));
     }
 
@@ -1551,7 +1852,9 @@ namespace video {
 
   int
   encode_nvenc(int64_t frame_nr, nvenc_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+    auto encode_begin = trace::now();
     auto encoded_frame = session.encode_frame(frame_nr);
+    trace::record("encode", frame_nr, encode_begin, trace::now());
     if (encoded_frame.data.empty()) {
       BOOST_LOG(error) << "NvENC returned empty packet";
       return -1;
@@ -1563,8 +1866,10 @@ namespace video {
 
     auto packet = std::make_unique<packet_raw_generic>(std::move(encoded_frame.data), encoded_frame.frame_index, encoded_frame.idr);
     packet->channel_data = channel_data;
+    packet->encode_duration = std::chrono::steady_clock::now() - encode_begin;
     packet->after_ref_frame_invalidation = encoded_frame.after_ref_frame_invalidation;
     packet->frame_timestamp = frame_timestamp;
+    metrics::global.frames_encoded.add();
     packets->raise(std::move(packet));
 
     return 0;
@@ -1627,6 +1932,7 @@ namespace video {
     // fallback options, we may need to allow more retries
     // to try applying each set.
     avcodec_ctx_t ctx;
+    int intra_refresh_period = 0;
     for (int retries = 0; retries < 2; retries++) {
       ctx.reset(avcodec_alloc_context3(codec));
       ctx->width = config.width;
@@ -1815,6 +2121,28 @@ namespace video {
         }
       }
 
+      // Clients that negotiated intra refresh get a wave of intra blocks moving across
+      // the picture instead of large IDR frames, which would need extra FEC blocks
+      intra_refresh_period = 0;
+      if (!hardware && config.enableIntraRefresh == 1) {
+        if (video_format.name == "libx264") {
+          // x264 takes the length of a refresh wave from keyint and stops inserting IDR frames
+          intra_refresh_period = config.framerate;
+          ctx->gop_size = intra_refresh_period;
+          av_dict_set_int(&options, "intra-refresh", 1, 0);
+        }
+        else if (video_format.name == "libx265") {
+          // x265 applies its parameters in order, so this keyint replaces the infinite one
+          intra_refresh_period = config.framerate;
+          auto x265_params = av_dict_get(options, "x265-params", nullptr, 0);
+          auto params = (x265_params ? x265_params->value + ":"s : ""s) + "intra-refresh=1:keyint="s + std::to_string(intra_refresh_period);
+          av_dict_set(&options, "x265-params", params.c_str(), 0);
+        }
+        else {
+          BOOST_LOG(warning) << video_format.name << ": client asked for intra-refresh but the encoder does not support it"sv;
+        }
+      }
+
       auto bitrate = ((config::video.max_bitrate > 0) ? std::min(config.bitrate, config::video.max_bitrate) : config.bitrate) * 1000;
       BOOST_LOG(info) << "Streaming bitrate is " << bitrate;
       ctx->rc_max_rate = bitrate;
@@ -1951,6 +2279,11 @@ namespace video {
       // 0 ==> don't inject, 1 ==> inject for h264, 2 ==> inject for hevc
       config.videoFormat <= 1 ? (1 - (int) video_format[encoder_t::VUI_PARAMETERS]) * (1 + config.videoFormat) : 0);
 
+    session->intra_refresh_period = intra_refresh_period;
+    if (intra_refresh_period) {
+      BOOST_LOG(info) << video_format.name << ": intra refresh every "sv << intra_refresh_period << " frames"sv;
+    }
+
     return session;
   }
 
@@ -1977,6 +2310,265 @@ namespace video {
     return nullptr;
   }
 
+  /**
+   * @brief Get the device of a session whose frames are converted on the CPU.
+   */
+  avcodec_software_encode_device_t *
+  software_encode_device(encode_session_t &session) {
+    auto avcodec_session = dynamic_cast<avcodec_encode_session_t *>(&session);
+    if (!avcodec_session) {
+      return nullptr;
+    }
+
+    return dynamic_cast<avcodec_software_encode_device_t *>(avcodec_session->device.get());
+  }
+
+  /**
+   * @brief Recognizes captured images that are identical to the previous one.
+   * @details Only images in system memory are fingerprinted, any other image counts as changed.
+   * Damage reported by the capture backend proves a change without hashing the image.
+   */
+  class static_frame_filter_t {
+  public:
+    explicit static_frame_filter_t(bool enabled):
+        enabled { enabled } {}
+
+    bool
+    unchanged(const platf::img_t &img) {
+      if (!enabled || !img.data || !img.damage.empty()) {
+        fingerprint.reset();
+        return false;
+      }
+
+      auto current = frame_fingerprint(img.data, img.row_pitch, img.width * img.pixel_pitch, img.height);
+      auto same = fingerprint == current;
+      fingerprint = current;
+
+      return same;
+    }
+
+    // Number of encodes avoided for unchanged images
+    std::atomic<std::uint64_t> skipped { 0 };
+
+  private:
+    bool enabled;
+    std::optional<std::uint64_t> fingerprint;
+  };
+
+  /**
+   * @brief Converts the next captured image on its own thread while the current frame is being encoded.
+   */
+  class convert_stage_t {
+  public:
+    struct converted_t {
+      std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
+      std::chrono::steady_clock::time_point convert_end;
+      bool error;
+
+      // Recorded by the encode thread, which knows the index of the frame
+      trace::deferred_t capture_trace;
+      trace::deferred_t convert_trace;
+    };
+
+    convert_stage_t(img_event_t images, avcodec_software_encode_device_t &device, static_frame_filter_t &frame_filter, std::chrono::milliseconds poll_interval):
+        images { std::move(images) }, device { device }, frame_filter { frame_filter }, poll_interval { poll_interval } {
+      // The pending frame is free to begin with
+      released.raise(true);
+
+      thread = std::thread { &convert_stage_t::run, this };
+    }
+
+    ~convert_stage_t() {
+      running = false;
+      released.stop();
+      converted.stop();
+
+      thread.join();
+    }
+
+    /**
+     * @brief Wait for the next converted frame and make it the one that gets encoded.
+     */
+    std::optional<converted_t>
+    pop(std::chrono::duration<double, std::milli> timeout) {
+      auto result = converted.pop(timeout);
+      if (!result) {
+        return std::nullopt;
+      }
+
+      if (!result->error) {
+        device.present_pending_frame();
+      }
+
+      // The convert thread may now fill the previously encoded frame
+      released.raise(true);
+
+      return *result;
+    }
+
+    bool
+    peek() {
+      return converted.peek();
+    }
+
+  private:
+    void
+    run() {
+      logging::time_delta_periodic_logger convert_logger { debug, "Pipeline: convert stage" };
+
+      trace::name_thread("convert");
+
+      while (released.pop()) {
+        while (running) {
+          auto img = images->pop(poll_interval);
+          if (!img) {
+            if (!images->running()) {
+              return;
+            }
+
+            continue;
+          }
+
+          // The frame that is already converted has the same content, the encode
+          // thread times out and encodes that one again when the refresh is due
+          if (frame_filter.unchanged(*img)) {
+            ++frame_filter.skipped;
+            continue;
+          }
+
+          convert_logger.first_point_now();
+          auto convert_begin = trace::now();
+          auto status = device.convert(*img);
+          auto convert_trace = trace::defer("convert", convert_begin, trace::now());
+          convert_logger.second_point_now_and_log();
+
+          converted.raise(converted_t { img->frame_timestamp, std::chrono::steady_clock::now(), status != 0, img->capture_trace, convert_trace });
+          break;
+        }
+      }
+    }
+
+    img_event_t images;
+    avcodec_software_encode_device_t &device;
+    static_frame_filter_t &frame_filter;
+    std::chrono::milliseconds poll_interval;
+
+    std::atomic_bool running { true };
+    safe::event_t<bool> released;
+    safe::event_t<converted_t> converted;
+
+    std::thread thread;
+  };
+
+  /**
+   * @brief Keeps the encode sessions of ended streams warm for a while.
+   * @details A client that reconnects with the same configuration gets the session back,
+   * instead of waiting for a new encode device and encoder to be created.
+   */
+  class encode_session_pool_t {
+  public:
+    /**
+     * @brief Identify the sessions that can be reused for a stream.
+     * @details Hardware encode devices are bound to the card and the region of the display they were
+     * created for, so the display, its offset and the adapter are part of the key.
+     */
+    static std::string
+    key(platf::display_t &display, const encoder_t &encoder, const config_t &config) {
+      std::stringstream key;
+      key << encoder.name << ' ' << config::video.adapter_name << ' ' << config::video.capture
+          << ' ' << display_device::get_display_name(config::video.output_name)
+          << ' ' << display.offset_x << ',' << display.offset_y << ' ' << display.env_width << 'x' << display.env_height
+          << ' ' << display.width << 'x' << display.height << (display.is_hdr() ? " hdr"sv : " sdr"sv)
+          << ' ' << config.width << 'x' << config.height << '@' << config.framerate
+          << ' ' << config.bitrate << ' ' << config.slicesPerFrame << ' ' << config.numRefFrames
+          << ' ' << config.encoderCscMode << ' ' << config.videoFormat << ' ' << config.dynamicRange
+          << ' ' << config.chromaSamplingType << ' ' << config.enableIntraRefresh;
+
+      return key.str();
+    }
+
+    /**
+     * @brief Keep a session for `config::video.encoder_keep_warm` seconds.
+     */
+    void
+    put(std::string key, std::unique_ptr<avcodec_encode_session_t> session) {
+      std::chrono::seconds keep_warm { config::video.encoder_keep_warm };
+      if (keep_warm <= 0s) {
+        return;
+      }
+
+      {
+        std::lock_guard lg { mutex };
+
+        // Only the most recent sessions are worth the memory they hold on to
+        if (sessions.size() >= max_sessions) {
+          sessions.erase(std::begin(sessions));
+        }
+
+        sessions.emplace_back(std::move(key), std::move(session), std::chrono::steady_clock::now() + keep_warm);
+      }
+
+      BOOST_LOG(info) << "Keeping the encoder warm for "sv << keep_warm.count() << " seconds"sv;
+      task_pool.pushDelayed([this]() { evict_expired(); }, keep_warm);
+    }
+
+    /**
+     * @brief Take a warm session out of the pool.
+     * @return The session, or nullptr if none matches the key.
+     */
+    std::unique_ptr<avcodec_encode_session_t>
+    take(const std::string &key) {
+      std::lock_guard lg { mutex };
+
+      auto pos = std::find_if(std::begin(sessions), std::end(sessions), [&](const entry_t &entry) {
+        return entry.key == key;
+      });
+      if (pos == std::end(sessions)) {
+        return nullptr;
+      }
+
+      auto session = std::move(pos->session);
+      sessions.erase(pos);
+
+      return session;
+    }
+
+  private:
+    void
+    evict_expired() {
+      std::vector<entry_t> expired;
+      {
+        std::lock_guard lg { mutex };
+
+        auto now = std::chrono::steady_clock::now();
+        auto pos = std::partition(std::begin(sessions), std::end(sessions), [&](const entry_t &entry) {
+          return entry.expiry > now;
+        });
+
+        std::move(pos, std::end(sessions), std::back_inserter(expired));
+        sessions.erase(pos, std::end(sessions));
+      }
+
+      // Tear the encoders down without holding the lock
+      if (!expired.empty()) {
+        BOOST_LOG(debug) << "Releasing "sv << expired.size() << " warm encoder(s)"sv;
+      }
+    }
+
+    struct entry_t {
+      std::string key;
+      std::unique_ptr<avcodec_encode_session_t> session;
+      std::chrono::steady_clock::time_point expiry;
+    };
+
+    static constexpr std::size_t max_sessions = 2;
+
+    std::mutex mutex;
+    std::vector<entry_t> sessions;
+  };
+
+  encode_session_pool_t encode_session_pool;
+
   void
   encode_run(
     int &frame_nr,  // Store progress of the frame number
@@ -1984,15 +2576,12 @@ namespace video {
     img_event_t images,
     config_t config,
     std::shared_ptr<platf::display_t> disp,
-    std::unique_ptr<platf::encode_device_t> encode_device,
+    std::unique_ptr<encode_session_t> session,
     safe::signal_t &reinit_event,
     const encoder_t &encoder,
     void *channel_data,
-    std::optional<safe::mail_raw_t::event_t<dynamic_param_t>> dynamic_param_events) {
-    auto session = make_encode_session(disp.get(), encoder, config, disp->width, disp->height, std::move(encode_device));
-    if (!session) {
-      return;
-    }
+    std::optional<safe::mail_raw_t::event_t<dynamic_param_t>> dynamic_param_events,
+    std::chrono::steady_clock::time_point setup_start) {
 
     // As a workaround for NVENC hangs and to generally speed up encoder reinit,
     // we will complete the encoder teardown in a separate thread if supported.
@@ -2032,6 +2621,37 @@ namespace video {
       }
     }
 
+    // Images identical to the last one are only encoded again to refresh the quality of static content
+    static_frame_filter_t frame_filter { software_encode_device(*session) != nullptr };
+    auto last_encode = std::chrono::steady_clock::now();
+    auto first_frame_nr = frame_nr;
+
+    // Convert the next image while the current frame is being encoded
+    std::unique_ptr<convert_stage_t> convert_stage;
+    if (config::video.sw.pipeline) {
+      auto device = software_encode_device(*session);
+      if (device && !device->enable_pipelining()) {
+        convert_stage = std::make_unique<convert_stage_t>(images, *device, frame_filter, std::chrono::duration_cast<std::chrono::milliseconds>(minimum_frame_time));
+        BOOST_LOG(info) << "Color conversion and encoding are pipelined"sv;
+      }
+      else {
+        BOOST_LOG(info) << "Encoder can't pipeline color conversion, converting and encoding serially"sv;
+      }
+    }
+
+    logging::time_delta_periodic_logger convert_logger { debug, "Convert stage" };
+    logging::time_delta_periodic_logger encode_logger { debug, "Encode stage" };
+    logging::time_delta_periodic_logger pipeline_wait_logger { debug, "Pipeline: converted frame wait" };
+
+    bool first_frame_encoded = false;
+    bool stream_ended = false;
+
+    trace::name_thread("encode");
+
+    auto log_skipped = util::fail_guard([&]() {
+      BOOST_LOG(info) << "Encoded "sv << frame_nr - first_frame_nr << " frames, skipped "sv << frame_filter.skipped << " encodes of unchanged frames"sv;
+    });
+
     while (true) {
       // Break out of the encoding loop if any of the following are true:
       // a) The stream is ending
@@ -2041,6 +2661,7 @@ namespace video {
       // If we have to reinit before we have received any captured frames, we will encode
       // the blank dummy frame just to let Moonlight know that we're alive.
       if (shutdown_event->peek() || !images->running() || (reinit_event.peek() && frame_nr > 1)) {
+        stream_ended = shutdown_event->peek();
         break;
       }
 
@@ -2065,6 +2686,8 @@ namespace video {
         }
       }
 
+      // A client only asks for an IDR frame when it can't decode anymore, so it always gets a real one.
+      // Intra refresh only stands in for IDR frames when recovering from lost reference frames.
       if (requested_idr_frame) {
         session->request_idr_frame();
       }
@@ -2072,26 +2695,91 @@ namespace video {
       std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
 
       // Encode at a minimum FPS to avoid image quality issues with static content
-      if (!requested_idr_frame || images->peek()) {
-        if (auto img = images->pop(minimum_frame_time)) {
+      if (convert_stage) {
+        if (!requested_idr_frame || convert_stage->peek()) {
+          auto pull_begin = trace::now();
+          if (auto converted = convert_stage->pop(minimum_frame_time)) {
+            trace::record("pull", frame_nr, pull_begin, trace::now());
+            trace::record(converted->capture_trace, frame_nr);
+            trace::record(converted->convert_trace, frame_nr);
+            if (converted->error) {
+              BOOST_LOG(error) << "Could not convert image"sv;
+              return;
+            }
+
+            // Time the converted frame spent waiting for the previous frame to be encoded
+            pipeline_wait_logger.first_point(converted->convert_end);
+            pipeline_wait_logger.second_point_now_and_log();
+
+            frame_timestamp = converted->frame_timestamp;
+          }
+          else if (!images->running()) {
+            break;
+          }
+        }
+      }
+      else if (!requested_idr_frame || images->peek()) {
+        std::chrono::duration<double, std::milli> refresh_timeout = minimum_frame_time - (std::chrono::steady_clock::now() - last_encode);
+
+        auto pull_begin = trace::now();
+        if (auto img = images->pop(std::max(refresh_timeout, decltype(refresh_timeout)::zero()))) {
+          trace::record("pull", frame_nr, pull_begin, trace::now());
+          auto refresh_due = std::chrono::steady_clock::now() - last_encode >= minimum_frame_time;
+
+          if (frame_filter.unchanged(*img) && !requested_idr_frame && !refresh_due) {
+            ++frame_filter.skipped;
+            continue;
+          }
+
           frame_timestamp = img->frame_timestamp;
+          trace::record(img->capture_trace, frame_nr);
+
+          trace::scope_t trace_convert { "convert", frame_nr };
+          convert_logger.first_point_now();
           if (session->convert(*img)) {
             BOOST_LOG(error) << "Could not convert image"sv;
             return;
           }
+          convert_logger.second_point_now_and_log();
         }
         else if (!images->running()) {
           break;
         }
       }
 
+      encode_logger.first_point_now();
       if (encode(frame_nr++, *session, packets, channel_data, frame_timestamp)) {
         BOOST_LOG(error) << "Could not encode video packet"sv;
         return;
       }
+      encode_logger.second_point_now_and_log();
+      last_encode = std::chrono::steady_clock::now();
+
+      if (!first_frame_encoded) {
+        first_frame_encoded = true;
+
+        auto time_to_first_frame = std::chrono::duration_cast<std::chrono::milliseconds>(last_encode - setup_start);
+        BOOST_LOG(info) << "Time to first encoded frame: "sv << time_to_first_frame.count() << "ms"sv;
+        metrics::global.time_to_first_frame.observe(last_encode - setup_start);
+      }
 
       session->request_normal_frame();
     }
+
+    // Keep the encoder of a stream that ended normally warm for the next one
+    if (stream_ended && (encoder.flags & REUSABLE_SESSION)) {
+      auto avcodec_session = dynamic_cast<avcodec_encode_session_t *>(session.get());
+      if (avcodec_session && !avcodec_session->dynamic_params_changed) {
+        // The convert stage uses the device of the session, the next stream sets it up again
+        convert_stage.reset();
+        if (auto device = software_encode_device(*session)) {
+          device->disable_pipelining();
+        }
+
+        session.release();
+        encode_session_pool.put(encode_session_pool_t::key(*disp, encoder, config), std::unique_ptr<avcodec_encode_session_t> { avcodec_session });
+      }
+    }
   }
 
   input::touch_port_t
@@ -2206,6 +2894,7 @@ namespace video {
 
     auto session = make_encode_session(disp, encoder, ctx.config, img.width, img.height, std::move(encode_device));
     if (!session) {
+      invalidate_cached_probe(encoder);
       return std::nullopt;
     }
 
@@ -2216,10 +2905,51 @@ namespace video {
     }
 
     encode_session.session = std::move(session);
+    encode_session.encode_logger = logging::time_delta_periodic_logger {
+      debug,
+      "Synced session encode ("s + std::to_string(ctx.config.width) + 'x' + std::to_string(ctx.config.height) + 'x' + std::to_string(ctx.config.framerate) + ')',
+    };
 
     return encode_session;
   }
 
+  /**
+   * @brief Convert the captured image for a synced session and encode it.
+   * @note Shuts the session down on failure.
+   */
+  void
+  encode_synced_session(sync_session_t &synced_session, platf::img_t *img, bool frame_captured) {
+    auto ctx = synced_session.ctx;
+
+    if (ctx->idr_events->peek()) {
+      synced_session.session->request_idr_frame();
+      ctx->idr_events->pop();
+    }
+
+    if (frame_captured && synced_session.session->convert(*img)) {
+      BOOST_LOG(error) << "Could not convert image"sv;
+      ctx->shutdown_event->raise(true);
+
+      return;
+    }
+
+    std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
+    if (img) {
+      frame_timestamp = img->frame_timestamp;
+    }
+
+    synced_session.encode_logger.first_point_now();
+    if (encode(ctx->frame_nr++, *synced_session.session, ctx->packets, ctx->channel_data, frame_timestamp)) {
+      BOOST_LOG(error) << "Could not encode video packet"sv;
+      ctx->shutdown_event->raise(true);
+
+      return;
+    }
+    synced_session.encode_logger.second_point_now_and_log();
+
+    synced_session.session->request_normal_frame();
+  }
+
   encode_e
   encode_run_sync(
     std::vector<std::unique_ptr<sync_session_ctx_t>> &synced_session_ctxs,
@@ -2279,6 +3009,10 @@ namespace video {
     auto ec = platf::capture_e::ok;
     while (encode_session_ctx_queue.running()) {
       auto push_captured_image_callback = [&](std::shared_ptr<platf::img_t> &&img, bool frame_captured) -> bool {
+        if (frame_captured) {
+          metrics::global.frames_captured.add();
+        }
+
         while (encode_session_ctx_queue.peek()) {
           auto encode_session_ctx = encode_session_ctx_queue.pop();
           if (!encode_session_ctx) {
@@ -2314,34 +3048,29 @@ namespace video {
             continue;
           }
 
-          if (ctx->idr_events->peek()) {
-            pos->session->request_idr_frame();
-            ctx->idr_events->pop();
-          }
-
-          if (frame_captured && pos->session->convert(*img)) {
-            BOOST_LOG(error) << "Could not convert image"sv;
-            ctx->shutdown_event->raise(true);
+          ++pos;
+        })
 
-            continue;
-          }
+        // Each additional session shouldn't add its encoding time to the latency of the others,
+        // but the image can't be handed back to the backend before all of them are done with it
+        if (synced_sessions.size() == 1) {
+          encode_synced_session(synced_sessions.front(), img.get(), frame_captured);
+        }
+        else {
+          for (auto &synced_session : synced_sessions) {
+            if (!synced_session.worker) {
+              synced_session.worker = std::make_unique<sync_encode_worker_t>();
+            }
 
-          std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
-          if (img) {
-            frame_timestamp = img->frame_timestamp;
+            synced_session.worker->post([&synced_session, &img, frame_captured]() {
+              encode_synced_session(synced_session, img.get(), frame_captured);
+            });
           }
 
-          if (encode(ctx->frame_nr++, *pos->session, ctx->packets, ctx->channel_data, frame_timestamp)) {
-            BOOST_LOG(error) << "Could not encode video packet"sv;
-            ctx->shutdown_event->raise(true);
-
-            continue;
+          for (auto &synced_session : synced_sessions) {
+            synced_session.worker->wait();
           }
-
-          pos->session->request_normal_frame();
-
-          ++pos;
-        })
+        }
 
         if (switch_display_event->peek()) {
           ec = platf::capture_e::reinit;
@@ -2354,6 +3083,7 @@ namespace video {
       auto pull_free_image_callback = [&img](std::shared_ptr<platf::img_t> &img_out) -> bool {
         img_out = img;
         img_out->frame_timestamp.reset();
+        img_out->damage.clear();
         return true;
       };
 
@@ -2453,10 +3183,37 @@ namespace video {
       }
 
       auto &encoder = *chosen_encoder;
+      auto setup_start = std::chrono::steady_clock::now();
+
+      // Reuse a warm encoder if a stream with the same configuration ended recently
+      std::unique_ptr<encode_session_t> session;
+      sunshine_colorspace_t colorspace;
+      if (encoder.flags & REUSABLE_SESSION) {
+        if (auto warm_session = encode_session_pool.take(encode_session_pool_t::key(*display, encoder, config))) {
+          BOOST_LOG(info) << "Reusing warm encoder"sv;
+          metrics::global.warm_encoders_reused.add();
+
+          // Continue the timestamps of the previous stream, and start the new one with an IDR frame
+          warm_session->pts_base = warm_session->last_pts;
+          warm_session->request_idr_frame();
+
+          colorspace = warm_session->device->colorspace;
+          session = std::move(warm_session);
+        }
+      }
 
-      auto encode_device = make_encode_device(*display, encoder, config);
-      if (!encode_device) {
-        return;
+      if (!session) {
+        auto encode_device = make_encode_device(*display, encoder, config);
+        if (!encode_device) {
+          return;
+        }
+
+        colorspace = encode_device->colorspace;
+        session = make_encode_session(display.get(), encoder, config, display->width, display->height, std::move(encode_device));
+        if (!session) {
+          invalidate_cached_probe(encoder);
+          continue;
+        }
       }
 
       // absolute mouse coordinates require that the dimensions of the screen are known
@@ -2464,7 +3221,7 @@ namespace video {
 
       // Update client with our current HDR display state
       hdr_info_t hdr_info = std::make_unique<hdr_info_raw_t>(false);
-      if (colorspace_is_hdr(encode_device->colorspace)) {
+      if (colorspace_is_hdr(colorspace)) {
         if (display->get_hdr_metadata(hdr_info->metadata)) {
           hdr_info->enabled = true;
         }
@@ -2478,9 +3235,10 @@ namespace video {
         frame_nr,
         mail, images,
         config, display,
-        std::move(encode_device),
+        std::move(session),
         ref->reinit_event, *ref->encoder_p,
-        channel_data, dynamic_param_events);
+        channel_data, dynamic_param_events,
+        setup_start);
     }
   }
 
@@ -2542,7 +3300,8 @@ namespace video {
 
     session->request_idr_frame();
 
-    auto packets = mail::man->queue<packet_t>(mail::video_packets);
+    // Use a queue of our own, encoders may be validated concurrently
+    auto packets = std::make_shared<safe::mail_raw_t>()->queue<packet_t>(mail::video_packets);
     while (!packets->peek()) {
       if (encode(1, *session, packets, nullptr, {})) {
         return -1;
@@ -2583,6 +3342,12 @@ namespace video {
       BOOST_LOG(info) << "Encoder ["sv << encoder.name << "] failed"sv;
     });
 
+    auto probe_start = std::chrono::steady_clock::now();
+    auto log_probe_time = util::fail_guard([&]() {
+      auto probe_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - probe_start);
+      BOOST_LOG(info) << "Probing encoder ["sv << encoder.name << "] took "sv << probe_time.count() << "ms"sv;
+    });
+
     auto test_hevc = active_hevc_mode >= 2 || (active_hevc_mode == 0 && !(encoder.flags & H264_ONLY));
     auto test_av1 = active_av1_mode >= 2 || (active_av1_mode == 0 && !(encoder.flags & H264_ONLY));
 
@@ -2771,11 +3536,12 @@ namespace video {
     auto encoder_list = encoders;
 
     // If we already have a good encoder, check to see if another probe is required
-    if (chosen_encoder && !(chosen_encoder->flags & ALWAYS_REPROBE) && !platf::needs_encoder_reenumeration()) {
+    if (chosen_encoder && !(chosen_encoder->flags & ALWAYS_REPROBE) && !platf::needs_encoder_reenumeration() && !reprobe_requested.exchange(false)) {
       return 0;
     }
 
     // Restart encoder selection
+    reprobe_requested = false;
     auto previous_encoder = chosen_encoder;
     chosen_encoder = nullptr;
     active_hevc_mode = config::video.hevc_mode;
@@ -2803,14 +3569,72 @@ namespace video {
       }
     };
 
-    if (!config::video.encoder.empty()) {
+    // Reuse the outcome of the last probe if nothing it depends on has changed since
+    auto cache_file = probe_cache_file();
+    auto cache_key = config::video.probe_cache ? probe_cache_key() : std::nullopt;
+    cached_probe_encoder = nullptr;
+    if (cache_key) {
+      if (auto cached = probe_cache::load(cache_file, *cache_key)) {
+        auto pos = std::find_if(std::begin(encoder_list), std::end(encoder_list), [&](auto encoder) {
+          return encoder->name == cached->encoder;
+        });
+
+        // Encoders of last resort are always probed, a better one may work by now
+        if (pos != std::end(encoder_list) && !((*pos)->flags & ALWAYS_REPROBE)) {
+          auto encoder = *pos;
+          encoder->h264.capabilities = cached->h264;
+          encoder->hevc.capabilities = cached->hevc;
+          encoder->av1.capabilities = cached->av1;
+          active_hevc_mode = cached->hevc_mode;
+          active_av1_mode = cached->av1_mode;
+
+          chosen_encoder = encoder;
+          cached_probe_encoder = encoder;
+          BOOST_LOG(info) << "Using cached encoder probe results, delete ["sv << cache_file.string() << "] to probe again"sv;
+        }
+        else {
+          probe_cache::invalidate(cache_file);
+        }
+      }
+    }
+
+    auto probe_start = std::chrono::steady_clock::now();
+    auto probed = chosen_encoder == nullptr;
+
+    // Validate every encoder at once if the platform permits it. The encoders are still chosen
+    // in order of preference, so this only saves the time spent on encoders that turn out to fail.
+    std::map<encoder_t *, std::shared_future<bool>> concurrent_probes;
+    if (probed && config::video.encoder.empty() && encoder_list.size() > 1 && platf::supports_concurrent_encoder_probing()) {
+      for (auto encoder : encoder_list) {
+        auto expect_failure = previous_encoder && previous_encoder != encoder;
+        concurrent_probes.emplace(encoder, std::async(std::launch::async, validate_encoder, std::ref(*encoder), expect_failure).share());
+      }
+
+      // The selection below changes the codec modes the probes depend on
+      for (auto &[encoder, probe] : concurrent_probes) {
+        probe.wait();
+      }
+    }
+
+    auto validate = [&](encoder_t *encoder) {
+      if (auto probe = concurrent_probes.find(encoder); probe != std::end(concurrent_probes)) {
+        return probe->second.get();
+      }
+
+      // If we've used a previous encoder and it's not this one, we expect this encoder to
+      // fail to validate. It will use a slightly different order of checks to more quickly
+      // eliminate failing encoders.
+      return validate_encoder(*encoder, previous_encoder && previous_encoder != encoder);
+    };
+
+    if (chosen_encoder == nullptr && !config::video.encoder.empty()) {
       // If there is a specific encoder specified, use it if it passes validation
       KITTY_WHILE_LOOP(auto pos = std::begin(encoder_list), pos != std::end(encoder_list), {
         auto encoder = *pos;
 
         if (encoder->name == config::video.encoder) {
           // Remove the encoder from the list entirely if it fails validation
-          if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+          if (!validate(encoder)) {
             pos = encoder_list.erase(pos);
             break;
           }
@@ -2830,7 +3654,9 @@ namespace video {
       }
     }
 
-    BOOST_LOG(info) << "Testing for available encoders - Errors during this phase can be ignored (测试可用编码器 - 此阶段的错误可以忽略)";
+    if (probed) {
+      BOOST_LOG(info) << "Testing for available encoders - Errors during this phase can be ignored (测试可用编码器 - 此阶段的错误可以忽略)";
+    }
 
     // If we haven't found an encoder yet, but we want one with specific codec support, search for that now.
     if (chosen_encoder == nullptr && (active_hevc_mode >= 2 || active_av1_mode >= 2)) {
@@ -2838,7 +3664,7 @@ namespace video {
         auto encoder = *pos;
 
         // Remove the encoder from the list entirely if it fails validation
-        if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+        if (!validate(encoder)) {
           pos = encoder_list.erase(pos);
           continue;
         }
@@ -2872,10 +3698,7 @@ namespace video {
       KITTY_WHILE_LOOP(auto pos = std::begin(encoder_list), pos != std::end(encoder_list), {
         auto encoder = *pos;
 
-        // If we've used a previous encoder and it's not this one, we expect this encoder to
-        // fail to validate. It will use a slightly different order of checks to more quickly
-        // eliminate failing encoders.
-        if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+        if (!validate(encoder)) {
           pos = encoder_list.erase(pos);
           continue;
         }
@@ -2900,11 +3723,45 @@ namespace video {
       return -1;
     }
 
-    BOOST_LOG(info) << "Ignore any errors, Encoder testing completed (忽略任何错误，编码器测试完成)";
-
     auto &encoder = *chosen_encoder;
 
-    last_encoder_probe_supported_ref_frames_invalidation = (encoder.flags & REF_FRAMES_INVALIDATION);
+    if (probed) {
+      auto probe_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - probe_start);
+      BOOST_LOG(info) << "Ignore any errors, Encoder testing completed (忽略任何错误，编码器测试完成)";
+      BOOST_LOG(info) << "Probing encoders took "sv << probe_time.count() << "ms"sv;
+
+      // Only cache the encoder of choice. Encoders of last resort and fallbacks from a failed encoder
+      // or from unsupported codec settings are probed again, so the preferred encoder gets another chance.
+      auto fallback = (previous_encoder && previous_encoder != chosen_encoder) ||
+                      (!config::video.encoder.empty() && encoder.name != config::video.encoder) ||
+                      active_hevc_mode != config::video.hevc_mode ||
+                      active_av1_mode != config::video.av1_mode;
+
+      if (cache_key && !(encoder.flags & ALWAYS_REPROBE) && !fallback) {
+        probe_cache::save(cache_file, {
+                                        *cache_key,
+                                        std::string { encoder.name },
+                                        active_hevc_mode,
+                                        active_av1_mode,
+                                        (std::uint32_t) encoder.h264.capabilities.to_ulong(),
+                                        (std::uint32_t) encoder.hevc.capabilities.to_ulong(),
+                                        (std::uint32_t) encoder.av1.capabilities.to_ulong(),
+                                      });
+      }
+      else if (cache_key) {
+        probe_cache::invalidate(cache_file);
+      }
+    }
+
+    // Of the software encoders only libx264 and libx265 have intra refresh, libsvtav1 would have to send IDR frames
+    auto has_intra_refresh = [](const encoder_t::codec_t &codec) {
+      return !codec[encoder_t::PASSED] || codec.name == "libx264"sv || codec.name == "libx265"sv;
+    };
+    last_encoder_probe_supported_ref_frames_invalidation = (encoder.flags & REF_FRAMES_INVALIDATION) ||
+                                                           ((encoder.flags & INTRA_REFRESH_RFI) &&
+                                                             has_intra_refresh(encoder.h264) &&
+                                                             has_intra_refresh(encoder.hevc) &&
+                                                             has_intra_refresh(encoder.av1));
     last_encoder_probe_supported_yuv444_for_codec[0] = encoder.h264[encoder_t::PASSED] &&
                                                        encoder.h264[encoder_t::YUV444];
     last_encoder_probe_supported_yuv444_for_codec[1] = encoder.hevc[encoder_t::PASSED] &&
@@ -2953,6 +3810,54 @@ namespace video {
     return 0;
   }
 
+  namespace {
+    std::mutex background_probe_mutex;
+    std::shared_future<int> background_probe;
+
+    std::shared_future<int>
+    current_background_probe() {
+      std::lock_guard lg { background_probe_mutex };
+      return background_probe;
+    }
+  }  // namespace
+
+  std::shared_future<int>
+  probe_encoders_async() {
+    std::lock_guard lg { background_probe_mutex };
+
+    auto probe = []() {
+      auto start = std::chrono::steady_clock::now();
+
+      auto status = probe_encoders();
+      if (status) {
+        BOOST_LOG(error) << "Video failed to find working encoder"sv;
+      }
+
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+      BOOST_LOG(info) << "Background encoder probe completed in "sv << elapsed.count() << "ms"sv;
+
+      return status;
+    };
+
+    background_probe = std::async(std::launch::async, probe).share();
+
+    return background_probe;
+  }
+
+  void
+  wait_for_encoder_probe() {
+    if (auto probe = current_background_probe(); probe.valid()) {
+      probe.wait();
+    }
+  }
+
+  bool
+  probing_encoders() {
+    auto probe = current_background_probe();
+
+    return probe.valid() && probe.wait_for(0ms) != std::future_status::ready;
+  }
+
   // Linux only declaration
   typedef int (*vaapi_init_avcodec_hardware_input_buffer_fn)(platf::avcodec_encode_device_t *encode_device, AVBufferRef **hw_device_buf);
 
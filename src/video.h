@@ -4,6 +4,9 @@
  */
 #pragma once
 
+#include <chrono>
+#include <future>
+
 #include "input.h"
 #include "platform/common.h"
 #include "thread_safe.h"
@@ -243,6 +246,12 @@ namespace video {
     virtual void
     invalidate_ref_frames(int64_t first_frame, int64_t last_frame) = 0;
 
+    // Returns true if an intra refresh wave will repair the picture after reference frames were lost, so no IDR frame is needed
+    virtual bool
+    recover_with_intra_refresh(int64_t frame_nr) {
+      return false;
+    }
+
     virtual void
     set_bitrate(int bitrate_kbps) = 0;  // 新增：动态码率调整方法
 
@@ -299,6 +308,9 @@ namespace video {
     void *channel_data = nullptr;
     bool after_ref_frame_invalidation = false;
     std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
+
+    // Time the encoder took to return the frame
+    std::chrono::steady_clock::duration encode_duration {};
   };
 
   struct packet_raw_avcodec: packet_raw_t {
@@ -402,4 +414,36 @@ namespace video {
    */
   int
   probe_encoders();
+
+  /**
+   * @brief Run `probe_encoders()` on a thread of its own, so startup doesn't wait for it.
+   * @return The result of the probe once it completes.
+   */
+  std::shared_future<int>
+  probe_encoders_async();
+
+  /**
+   * @brief Wait for the probe started by `probe_encoders_async()`.
+   * @details Anything that reads the probe results or probes again must wait for it first.
+   */
+  void
+  wait_for_encoder_probe();
+
+  /**
+   * @brief Check if the probe started by `probe_encoders_async()` is still running, without waiting for it.
+   * @return `true` if the probe results can't be read yet.
+   */
+  bool
+  probing_encoders();
+
+  using display_factory_t = std::function<std::shared_ptr<platf::display_t>(platf::mem_type_e hwdevice_type, const std::string &display_name, const config_t &config)>;
+
+  /**
+   * @brief Capture from displays created by `factory` instead of the capture backends of the platform.
+   * @details This lets the whole pipeline run headless, e.g. on synthetic frames in benchmarks.
+   * @param factory Creates the displays, an empty function restores the capture backends of the platform.
+   * @param display_names The names of the displays `factory` can create.
+   */
+  void
+  override_displays(display_factory_t factory, std::vector<std::string> display_names);
 }  // namespace video
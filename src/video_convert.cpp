@@ -0,0 +1,439 @@
+/**
+ * @file src/video_convert.cpp
+ * @brief Definitions for converting captured images to the YUV formats of software encoders.
+ */
+#include <algorithm>
+#include <cmath>
+
+#include "video_convert.h"
+
+#if defined(__x86_64) || defined(__x86_64__) || defined(__amd64) || defined(__amd64__) || defined(_M_AMD64)
+  #include <immintrin.h>
+
+  #define VIDEO_CONVERT_X86
+#endif
+
+namespace video {
+  namespace {
+    using channel_t = bgr0_converter_t::channel_t;
+    using coeffs_t = bgr0_converter_t::coeffs_t;
+
+    // Fractional bits of the coefficients, the most that keeps 10-bit full range coefficients within 16 bits
+    constexpr int coeff_bits = 13;
+
+    inline int
+    dot(const std::uint8_t *pixel, const channel_t &channel) {
+      return pixel[0] * channel.b + pixel[1] * channel.g + pixel[2] * channel.r;
+    }
+
+    template <class T>
+    inline T
+    sample(int value, const coeffs_t &coeffs) {
+      return (T) (std::clamp(value, 0, coeffs.max) << coeffs.shift);
+    }
+
+    template <class T>
+    void
+    luma_row_scalar(const std::uint8_t *src, std::uint8_t *dst, int width, const channel_t &channel, const coeffs_t &coeffs) {
+      auto out = (T *) dst;
+
+      for (int x = 0; x < width; ++x) {
+        out[x] = sample<T>((dot(src + x * 4, channel) + channel.offset) >> coeff_bits, coeffs);
+      }
+    }
+
+    /**
+     * @brief Convert the chroma of two rows, starting at chroma sample `begin`.
+     * @details Each chroma sample covers 2x2 pixels, the last column is repeated if the width is odd.
+     */
+    template <class T, bool interleaved>
+    void
+    chroma_range_scalar(const std::uint8_t *src0, const std::uint8_t *src1, std::uint8_t *dst_u, std::uint8_t *dst_v, int width, const coeffs_t &coeffs, int begin) {
+      constexpr int step = interleaved ? 2 : 1;
+
+      auto out_u = (T *) dst_u;
+      auto out_v = (T *) dst_v;
+
+      for (int x = begin; x < (width + 1) / 2; ++x) {
+        auto left = x * 2 * 4;
+        auto right = std::min(x * 2 + 1, width - 1) * 4;
+
+        auto u = dot(src0 + left, coeffs.u) + dot(src0 + right, coeffs.u) + dot(src1 + left, coeffs.u) + dot(src1 + right, coeffs.u);
+        auto v = dot(src0 + left, coeffs.v) + dot(src0 + right, coeffs.v) + dot(src1 + left, coeffs.v) + dot(src1 + right, coeffs.v);
+
+        out_u[x * step] = sample<T>((u + coeffs.u.offset * 4) >> (coeff_bits + 2), coeffs);
+        out_v[x * step] = sample<T>((v + coeffs.v.offset * 4) >> (coeff_bits + 2), coeffs);
+      }
+    }
+
+    template <class T, bool interleaved>
+    void
+    chroma_row_scalar(const std::uint8_t *src0, const std::uint8_t *src1, std::uint8_t *dst_u, std::uint8_t *dst_v, int width, const coeffs_t &coeffs) {
+      chroma_range_scalar<T, interleaved>(src0, src1, dst_u, dst_v, width, coeffs, 0);
+    }
+
+#ifdef VIDEO_CONVERT_X86
+    __attribute__((target("avx2"))) inline __m256i
+    coeff_vec(const channel_t &channel) {
+      return _mm256_setr_epi16(
+        channel.b, channel.g, channel.r, 0, channel.b, channel.g, channel.r, 0,
+        channel.b, channel.g, channel.r, 0, channel.b, channel.g, channel.r, 0);
+    }
+
+    /**
+     * @brief Compute the dot products of 8 pixels.
+     * @details The unpack and horizontal add instructions work within 128-bit lanes,
+     * so the products come out in pixel order.
+     */
+    __attribute__((target("avx2"))) inline __m256i
+    dot8(__m256i pixels, __m256i coeff) {
+      auto zero = _mm256_setzero_si256();
+
+      auto lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(pixels, zero), coeff);
+      auto hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(pixels, zero), coeff);
+      return _mm256_hadd_epi32(lo, hi);
+    }
+
+    /**
+     * @brief Compute the sums of the dot products of 8 pixels in two rows, per column.
+     */
+    __attribute__((target("avx2"))) inline __m256i
+    column_dot8(__m256i pixels0, __m256i pixels1, __m256i coeff) {
+      auto zero = _mm256_setzero_si256();
+
+      auto lo = _mm256_add_epi32(
+        _mm256_madd_epi16(_mm256_unpacklo_epi8(pixels0, zero), coeff),
+        _mm256_madd_epi16(_mm256_unpacklo_epi8(pixels1, zero), coeff));
+      auto hi = _mm256_add_epi32(
+        _mm256_madd_epi16(_mm256_unpackhi_epi8(pixels0, zero), coeff),
+        _mm256_madd_epi16(_mm256_unpackhi_epi8(pixels1, zero), coeff));
+      return _mm256_hadd_epi32(lo, hi);
+    }
+
+    /**
+     * @brief Compute 8 chroma samples from 16x2 pixels.
+     */
+    __attribute__((target("avx2"))) inline __m128i
+    chroma8(const __m256i (&pixels)[4], __m256i coeff, __m256i offset) {
+      auto sums = _mm256_hadd_epi32(column_dot8(pixels[0], pixels[2], coeff), column_dot8(pixels[1], pixels[3], coeff));
+      sums = _mm256_permute4x64_epi64(sums, 0xD8);
+      sums = _mm256_srai_epi32(_mm256_add_epi32(sums, offset), coeff_bits + 2);
+
+      return _mm_packs_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    }
+
+    template <class T>
+    __attribute__((target("avx2"))) inline __m128i
+    clamp8(__m128i samples, const coeffs_t &coeffs) {
+      samples = _mm_min_epi16(_mm_max_epi16(samples, _mm_setzero_si128()), _mm_set1_epi16(coeffs.max));
+      return _mm_sll_epi16(samples, _mm_cvtsi32_si128(coeffs.shift));
+    }
+
+    /**
+     * @brief Store 16 samples held as 16-bit integers.
+     */
+    template <class T>
+    __attribute__((target("avx2"))) inline void
+    store16(T *dst, __m256i samples, const coeffs_t &coeffs) {
+      if constexpr (sizeof(T) == 1) {
+        samples = _mm256_permute4x64_epi64(_mm256_packus_epi16(samples, samples), 0x08);
+        _mm_storeu_si128((__m128i *) dst, _mm256_castsi256_si128(samples));
+      }
+      else {
+        samples = _mm256_min_epi16(_mm256_max_epi16(samples, _mm256_setzero_si256()), _mm256_set1_epi16(coeffs.max));
+        samples = _mm256_sll_epi16(samples, _mm_cvtsi32_si128(coeffs.shift));
+        _mm256_storeu_si256((__m256i *) dst, samples);
+      }
+    }
+
+    /**
+     * @brief Store 8 samples held as 16-bit integers.
+     */
+    template <class T>
+    __attribute__((target("avx2"))) inline void
+    store8(T *dst, __m128i samples, const coeffs_t &coeffs) {
+      if constexpr (sizeof(T) == 1) {
+        _mm_storel_epi64((__m128i *) dst, _mm_packus_epi16(samples, samples));
+      }
+      else {
+        _mm_storeu_si128((__m128i *) dst, clamp8<T>(samples, coeffs));
+      }
+    }
+
+    /**
+     * @brief Store 8 samples of each chroma channel, interleaved.
+     */
+    template <class T>
+    __attribute__((target("avx2"))) inline void
+    store8x2(T *dst, __m128i u, __m128i v, const coeffs_t &coeffs) {
+      if constexpr (sizeof(T) == 1) {
+        _mm_storeu_si128((__m128i *) dst, _mm_packus_epi16(_mm_unpacklo_epi16(u, v), _mm_unpackhi_epi16(u, v)));
+      }
+      else {
+        u = clamp8<T>(u, coeffs);
+        v = clamp8<T>(v, coeffs);
+        _mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi16(u, v));
+        _mm_storeu_si128((__m128i *) (dst + 8), _mm_unpackhi_epi16(u, v));
+      }
+    }
+
+    template <class T>
+    __attribute__((target("avx2"))) void
+    luma_row_avx2(const std::uint8_t *src, std::uint8_t *dst, int width, const channel_t &channel, const coeffs_t &coeffs) {
+      auto out = (T *) dst;
+      auto coeff = coeff_vec(channel);
+      auto offset = _mm256_set1_epi32(channel.offset);
+
+      int x = 0;
+      for (; x + 16 <= width; x += 16) {
+        auto a = dot8(_mm256_loadu_si256((const __m256i *) (src + x * 4)), coeff);
+        auto b = dot8(_mm256_loadu_si256((const __m256i *) (src + x * 4 + 32)), coeff);
+
+        a = _mm256_srai_epi32(_mm256_add_epi32(a, offset), coeff_bits);
+        b = _mm256_srai_epi32(_mm256_add_epi32(b, offset), coeff_bits);
+
+        store16(out + x, _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8), coeffs);
+      }
+
+      luma_row_scalar<T>(src + x * 4, (std::uint8_t *) (out + x), width - x, channel, coeffs);
+    }
+
+    template <class T, bool interleaved>
+    __attribute__((target("avx2"))) void
+    chroma_row_avx2(const std::uint8_t *src0, const std::uint8_t *src1, std::uint8_t *dst_u, std::uint8_t *dst_v, int width, const coeffs_t &coeffs) {
+      auto out_u = (T *) dst_u;
+      auto out_v = (T *) dst_v;
+      auto coeff_u = coeff_vec(coeffs.u);
+      auto coeff_v = coeff_vec(coeffs.v);
+      auto offset_u = _mm256_set1_epi32(coeffs.u.offset * 4);
+      auto offset_v = _mm256_set1_epi32(coeffs.v.offset * 4);
+
+      int x = 0;
+      for (; x + 16 <= width; x += 16) {
+        __m256i pixels[4] {
+          _mm256_loadu_si256((const __m256i *) (src0 + x * 4)),
+          _mm256_loadu_si256((const __m256i *) (src0 + x * 4 + 32)),
+          _mm256_loadu_si256((const __m256i *) (src1 + x * 4)),
+          _mm256_loadu_si256((const __m256i *) (src1 + x * 4 + 32)),
+        };
+
+        auto u = chroma8(pixels, coeff_u, offset_u);
+        auto v = chroma8(pixels, coeff_v, offset_v);
+
+        if constexpr (interleaved) {
+          store8x2(out_u + x, u, v, coeffs);
+        }
+        else {
+          store8(out_u + x / 2, u, coeffs);
+          store8(out_v + x / 2, v, coeffs);
+        }
+      }
+
+      chroma_range_scalar<T, interleaved>(src0, src1, dst_u, dst_v, width, coeffs, x / 2);
+    }
+#endif
+
+    template <class T>
+    bgr0_converter_t::luma_row_fn
+    select_luma_row(bool simd) {
+#ifdef VIDEO_CONVERT_X86
+      if (simd && __builtin_cpu_supports("avx2")) {
+        return luma_row_avx2<T>;
+      }
+#endif
+      return luma_row_scalar<T>;
+    }
+
+    template <class T, bool interleaved>
+    bgr0_converter_t::chroma_row_fn
+    select_chroma_row(bool simd) {
+#ifdef VIDEO_CONVERT_X86
+      if (simd && __builtin_cpu_supports("avx2")) {
+        return chroma_row_avx2<T, interleaved>;
+      }
+#endif
+      return chroma_row_scalar<T, interleaved>;
+    }
+
+    channel_t
+    make_channel(const float (&color_vec)[4]) {
+      // The color vectors expect UNORM input, we feed 8-bit integers
+      auto fixed = [](double value) {
+        return (std::int32_t) std::lround(value * (1 << coeff_bits));
+      };
+
+      return {
+        (std::int16_t) fixed(color_vec[2] / 255.0),
+        (std::int16_t) fixed(color_vec[1] / 255.0),
+        (std::int16_t) fixed(color_vec[0] / 255.0),
+        fixed(color_vec[3]),
+      };
+    }
+  }  // namespace
+
+  std::unique_ptr<bgr0_converter_t>
+  bgr0_converter_t::make(AVPixelFormat format, int threads, bool simd) {
+    std::unique_ptr<bgr0_converter_t> converter { new bgr0_converter_t };
+
+    switch (format) {
+      case AV_PIX_FMT_YUV420P:
+        converter->depth = 8;
+        converter->chroma420 = true;
+        converter->luma_row = select_luma_row<std::uint8_t>(simd);
+        converter->chroma_row = select_chroma_row<std::uint8_t, false>(simd);
+        break;
+      case AV_PIX_FMT_NV12:
+        converter->depth = 8;
+        converter->chroma420 = true;
+        converter->semi_planar = true;
+        converter->luma_row = select_luma_row<std::uint8_t>(simd);
+        converter->chroma_row = select_chroma_row<std::uint8_t, true>(simd);
+        break;
+      case AV_PIX_FMT_YUV444P:
+        converter->depth = 8;
+        converter->luma_row = select_luma_row<std::uint8_t>(simd);
+        break;
+      case AV_PIX_FMT_YUV420P10:
+        converter->depth = 10;
+        converter->chroma420 = true;
+        converter->luma_row = select_luma_row<std::uint16_t>(simd);
+        converter->chroma_row = select_chroma_row<std::uint16_t, false>(simd);
+        break;
+      case AV_PIX_FMT_P010:
+        converter->depth = 10;
+        converter->chroma420 = true;
+        converter->semi_planar = true;
+        converter->coeffs.shift = 6;
+        converter->luma_row = select_luma_row<std::uint16_t>(simd);
+        converter->chroma_row = select_chroma_row<std::uint16_t, true>(simd);
+        break;
+      case AV_PIX_FMT_YUV444P10:
+        converter->depth = 10;
+        converter->luma_row = select_luma_row<std::uint16_t>(simd);
+        break;
+      default:
+        return nullptr;
+    }
+
+    converter->set_colorspace({ colorspace_e::rec709, false, (unsigned) converter->depth });
+
+    for (int x = 1; x < threads; ++x) {
+      converter->workers.emplace_back(&bgr0_converter_t::worker, converter.get(), x);
+    }
+
+    return converter;
+  }
+
+  bgr0_converter_t::~bgr0_converter_t() {
+    {
+      std::lock_guard lock { mutex };
+      stop = true;
+    }
+    work_cv.notify_all();
+
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  void
+  bgr0_converter_t::set_colorspace(const sunshine_colorspace_t &colorspace) {
+    // The bit depth of the output format takes precedence
+    auto color_vectors = new_color_vectors_from_colorspace({ colorspace.colorspace, colorspace.full_range, (unsigned) depth });
+
+    coeffs.y = make_channel(color_vectors->color_vec_y);
+    coeffs.u = make_channel(color_vectors->color_vec_u);
+    coeffs.v = make_channel(color_vectors->color_vec_v);
+    coeffs.max = (1 << depth) - 1;
+  }
+
+  void
+  bgr0_converter_t::convert(const std::uint8_t *src, int src_pitch, int width, int height, std::uint8_t *const *dst, const int *dst_linesize) {
+    job = {
+      src,
+      src_pitch,
+      width,
+      height,
+      { dst[0], dst[1], dst[2] },
+      { dst_linesize[0], dst_linesize[1], dst_linesize[2] },
+    };
+
+    if (workers.empty()) {
+      convert_stripe(0);
+      return;
+    }
+
+    {
+      std::lock_guard lock { mutex };
+      ++generation;
+      pending = workers.size();
+    }
+    work_cv.notify_all();
+
+    convert_stripe(0);
+
+    std::unique_lock lock { mutex };
+    done_cv.wait(lock, [this]() { return pending == 0; });
+  }
+
+  void
+  bgr0_converter_t::worker(int index) {
+    std::uint64_t seen = 0;
+
+    while (true) {
+      {
+        std::unique_lock lock { mutex };
+        work_cv.wait(lock, [&]() { return stop || generation != seen; });
+        if (stop) {
+          return;
+        }
+        seen = generation;
+      }
+
+      convert_stripe(index);
+
+      std::lock_guard lock { mutex };
+      if (--pending == 0) {
+        done_cv.notify_one();
+      }
+    }
+  }
+
+  void
+  bgr0_converter_t::convert_stripe(int index) {
+    auto stripes = (int) workers.size() + 1;
+
+    // Stripes start on even rows, so each of them has its own chroma rows
+    auto rows = (job.height + stripes - 1) / stripes;
+    rows += rows & 1;
+
+    auto begin = std::min(index * rows, job.height);
+    auto end = std::min(begin + rows, job.height);
+
+    for (int y = begin; y < end; ++y) {
+      auto src = job.src + y * job.src_pitch;
+
+      luma_row(src, job.dst[0] + y * job.dst_linesize[0], job.width, coeffs.y, coeffs);
+      if (!chroma420) {
+        luma_row(src, job.dst[1] + y * job.dst_linesize[1], job.width, coeffs.u, coeffs);
+        luma_row(src, job.dst[2] + y * job.dst_linesize[2], job.width, coeffs.v, coeffs);
+      }
+    }
+
+    if (!chroma420) {
+      return;
+    }
+
+    auto sample_size = depth > 8 ? 2 : 1;
+    for (int y = begin; y < end; y += 2) {
+      auto src0 = job.src + y * job.src_pitch;
+      auto src1 = job.src + std::min(y + 1, job.height - 1) * job.src_pitch;
+
+      auto dst_u = job.dst[1] + (y / 2) * job.dst_linesize[1];
+      auto dst_v = semi_planar ? dst_u + sample_size : job.dst[2] + (y / 2) * job.dst_linesize[2];
+
+      chroma_row(src0, src1, dst_u, dst_v, job.width, coeffs);
+    }
+  }
+
+}  // namespace video
@@ -0,0 +1,123 @@
+/**
+ * @file src/video_convert.h
+ * @brief Declarations for converting captured images to the YUV formats of software encoders.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+#include "video_colorspace.h"
+
+namespace video {
+
+  /**
+   * @brief Converts BGR0 images to YUV without scaling.
+   * @details Much cheaper than swscale for same-size conversion, which is what the software
+   * encode device does unless the client resolution differs from the display resolution.
+   * The image is split into horizontal stripes that are converted on a pool of worker threads.
+   */
+  class bgr0_converter_t {
+  public:
+    /**
+     * @brief Fixed point RGB->YUV coefficients for a single output channel.
+     */
+    struct channel_t {
+      std::int16_t b;
+      std::int16_t g;
+      std::int16_t r;
+
+      // Includes the rounding term
+      std::int32_t offset;
+    };
+
+    struct coeffs_t {
+      channel_t y;
+      channel_t u;
+      channel_t v;
+
+      // Largest sample value
+      int max;
+
+      // Position of the samples in 16-bit containers, P010 keeps them in the high bits
+      int shift;
+    };
+
+    using luma_row_fn = void (*)(const std::uint8_t *src, std::uint8_t *dst, int width, const channel_t &channel, const coeffs_t &coeffs);
+    using chroma_row_fn = void (*)(const std::uint8_t *src0, const std::uint8_t *src1, std::uint8_t *dst_u, std::uint8_t *dst_v, int width, const coeffs_t &coeffs);
+
+    /**
+     * @brief Create a converter.
+     * @param format The output format.
+     * @param threads Number of threads to convert with, including the calling thread.
+     * @param simd Use the widest SIMD instruction set supported by the CPU.
+     * @return The converter, or nullptr if the output format isn't supported.
+     */
+    static std::unique_ptr<bgr0_converter_t>
+    make(AVPixelFormat format, int threads, bool simd = true);
+
+    ~bgr0_converter_t();
+
+    /**
+     * @brief Select the coefficients for the colorspace of the output.
+     */
+    void
+    set_colorspace(const sunshine_colorspace_t &colorspace);
+
+    /**
+     * @brief Convert an image.
+     * @param src The BGR0 image.
+     * @param src_pitch Bytes per row of the image.
+     * @param width, height Dimensions of both the image and the output.
+     * @param dst Planes of the output, like `AVFrame::data`.
+     * @param dst_linesize Bytes per row of each plane, like `AVFrame::linesize`.
+     */
+    void
+    convert(const std::uint8_t *src, int src_pitch, int width, int height, std::uint8_t *const *dst, const int *dst_linesize);
+
+  private:
+    bgr0_converter_t() = default;
+
+    void
+    worker(int index);
+
+    void
+    convert_stripe(int index);
+
+    struct job_t {
+      const std::uint8_t *src;
+      int src_pitch;
+      int width;
+      int height;
+      std::uint8_t *dst[3];
+      int dst_linesize[3];
+    };
+
+    int depth {};
+    bool chroma420 {};
+    bool semi_planar {};
+
+    coeffs_t coeffs {};
+    luma_row_fn luma_row {};
+    chroma_row_fn chroma_row {};
+
+    job_t job {};
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    std::uint64_t generation {};
+    std::size_t pending {};
+    bool stop = false;
+  };
+
+}  // namespace video
@@ -0,0 +1,178 @@
+/**
+ * @file tests/unit/test_asset_cache.cpp
+ * @brief Test src/asset_cache.*
+ */
+#include <src/asset_cache.h>
+
+#include <fstream>
+#include <thread>
+
+#include "../tests_common.h"
+
+using namespace std::literals;
+
+namespace {
+  class AssetCacheTest: public testing::Test {
+  protected:
+    void
+    SetUp() override {
+      dir = std::filesystem::temp_directory_path() / "sunshine_test_asset_cache";
+      std::filesystem::remove_all(dir);
+      std::filesystem::create_directories(dir);
+      asset_cache::clear();
+    }
+
+    void
+    TearDown() override {
+      asset_cache::clear();
+      std::filesystem::remove_all(dir);
+    }
+
+    std::filesystem::path
+    write(const std::string &name, std::string_view content) {
+      auto path = dir / name;
+      std::ofstream file { path, std::ios::binary | std::ios::trunc };
+      file << content;
+
+      return path;
+    }
+
+    /**
+     * Move the modification time, the file system may not notice changes within the same tick.
+     */
+    void
+    touch(const std::filesystem::path &path, std::chrono::seconds offset) {
+      std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + offset);
+    }
+
+    std::filesystem::path dir;
+  };
+}  // namespace
+
+TEST_F(AssetCacheTest, LoadsFileAndVariants) {
+  auto path = write("index.html", std::string(1000, 'a'));
+  write("index.html.gz", "gzip");
+  write("index.html.br", "brotli");
+
+  auto asset = asset_cache::get(path);
+  ASSERT_TRUE(asset);
+  EXPECT_EQ(asset->size, 1000);
+  EXPECT_EQ(asset->identity, std::string(1000, 'a'));
+  EXPECT_EQ(asset->gzip, "gzip");
+  EXPECT_EQ(asset->br, "brotli");
+
+  // Later requests share the loaded file
+  EXPECT_EQ(asset_cache::get(path), asset);
+}
+
+TEST_F(AssetCacheTest, SkipsStaleAndLargerVariants) {
+  auto path = write("app.js", "short");
+  write("app.js.gz", "longer than the file");
+  auto br = write("app.js.br", "br");
+  touch(br, -10s);
+
+  auto asset = asset_cache::get(path);
+  ASSERT_TRUE(asset);
+  EXPECT_FALSE(asset->gzip);
+  EXPECT_FALSE(asset->br);
+  EXPECT_EQ(asset_cache::negotiate(*asset, "gzip, deflate, br"), asset_cache::encoding_e::identity);
+}
+
+TEST_F(AssetCacheTest, ReloadsChangedFiles) {
+  auto path = write("style.css", "old");
+  auto asset = asset_cache::get(path);
+  ASSERT_TRUE(asset);
+
+  write("style.css", "new content");
+  touch(path, 10s);
+
+  // Changes are only noticed after the recheck interval
+  EXPECT_EQ(asset_cache::get(path), asset);
+  std::this_thread::sleep_for(asset_cache::recheck_interval + 100ms);
+
+  auto changed = asset_cache::get(path);
+  ASSERT_TRUE(changed);
+  EXPECT_EQ(changed->identity, "new content");
+  EXPECT_NE(asset_cache::etag(*changed, asset_cache::encoding_e::identity), asset_cache::etag(*asset, asset_cache::encoding_e::identity));
+
+  std::filesystem::remove(path);
+  std::this_thread::sleep_for(asset_cache::recheck_interval + 100ms);
+  EXPECT_FALSE(asset_cache::get(path));
+}
+
+TEST_F(AssetCacheTest, KeepsLargeFilesOnDisk) {
+  auto path = write("vendor.js", std::string(asset_cache::max_cached_size + 1, 'x'));
+  write("vendor.js.gz", "small");
+
+  auto asset = asset_cache::get(path);
+  ASSERT_TRUE(asset);
+  EXPECT_FALSE(asset->identity);
+  EXPECT_EQ(asset_cache::body(*asset, asset_cache::encoding_e::identity), nullptr);
+  ASSERT_NE(asset_cache::body(*asset, asset_cache::encoding_e::gzip), nullptr);
+  EXPECT_EQ(*asset_cache::body(*asset, asset_cache::encoding_e::gzip), "small");
+}
+
+TEST_F(AssetCacheTest, MissingFile) {
+  EXPECT_FALSE(asset_cache::get(dir / "missing.html"));
+  EXPECT_FALSE(asset_cache::get(dir));
+}
+
+TEST(AssetCacheHeaderTest, Negotiates) {
+  asset_cache::asset_t asset {};
+  asset.gzip = "gzip";
+  asset.br = "br";
+
+  EXPECT_EQ(asset_cache::negotiate(asset, "gzip, deflate, br, zstd"), asset_cache::encoding_e::br);
+  EXPECT_EQ(asset_cache::negotiate(asset, "gzip, deflate"), asset_cache::encoding_e::gzip);
+  EXPECT_EQ(asset_cache::negotiate(asset, "GZIP;q=0.5, br;q=0"), asset_cache::encoding_e::gzip);
+  EXPECT_EQ(asset_cache::negotiate(asset, "*"), asset_cache::encoding_e::br);
+  EXPECT_EQ(asset_cache::negotiate(asset, "identity"), asset_cache::encoding_e::identity);
+  EXPECT_EQ(asset_cache::negotiate(asset, ""), asset_cache::encoding_e::identity);
+
+  asset.br.reset();
+  EXPECT_EQ(asset_cache::negotiate(asset, "br, gzip"), asset_cache::encoding_e::gzip);
+}
+
+TEST(AssetCacheHeaderTest, NotModified) {
+  auto etag = "\"3e8-1a-br\""sv;
+  auto date = "Sun, 06 Nov 1994 08:49:37 GMT"sv;
+
+  EXPECT_TRUE(asset_cache::not_modified(etag, date, "\"3e8-1a-br\""sv, std::nullopt));
+  EXPECT_TRUE(asset_cache::not_modified(etag, date, "\"other\", W/\"3e8-1a-br\""sv, std::nullopt));
+  EXPECT_TRUE(asset_cache::not_modified(etag, date, "*"sv, std::nullopt));
+  EXPECT_FALSE(asset_cache::not_modified(etag, date, "\"3e8-1a-gzip\""sv, std::nullopt));
+
+  // If-None-Match takes precedence
+  EXPECT_FALSE(asset_cache::not_modified(etag, date, "\"3e8-1a\""sv, date));
+
+  EXPECT_TRUE(asset_cache::not_modified(etag, date, std::nullopt, date));
+  EXPECT_FALSE(asset_cache::not_modified(etag, date, std::nullopt, "Sat, 05 Nov 1994 08:49:37 GMT"sv));
+  EXPECT_FALSE(asset_cache::not_modified(etag, date, std::nullopt, std::nullopt));
+}
+
+TEST(AssetCacheHeaderTest, HttpDate) {
+  EXPECT_EQ(asset_cache::http_date(std::chrono::system_clock::time_point { 784111777s }), "Sun, 06 Nov 1994 08:49:37 GMT");
+  EXPECT_EQ(asset_cache::http_date(std::chrono::system_clock::time_point { 951782400s + 500ms }), "Tue, 29 Feb 2000 00:00:00 GMT");
+}
+
+TEST(AssetCacheHeaderTest, VariantsHaveTheirOwnTag) {
+  asset_cache::asset_t asset {};
+  asset.size = 1000;
+
+  auto identity = asset_cache::etag(asset, asset_cache::encoding_e::identity);
+  EXPECT_TRUE(identity.starts_with('"') && identity.ends_with('"'));
+  EXPECT_NE(identity, asset_cache::etag(asset, asset_cache::encoding_e::gzip));
+  EXPECT_NE(asset_cache::etag(asset, asset_cache::encoding_e::gzip), asset_cache::etag(asset, asset_cache::encoding_e::br));
+}
+
+TEST(AssetCacheHeaderTest, FingerprintedNames) {
+  EXPECT_TRUE(asset_cache::is_fingerprinted("assets/index-4f2a9B_c.js"));
+  EXPECT_TRUE(asset_cache::is_fingerprinted("assets/vue-vendor-Dx-1aB2c.js"));
+  EXPECT_TRUE(asset_cache::is_fingerprinted("assets/fonts/fa-solid-900-A1b2C3d4.woff2"));
+
+  EXPECT_FALSE(asset_cache::is_fingerprinted("assets/css/sunshine.css"));
+  EXPECT_FALSE(asset_cache::is_fingerprinted("assets/locale/en_GB.json"));
+  EXPECT_FALSE(asset_cache::is_fingerprinted("assets/vue-language.js"));
+  EXPECT_FALSE(asset_cache::is_fingerprinted("assets/-4f2a9B_c.js"));
+  EXPECT_FALSE(asset_cache::is_fingerprinted("assets/index-4f2a9B_.js"));
+}
@@ -0,0 +1,138 @@
+/**
+ * @file tests/unit/test_crypto.cpp
+ * @brief Test src/crypto.*
+ */
+#include <src/crypto.h>
+
+#include <openssl/x509v3.h>
+
+#include "../tests_common.h"
+
+namespace {
+  /**
+   * Moonlight clients pair with self-signed certificates that all have the same subject.
+   */
+  const crypto::creds_t &
+  client_creds() {
+    static const auto creds = crypto::gen_creds("NVIDIA GameStream Client", 2048);
+
+    return creds;
+  }
+
+  crypto::x509_t
+  client_cert() {
+    return crypto::x509(client_creds().x509);
+  }
+
+  crypto::x509_t
+  other_client_cert() {
+    static const auto creds = crypto::gen_creds("NVIDIA GameStream Client", 2048);
+
+    return crypto::x509(creds.x509);
+  }
+
+  /**
+   * A certificate with the key of client_cert(), but a different serial number, so a different fingerprint.
+   */
+  crypto::x509_t
+  reissued_client_cert() {
+    auto key = crypto::pkey(client_creds().pkey);
+
+    auto cert = client_cert();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 42);
+    X509_sign(cert.get(), key.get(), EVP_sha256());
+
+    return cert;
+  }
+
+  /**
+   * A client certificate that may issue other certificates, with the subject every Moonlight client uses.
+   */
+  const crypto::creds_t &
+  ca_client_creds() {
+    static const auto creds = []() {
+      auto creds = crypto::gen_creds("NVIDIA GameStream Client", 2048);
+
+      auto key = crypto::pkey(creds.pkey);
+      auto cert = crypto::x509(creds.x509);
+      X509_EXTENSION *ext = X509V3_EXT_conf_nid(nullptr, nullptr, NID_basic_constraints, "critical,CA:TRUE");
+      X509_add_ext(cert.get(), ext, -1);
+      X509_EXTENSION_free(ext);
+      X509_sign(cert.get(), key.get(), EVP_sha256());
+
+      creds.x509 = crypto::pem(cert);
+      return creds;
+    }();
+
+    return creds;
+  }
+
+  /**
+   * A certificate with a name and a key of its own, issued by the certificate of ca_client_creds().
+   */
+  crypto::x509_t
+  issued_by_client_cert() {
+    auto key = crypto::pkey(ca_client_creds().pkey);
+    auto issuer = crypto::x509(ca_client_creds().x509);
+
+    auto cert = crypto::x509(crypto::gen_creds("Moonlight Embedded", 2048).x509);
+    X509_set_issuer_name(cert.get(), X509_get_subject_name(issuer.get()));
+    X509_sign(cert.get(), key.get(), EVP_sha256());
+
+    return cert;
+  }
+}  // namespace
+
+TEST(CertChainTest, VerifiesPairedClients) {
+  crypto::cert_chain_t chain;
+  chain.add(other_client_cert());
+  chain.add(client_cert());
+
+  auto cert = client_cert();
+  EXPECT_EQ(chain.verify_safe(cert.get()), nullptr);
+  EXPECT_EQ(chain.verify(cert.get()), nullptr);
+
+  auto other = other_client_cert();
+  EXPECT_EQ(chain.verify_safe(other.get()), nullptr);
+  EXPECT_EQ(chain.verify(other.get()), nullptr);
+}
+
+TEST(CertChainTest, RejectsUnknownClients) {
+  crypto::cert_chain_t chain;
+  EXPECT_NE(chain.verify_safe(client_cert().get()), nullptr);
+  EXPECT_NE(chain.verify_safe(nullptr), nullptr);
+
+  chain.add(other_client_cert());
+  chain.add(reissued_client_cert());
+
+  auto cert = client_cert();
+  EXPECT_NE(chain.verify_safe(cert.get()), nullptr);
+  EXPECT_NE(chain.verify(cert.get()), nullptr);
+}
+
+TEST(CertChainTest, VerifiesCertificatesIssuedByPairedClients) {
+  crypto::cert_chain_t chain;
+  chain.add(other_client_cert());
+  chain.add(client_cert());
+  chain.add(crypto::x509(ca_client_creds().x509));
+
+  // The stores before the one of the issuer reject the certificate as not issued by a CA
+  auto cert = issued_by_client_cert();
+  EXPECT_EQ(chain.verify(cert.get()), nullptr);
+}
+
+TEST(CertChainTest, ClearForgetsClients) {
+  crypto::cert_chain_t chain;
+  chain.add(client_cert());
+
+  auto cert = client_cert();
+  ASSERT_EQ(chain.verify_safe(cert.get()), nullptr);
+
+  chain.clear();
+  EXPECT_NE(chain.verify_safe(cert.get()), nullptr);
+
+  // Indices of the certificates start over
+  chain.add(other_client_cert());
+  chain.add(client_cert());
+  EXPECT_EQ(chain.verify_safe(cert.get()), nullptr);
+}
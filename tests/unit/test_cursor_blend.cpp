@@ -0,0 +1,80 @@
+/**
+ * @file tests/unit/test_cursor_blend.cpp
+ * @brief Test src/cursor_blend.*
+ */
+#include <src/cursor_blend.h>
+
+#include <random>
+
+#include "../tests_common.h"
+
+TEST(CursorBlendTests, BlendRowMatchesScalar) {
+  std::mt19937 rng { 42 };
+
+  // Cover every remainder of the SIMD loops
+  for (int count = 0; count < 40; ++count) {
+    std::vector<std::uint32_t> src(count);
+    std::vector<std::uint32_t> dst(count);
+
+    for (auto &pixel : src) {
+      pixel = rng();
+    }
+    for (auto &pixel : dst) {
+      pixel = rng();
+    }
+    if (count > 2) {
+      src[0] = 0;
+      src[1] |= 0xFF000000;
+    }
+
+    auto expected = dst;
+    cursor_blend::blend_row_scalar(expected.data(), src.data(), count);
+    cursor_blend::blend_row(dst.data(), src.data(), count);
+
+    ASSERT_EQ(dst, expected) << "count: " << count;
+  }
+}
+
+TEST(CursorBlendTests, BlendRowAlpha) {
+  std::uint32_t dst[] { 0x00406080, 0x00406080, 0x00FFFFFF };
+  std::uint32_t src[] {
+    0xFF102030,  // Opaque replaces the destination
+    0x00000000,  // Transparent leaves the destination untouched
+    0x80000000,  // Half transparent black darkens the destination
+  };
+
+  cursor_blend::blend_row(dst, src, 3);
+
+  EXPECT_EQ(dst[0], 0xFF102030);
+  EXPECT_EQ(dst[1], 0x00406080);
+  EXPECT_EQ(dst[2], 0x807F7F7F);
+}
+
+TEST(CursorBlendTests, BlendClipsToImage) {
+  std::vector<std::uint8_t> data(8 * 8 * 4);
+
+  platf::img_t img;
+  img.data = data.data();
+  img.width = 8;
+  img.height = 8;
+  img.pixel_pitch = 4;
+  img.row_pitch = 8 * 4;
+
+  cursor_blend::sprite_t sprite;
+  sprite.width = 4;
+  sprite.height = 4;
+  sprite.pixels.resize(16, 0xFFFFFFFF);
+
+  auto rect = cursor_blend::blend(img, sprite, -2, 6);
+  EXPECT_EQ(rect, (platf::rect_t { 0, 6, 2, 2 }));
+
+  for (int y = 0; y < img.height; ++y) {
+    for (int x = 0; x < img.width; ++x) {
+      auto pixel = ((std::uint32_t *) (img.data + y * img.row_pitch))[x];
+      EXPECT_EQ(pixel, x < 2 && y >= 6 ? 0xFFFFFFFF : 0) << x << ',' << y;
+    }
+  }
+
+  rect = cursor_blend::blend(img, sprite, 8, 0);
+  EXPECT_EQ(rect.width * rect.height, 0);
+}
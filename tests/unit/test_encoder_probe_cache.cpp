@@ -0,0 +1,55 @@
+/**
+ * @file tests/unit/test_encoder_probe_cache.cpp
+ * @brief Test src/encoder_probe_cache.*
+ */
+#include <src/encoder_probe_cache.h>
+
+#include <fstream>
+
+#include "../tests_common.h"
+
+struct EncoderProbeCacheTest: testing::Test {
+  void
+  SetUp() override {
+    file = std::filesystem::temp_directory_path() / "sunshine_test_encoder_probe_cache.json";
+    video::probe_cache::invalidate(file);
+  }
+
+  void
+  TearDown() override {
+    video::probe_cache::invalidate(file);
+  }
+
+  std::filesystem::path file;
+};
+
+TEST_F(EncoderProbeCacheTest, RoundTrip) {
+  video::probe_cache::entry_t entry { "gpu|driver|ffmpeg", "nvenc", 3, 2, 0b10111, 0b11111, 0b00101 };
+  ASSERT_EQ(video::probe_cache::save(file, entry), 0);
+
+  auto loaded = video::probe_cache::load(file, entry.key);
+  ASSERT_TRUE(loaded);
+  EXPECT_EQ(loaded->key, entry.key);
+  EXPECT_EQ(loaded->encoder, entry.encoder);
+  EXPECT_EQ(loaded->hevc_mode, entry.hevc_mode);
+  EXPECT_EQ(loaded->av1_mode, entry.av1_mode);
+  EXPECT_EQ(loaded->h264, entry.h264);
+  EXPECT_EQ(loaded->hevc, entry.hevc);
+  EXPECT_EQ(loaded->av1, entry.av1);
+}
+
+TEST_F(EncoderProbeCacheTest, KeyMismatch) {
+  ASSERT_EQ(video::probe_cache::save(file, { "old driver", "vaapi", 2, 1, 1, 1, 0 }), 0);
+
+  EXPECT_FALSE(video::probe_cache::load(file, "new driver"));
+}
+
+TEST_F(EncoderProbeCacheTest, MissingOrCorrupt) {
+  EXPECT_FALSE(video::probe_cache::load(file, "key"));
+
+  std::ofstream { file } << "{ not json";
+  EXPECT_FALSE(video::probe_cache::load(file, "key"));
+
+  video::probe_cache::invalidate(file);
+  EXPECT_FALSE(std::filesystem::exists(file));
+}
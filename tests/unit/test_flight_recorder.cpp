@@ -0,0 +1,185 @@
+/**
+ * @file tests/unit/test_flight_recorder.cpp
+ * @brief Test src/flight_recorder.*
+ */
+#include <src/flight_recorder.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "../tests_common.h"
+
+namespace pt = boost::property_tree;
+
+using namespace std::literals;
+
+namespace {
+  pt::ptree
+  parse(const std::string &json) {
+    std::istringstream in { json };
+
+    pt::ptree tree;
+    pt::read_json(in, tree);
+    return tree;
+  }
+
+  flight_recorder::frame_t
+  frame(std::int64_t index) {
+    return { index, 1, 1000 + (std::size_t) index, 10, 20, 5ms, 1ms };
+  }
+}  // namespace
+
+TEST(FlightRecorderTests, ExportsEvents) {
+  auto recorder = flight_recorder::make_recorder(3, "Living \"Room\"\n", 500ms);
+
+  EXPECT_FALSE(recorder->frame_sent(frame(1)));
+  recorder->loss_report(4, 50, 1);
+  recorder->rfi_request(2, 3);
+  recorder->dynamic_param(0, 20000);
+
+  auto tree = parse(recorder->export_json("requested"));
+  EXPECT_EQ(tree.get<int>("session"), 3);
+  EXPECT_EQ(tree.get<std::string>("client"), "Living \"Room\"\n");
+  EXPECT_EQ(tree.get<std::string>("reason"), "requested");
+
+  std::vector<pt::ptree> events;
+  for (auto &[_, event] : tree.get_child("events")) {
+    events.push_back(event);
+  }
+  ASSERT_EQ(events.size(), 4);
+
+  EXPECT_EQ(events[0].get<std::string>("type"), "frame");
+  EXPECT_EQ(events[0].get<int>("frame"), 1);
+  EXPECT_EQ(events[0].get<int>("bytes"), 1001);
+  EXPECT_EQ(events[0].get<int>("fec_percentage"), 20);
+  EXPECT_DOUBLE_EQ(events[0].get<double>("processing_ms"), 5);
+  EXPECT_DOUBLE_EQ(events[0].get<double>("pacing_ms"), 1);
+  EXPECT_LE(events[0].get<double>("t"), 0);
+
+  EXPECT_EQ(events[1].get<std::string>("type"), "loss_report");
+  EXPECT_EQ(events[1].get<int>("lost_packets"), 4);
+  EXPECT_EQ(events[2].get<std::string>("type"), "rfi_request");
+  EXPECT_EQ(events[2].get<int>("last_frame"), 3);
+  EXPECT_EQ(events[3].get<std::string>("type"), "dynamic_param");
+  EXPECT_EQ(events[3].get<int>("value"), 20000);
+}
+
+TEST(FlightRecorderTests, KeepsNewestEvents) {
+  auto recorder = flight_recorder::make_recorder(1, "client", 0ms);
+
+  constexpr int total = flight_recorder::recorder_t::ring_size * 3 + 5;
+  for (int x = 0; x < total; ++x) {
+    recorder->frame_sent(frame(x));
+  }
+
+  auto tree = parse(recorder->export_json("requested"));
+  auto &events = tree.get_child("events");
+  EXPECT_EQ(events.size(), flight_recorder::recorder_t::ring_size);
+  EXPECT_EQ(events.back().second.get<int>("frame"), total - 1);
+}
+
+TEST(FlightRecorderTests, DetectsStalls) {
+  auto recorder = flight_recorder::make_recorder(1, "client", 20ms);
+
+  EXPECT_FALSE(recorder->frame_sent(frame(1)));
+  EXPECT_FALSE(recorder->frame_sent(frame(2)));
+
+  std::this_thread::sleep_for(30ms);
+  auto reason = recorder->frame_sent(frame(3));
+  ASSERT_TRUE(reason);
+  EXPECT_NE(reason->find("frame gap"), std::string::npos);
+
+  // Automatic dumps are rate limited
+  std::this_thread::sleep_for(30ms);
+  EXPECT_FALSE(recorder->frame_sent(frame(4)));
+  EXPECT_FALSE(recorder->ping_timeout());
+}
+
+TEST(FlightRecorderTests, DetectsIdrStorms) {
+  auto recorder = flight_recorder::make_recorder(1, "client", 500ms);
+
+  EXPECT_FALSE(recorder->idr_request());
+  EXPECT_FALSE(recorder->idr_request());
+  EXPECT_TRUE(recorder->idr_request());
+
+  auto disabled = flight_recorder::make_recorder(2, "client", 0ms);
+  disabled->idr_request();
+  disabled->idr_request();
+  EXPECT_FALSE(disabled->idr_request());
+  EXPECT_FALSE(disabled->ping_timeout());
+}
+
+TEST(FlightRecorderTests, ExportsRunningSessions) {
+  auto first = flight_recorder::make_recorder(11, "first", 500ms);
+  auto second = flight_recorder::make_recorder(12, "second", 500ms);
+  second.reset();
+
+  auto tree = parse(flight_recorder::export_all_json());
+
+  std::vector<int> sessions;
+  for (auto &[_, session] : tree.get_child("sessions")) {
+    sessions.push_back(session.get<int>("session"));
+  }
+
+  EXPECT_NE(std::find(sessions.begin(), sessions.end(), 11), sessions.end());
+  EXPECT_EQ(std::find(sessions.begin(), sessions.end(), 12), sessions.end());
+}
+
+TEST(FlightRecorderTests, WritesDumps) {
+  auto directory = std::filesystem::temp_directory_path() / "sunshine_test_flight_recorder";
+  std::filesystem::remove_all(directory);
+
+  auto recorder = flight_recorder::make_recorder(5, "client", 500ms);
+  recorder->frame_sent(frame(1));
+
+  auto path = flight_recorder::write_dump(*recorder, "ping timeout", directory);
+  ASSERT_FALSE(path.empty());
+
+  std::ifstream file { path };
+  std::stringstream json;
+  json << file.rdbuf();
+  EXPECT_EQ(parse(json.str()).get<std::string>("reason"), "ping timeout");
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST(FlightRecorderTests, ExportWhileRecording) {
+  auto recorder = flight_recorder::make_recorder(1, "client", 0ms);
+
+  std::atomic_bool done = false;
+  std::thread frames { [&]() {
+    for (int x = 0; !done; ++x) {
+      recorder->frame_sent(frame(x));
+    }
+  } };
+  std::thread control { [&]() {
+    for (int x = 0; !done; ++x) {
+      recorder->rfi_request(x, x + 1);
+    }
+  } };
+
+  for (int x = 0; x < 2; ++x) {
+    auto tree = parse(recorder->export_json("requested"));
+    for (auto &[_, event] : tree.get_child("events")) {
+      // Torn events would mix up the fields of different events
+      if (event.get<std::string>("type") == "frame") {
+        EXPECT_EQ(event.get<int>("bytes"), 1000 + event.get<int>("frame"));
+      }
+      else {
+        EXPECT_EQ(event.get<int>("last_frame"), event.get<int>("first_frame") + 1);
+      }
+    }
+  }
+
+  done = true;
+  frames.join();
+  control.join();
+}
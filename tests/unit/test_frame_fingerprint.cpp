@@ -0,0 +1,56 @@
+/**
+ * @file tests/unit/test_frame_fingerprint.cpp
+ * @brief Test src/frame_fingerprint.*
+ */
+#include <src/frame_fingerprint.h>
+
+#include <random>
+#include <vector>
+
+#include "../tests_common.h"
+
+namespace {
+  constexpr int width = 101;
+  constexpr int height = 17;
+  constexpr int row_pitch = width * 4 + 12;
+
+  std::vector<std::uint8_t>
+  random_image() {
+    std::mt19937 rng { 99 };
+
+    std::vector<std::uint8_t> image(row_pitch * height);
+    for (auto &byte : image) {
+      byte = rng();
+    }
+
+    return image;
+  }
+}  // namespace
+
+TEST(FrameFingerprintTests, SimdMatchesScalar) {
+  auto image = random_image();
+
+  for (auto row_size : { 0, 4, 28, 32, 36, width * 4 }) {
+    EXPECT_EQ(video::frame_fingerprint(image.data(), row_pitch, row_size, height, true), video::frame_fingerprint(image.data(), row_pitch, row_size, height, false)) << row_size;
+  }
+}
+
+TEST(FrameFingerprintTests, DetectsChanges) {
+  auto image = random_image();
+  auto fingerprint = video::frame_fingerprint(image.data(), row_pitch, width * 4, height);
+
+  // Padding at the end of the rows is ignored
+  image[width * 4] ^= 1;
+  EXPECT_EQ(video::frame_fingerprint(image.data(), row_pitch, width * 4, height), fingerprint);
+
+  for (auto offset : { 0, 31, 32, row_pitch * 5 + 200, row_pitch * (height - 1) + width * 4 - 1 }) {
+    auto changed = image;
+    changed[offset] ^= 0x10;
+    EXPECT_NE(video::frame_fingerprint(changed.data(), row_pitch, width * 4, height), fingerprint) << offset;
+  }
+
+  // Rows trading places
+  auto swapped = image;
+  std::swap_ranges(swapped.begin(), swapped.begin() + row_pitch, swapped.begin() + row_pitch);
+  EXPECT_NE(video::frame_fingerprint(swapped.data(), row_pitch, width * 4, height), fingerprint);
+}
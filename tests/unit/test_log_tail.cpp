@@ -0,0 +1,149 @@
+/**
+ * @file tests/unit/test_log_tail.cpp
+ * @brief Test src/log_tail.*
+ */
+#include <src/log_tail.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "../tests_common.h"
+
+namespace {
+  class LogTailTest: public testing::Test {
+  protected:
+    void
+    SetUp() override {
+      path = std::filesystem::temp_directory_path() / "sunshine_test_log_tail.log";
+      std::filesystem::remove(path);
+    }
+
+    void
+    TearDown() override {
+      std::filesystem::remove(path);
+    }
+
+    void
+    append(std::string_view text) {
+      std::ofstream file { path, std::ios::binary | std::ios::app };
+      file << text;
+    }
+
+    std::filesystem::path path;
+  };
+}  // namespace
+
+TEST_F(LogTailTest, ReadsNewCompleteLines) {
+  append("[2024-01-01 12:00:00.000]: Info: first\n[2024-01-01 12:00:00.001]: Info: second\n[2024-01-01 12:00:00.002]: Info: thi");
+
+  auto chunk = log_tail::read(path, { 0 });
+  ASSERT_TRUE(chunk);
+  EXPECT_EQ(chunk->lines, (std::vector<std::string> { "[2024-01-01 12:00:00.000]: Info: first", "[2024-01-01 12:00:00.001]: Info: second" }));
+  EXPECT_FALSE(chunk->reset);
+  EXPECT_LT(chunk->end, chunk->size);
+
+  append("rd\n");
+  chunk = log_tail::read(path, { chunk->end });
+  ASSERT_TRUE(chunk);
+  EXPECT_EQ(chunk->lines, (std::vector<std::string> { "[2024-01-01 12:00:00.002]: Info: third" }));
+  EXPECT_EQ(chunk->end, chunk->size);
+
+  chunk = log_tail::read(path, { chunk->end });
+  ASSERT_TRUE(chunk);
+  EXPECT_TRUE(chunk->lines.empty());
+  EXPECT_EQ(chunk->begin, chunk->end);
+}
+
+TEST_F(LogTailTest, StartsAtTheLastLines) {
+  std::string line(99, 'x');
+  std::string log;
+  for (std::uint64_t x = 0; x < log_tail::max_chunk / 100 * 3; ++x) {
+    log += line + "\n";
+  }
+  append(log + "[2024-01-01 12:00:00.000]: Info: last\n");
+
+  auto chunk = log_tail::read(path, {});
+  ASSERT_TRUE(chunk);
+  EXPECT_GT(chunk->begin, 0);
+  EXPECT_EQ(chunk->end, chunk->size);
+  EXPECT_EQ(chunk->lines.front(), line);
+  EXPECT_EQ(chunk->lines.back(), "[2024-01-01 12:00:00.000]: Info: last");
+
+  // Reading from the start takes a few chunks
+  chunk = log_tail::read(path, { 0 });
+  ASSERT_TRUE(chunk);
+  EXPECT_EQ(chunk->end, log_tail::max_chunk / 100 * 100);
+}
+
+TEST_F(LogTailTest, FiltersLevelAndText) {
+  append(
+    "[2024-01-01 12:00:00.000]: Debug: packet\n"
+    "[2024-01-01 12:00:00.001]: Warning: stall\n"
+    "continued\n"
+    "[2024-01-01 12:00:00.002]: Error: stall again\n"
+    "[2024-01-01 12:00:00.003]: Info: stall over\n");
+
+  auto chunk = log_tail::read(path, { 0, 3 });
+  ASSERT_TRUE(chunk);
+  EXPECT_EQ(chunk->lines, (std::vector<std::string> {
+                            "[2024-01-01 12:00:00.001]: Warning: stall",
+                            "continued",
+                            "[2024-01-01 12:00:00.002]: Error: stall again",
+                          }));
+
+  chunk = log_tail::read(path, { 0, 0, "stall" });
+  ASSERT_TRUE(chunk);
+  EXPECT_EQ(chunk->lines.size(), 3);
+  EXPECT_EQ(chunk->end, chunk->size);
+}
+
+TEST_F(LogTailTest, StartsOverWhenTheLogIsTruncated) {
+  append("[2024-01-01 12:00:00.000]: Info: old log\n");
+  auto offset = log_tail::read(path, { 0 })->end;
+
+  std::filesystem::remove(path);
+  append("new\n");
+
+  auto chunk = log_tail::read(path, { offset });
+  ASSERT_TRUE(chunk);
+  EXPECT_TRUE(chunk->reset);
+  EXPECT_EQ(chunk->lines, (std::vector<std::string> { "new" }));
+}
+
+TEST_F(LogTailTest, MissingLog) {
+  EXPECT_FALSE(log_tail::read(path, {}));
+}
+
+TEST(LogTailRangeTest, ParsesRanges) {
+  auto range = log_tail::parse_range("bytes=10-19", 100);
+  ASSERT_TRUE(range);
+  EXPECT_EQ(range->begin, 10);
+  EXPECT_EQ(range->end, 20);
+
+  range = log_tail::parse_range("bytes=90-", 100);
+  ASSERT_TRUE(range);
+  EXPECT_EQ(range->begin, 90);
+  EXPECT_EQ(range->end, 100);
+
+  range = log_tail::parse_range("bytes=-30", 100);
+  ASSERT_TRUE(range);
+  EXPECT_EQ(range->begin, 70);
+  EXPECT_EQ(range->end, 100);
+
+  range = log_tail::parse_range("bytes=50-1000", 100);
+  ASSERT_TRUE(range);
+  EXPECT_EQ(range->end, 100);
+
+  EXPECT_FALSE(log_tail::parse_range("bytes=100-", 100));
+  EXPECT_FALSE(log_tail::parse_range("bytes=20-10", 100));
+  EXPECT_FALSE(log_tail::parse_range("bytes=0-1,5-6", 100));
+  EXPECT_FALSE(log_tail::parse_range("items=0-1", 100));
+  EXPECT_FALSE(log_tail::parse_range("bytes=x-", 100));
+}
+
+TEST(LogTailRangeTest, LineLevels) {
+  EXPECT_EQ(log_tail::line_level("[2024-01-01 12:00:00.000]: Verbose: x"), 0);
+  EXPECT_EQ(log_tail::line_level("[2024-01-01 12:00:00.000]: Fatal: x"), 5);
+  EXPECT_FALSE(log_tail::line_level("continued"));
+  EXPECT_FALSE(log_tail::line_level("[2024-01-01 12:00:00.000]: Tests: x"));
+}
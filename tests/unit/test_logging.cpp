@@ -8,6 +8,8 @@
 #include "../tests_log_checker.h"
 
 #include <random>
+#include <thread>
+#include <utility>
 
 namespace {
   std::array log_levels = {
@@ -20,6 +22,24 @@ namespace {
   };
 
   constexpr auto log_file = "test_sunshine.log";
+
+  // More numbers than fit in a record
+  constexpr std::size_t many_args = binary_log::max_record_size / 8;
+
+  constexpr auto many_args_text = []() {
+    std::array<char, 20 + many_args * 3> text {};
+    std::string_view prefix = "Binary truncated {}";
+    std::copy(std::begin(prefix), std::end(prefix), std::begin(text));
+    for (std::size_t x = 0; x < many_args; ++x) {
+      text[prefix.size() + x * 3] = ' ';
+      text[prefix.size() + x * 3 + 1] = '{';
+      text[prefix.size() + x * 3 + 2] = '}';
+    }
+
+    return text;
+  }();
+
+  constexpr std::string_view many_args_format { many_args_text.data(), many_args_text.size() - 1 };
 }  // namespace
 
 struct LogLevelsTest: testing::TestWithParam<decltype(log_levels)::value_type> {};
@@ -42,3 +62,59 @@ TEST_P(LogLevelsTest, PutMessage) {
 
   ASSERT_TRUE(log_checker::line_contains(log_file, test_message));
 }
+
+TEST(BinaryLogTests, FormatsArguments) {
+  auto id = std::to_string(std::random_device {}());
+
+  BINARY_LOG(debug, "Binary {} :: {} {} {} {}{}", id, -5, 7u, 1.5, "text", '!');
+
+  ASSERT_TRUE(log_checker::line_equals(log_file, "Debug: Binary " + id + " :: -5 7 1.5 text!"));
+}
+
+TEST(BinaryLogTests, VerboseIsCompiledOut) {
+  auto id = std::to_string(std::random_device {}());
+
+  BINARY_LOG(verbose, "Binary verbose {}", id);
+
+  ASSERT_EQ(log_checker::line_contains(log_file, "Verbose: Binary verbose " + id), SUNSHINE_LOG_MIN_LEVEL == 0);
+}
+
+TEST(BinaryLogTests, CutsOffLongStrings) {
+  auto id = std::to_string(std::random_device {}());
+
+  BINARY_LOG(info, "Binary long {} {}", std::string(binary_log::max_record_size * 2, 'x'), id);
+
+  ASSERT_TRUE(log_checker::line_ends_with(log_file, "x " + id));
+}
+
+TEST(BinaryLogTests, TruncatesTooManyArguments) {
+  auto id = std::random_device {}();
+
+  [id]<std::size_t... I>(std::index_sequence<I...>) {
+    BINARY_LOG(info, many_args_format, id, ((void) I, 7)...);
+  }(std::make_index_sequence<many_args> {});
+
+  ASSERT_TRUE(log_checker::line_contains(log_file, "Info: Binary truncated " + std::to_string(id) + " 7 7"));
+  ASSERT_TRUE(log_checker::line_ends_with(log_file, "[truncated, the arguments exceed 1024 bytes]"));
+}
+
+TEST(BinaryLogTests, InterleavesThreads) {
+  auto id = std::to_string(std::random_device {}());
+
+  std::vector<std::thread> threads;
+  for (int x = 0; x < 4; ++x) {
+    threads.emplace_back([&id, x]() {
+      for (int y = 0; y < 100; ++y) {
+        BINARY_LOG(info, "Binary {} thread {} line {}", id, x, y);
+      }
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (int x = 0; x < 4; ++x) {
+    EXPECT_TRUE(log_checker::line_equals(log_file, "Info: Binary " + id + " thread " + std::to_string(x) + " line 99"));
+  }
+}
@@ -0,0 +1,131 @@
+/**
+ * @file tests/unit/test_metrics.cpp
+ * @brief Test src/metrics.*
+ */
+#include <src/metrics.h>
+#include <src/thread_safe.h>
+
+#include <thread>
+#include <vector>
+
+#include "../tests_common.h"
+
+using namespace std::literals;
+
+namespace {
+  /**
+   * @return The value of the sample with exactly this name and labels, or an empty string.
+   */
+  std::string
+  sample(const std::string &exported, const std::string &series) {
+    auto pos = exported.find('\n' + series + ' ');
+    if (pos == std::string::npos) {
+      return {};
+    }
+
+    pos += series.size() + 2;
+    return exported.substr(pos, exported.find('\n', pos) - pos);
+  }
+}  // namespace
+
+TEST(MetricsTests, HistogramMerges) {
+  metrics::histogram_t histogram;
+  histogram.observe(300us);
+  histogram.observe(5s);
+  histogram.observe(-1ms);
+
+  EXPECT_EQ(histogram.microseconds().count(), 3);
+  EXPECT_EQ(histogram.microseconds().min(), 0);
+  EXPECT_EQ(histogram.microseconds().max(), 5000000);
+
+  metrics::histogram_t merged;
+  merged.merge(histogram);
+  merged.merge(histogram);
+  EXPECT_EQ(merged.microseconds().count(), 6);
+  EXPECT_EQ(merged.microseconds().sum(), 2 * histogram.microseconds().sum());
+}
+
+TEST(MetricsTests, ExportsRunningSessions) {
+  auto session = metrics::make_session(42, "Living \"Room\"");
+  session->frames_sent.add(3);
+  session->pacing_sleep_ns.add(1500000);
+  session->rtt_ms.set(12);
+  session->encode_latency.observe(3ms);
+
+  auto exported = metrics::export_prometheus();
+  const std::string labels = R"({session="42",client="Living \"Room\""})";
+
+  EXPECT_EQ(sample(exported, "sunshine_session_frames_sent_total" + labels), "3");
+  EXPECT_EQ(sample(exported, "sunshine_session_pacing_sleep_seconds_total" + labels), "0.001500");
+  EXPECT_EQ(sample(exported, "sunshine_session_rtt_seconds" + labels), "0.012000");
+  EXPECT_EQ(sample(exported, R"(sunshine_session_encode_latency_seconds_bucket{session="42",client="Living \"Room\"",le="0.002000"})"), "0");
+  EXPECT_EQ(sample(exported, R"(sunshine_session_encode_latency_seconds_bucket{session="42",client="Living \"Room\"",le="0.004000"})"), "1");
+  EXPECT_EQ(sample(exported, R"(sunshine_session_encode_latency_seconds_bucket{session="42",client="Living \"Room\"",le="+Inf"})"), "1");
+  EXPECT_EQ(sample(exported, "sunshine_session_encode_latency_seconds_sum" + labels), "0.003000");
+  EXPECT_EQ(sample(exported, "sunshine_session_encode_latency_seconds_count" + labels), "1");
+  EXPECT_NE(exported.find("# TYPE sunshine_session_encode_latency_seconds histogram\n"), std::string::npos);
+}
+
+TEST(MetricsTests, TotalsKeepEndedSessions) {
+  auto before = std::stoull(sample(metrics::export_prometheus(), "sunshine_input_events_total"));
+
+  auto session = metrics::make_session(7, "client");
+  session->input_events.add(5);
+
+  auto exported = metrics::export_prometheus();
+  EXPECT_EQ(std::stoull(sample(exported, "sunshine_input_events_total")), before + 5);
+  EXPECT_EQ(sample(exported, R"(sunshine_session_input_events_total{session="7",client="client"})"), "5");
+
+  session.reset();
+
+  exported = metrics::export_prometheus();
+  EXPECT_EQ(std::stoull(sample(exported, "sunshine_input_events_total")), before + 5);
+  EXPECT_EQ(sample(exported, R"(sunshine_session_input_events_total{session="7",client="client"})"), "");
+}
+
+TEST(MetricsTests, CountsQueueDrops) {
+  auto before = safe::dropped_elements.load();
+
+  safe::queue_t<int> queue { 2 };
+  queue.raise(1);
+  queue.raise(2);
+  queue.raise(3);
+
+  EXPECT_EQ(safe::dropped_elements.load() - before, 2);
+  EXPECT_EQ(sample(metrics::export_prometheus(), "sunshine_queue_dropped_elements_total"), std::to_string(safe::dropped_elements.load()));
+}
+
+TEST(MetricsTests, ExportWhileCounting) {
+  auto session = metrics::make_session(1, "client");
+
+  std::atomic_bool done = false;
+  std::thread writer { [&]() {
+    while (!done) {
+      session->frames_sent.add();
+      session->frame_processing_latency.observe(1ms);
+    }
+  } };
+
+  for (int x = 0; x < 20; ++x) {
+    metrics::export_prometheus();
+  }
+
+  done = true;
+  writer.join();
+
+  auto exported = metrics::export_prometheus();
+  EXPECT_EQ(sample(exported, R"(sunshine_session_frames_sent_total{session="1",client="client"})"), std::to_string(session->frames_sent.get()));
+}
+
+TEST(MetricsTests, ExportsStreamStartup) {
+  auto before = std::stoull(sample(metrics::export_prometheus(), "sunshine_warm_encoders_reused_total"));
+
+  metrics::global.warm_encoders_reused.add();
+  metrics::global.time_to_first_frame.observe(250ms);
+
+  auto exported = metrics::export_prometheus();
+  EXPECT_EQ(std::stoull(sample(exported, "sunshine_warm_encoders_reused_total")), before + 1);
+  EXPECT_GE(std::stoull(sample(exported, "sunshine_time_to_first_frame_seconds_count")), 1);
+  EXPECT_GE(std::stoull(sample(exported, R"(sunshine_time_to_first_frame_seconds_bucket{le="0.250000"})")), 1);
+  EXPECT_NE(exported.find("# TYPE sunshine_time_to_first_frame_seconds histogram\n"), std::string::npos);
+}
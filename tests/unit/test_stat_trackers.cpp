@@ -0,0 +1,162 @@
+/**
+ * @file tests/unit/test_stat_trackers.cpp
+ * @brief Test src/stat_trackers.*
+ */
+#include <src/stat_trackers.h>
+
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../tests_common.h"
+
+using stat_trackers::hdr_histogram;
+
+TEST(HdrHistogramTests, SmallValuesAreExact) {
+  for (std::uint64_t value = 0; value < hdr_histogram::sub_bucket_count; ++value) {
+    EXPECT_EQ(hdr_histogram::highest_equivalent_value(hdr_histogram::bucket_index(value)), value);
+  }
+}
+
+TEST(HdrHistogramTests, BucketsKeepRelativePrecision) {
+  std::size_t last_index = 0;
+  for (std::uint64_t value = 1; value < hdr_histogram::max_value; value = value * 3 / 2 + 1) {
+    auto index = hdr_histogram::bucket_index(value);
+    ASSERT_LT(index, hdr_histogram::bucket_count);
+    EXPECT_GE(index, last_index);
+    last_index = index;
+
+    auto highest = hdr_histogram::highest_equivalent_value(index);
+    EXPECT_GE(highest, value);
+    EXPECT_LE(highest - value, value / 64);
+    EXPECT_EQ(hdr_histogram::bucket_index(highest), index);
+    EXPECT_EQ(hdr_histogram::bucket_index(highest + 1), index + 1);
+  }
+
+  EXPECT_EQ(hdr_histogram::bucket_index(hdr_histogram::max_value), hdr_histogram::bucket_count - 1);
+  EXPECT_EQ(hdr_histogram::bucket_index(std::numeric_limits<std::uint64_t>::max()), hdr_histogram::bucket_count - 1);
+}
+
+TEST(HdrHistogramTests, Percentiles) {
+  hdr_histogram histogram;
+  EXPECT_EQ(histogram.percentile(50), 0);
+
+  // One stall among a thousand fast frames is invisible in the mean, but not in p99.9
+  for (int x = 0; x < 999; ++x) {
+    histogram.record(2000 + x % 10);
+  }
+  histogram.record(40000);
+
+  EXPECT_EQ(histogram.count(), 1000);
+  EXPECT_EQ(histogram.min(), 2000);
+  EXPECT_EQ(histogram.max(), 40000);
+  EXPECT_NEAR(histogram.mean(), 2042, 1);
+  EXPECT_NEAR(histogram.percentile(50), 2005, 2005 / 64);
+  EXPECT_NEAR(histogram.percentile(99), 2009, 2009 / 64);
+  EXPECT_NEAR(histogram.percentile(99.9), 2009, 2009 / 64);
+  EXPECT_EQ(histogram.percentile(100), 40000);
+
+  histogram.reset();
+  EXPECT_EQ(histogram.count(), 0);
+  EXPECT_EQ(histogram.min(), 0);
+  EXPECT_EQ(histogram.max(), 0);
+}
+
+TEST(HdrHistogramTests, PercentilesOfRepeatedValuesAreExact) {
+  hdr_histogram histogram;
+  for (int x = 0; x < 100; ++x) {
+    histogram.record(1000);
+    histogram.record(6000);
+  }
+  histogram.record(1007);
+  histogram.record(100000);
+
+  // 1000 and 1007 share a bucket, they aren't reported as the highest value of the bucket
+  EXPECT_EQ(histogram.percentile(25), 1000);
+  EXPECT_EQ(histogram.percentile(75), 6000);
+  EXPECT_EQ(histogram.percentile(100), 100000);
+}
+
+TEST(HdrHistogramTests, CountsAtOrBelow) {
+  hdr_histogram histogram;
+  histogram.record(300);
+  histogram.record(1000);
+  histogram.record(10000);
+  histogram.record(5000000);
+
+  EXPECT_EQ(histogram.count_at_or_below(0), 0);
+  EXPECT_EQ(histogram.count_at_or_below(500), 1);
+  EXPECT_EQ(histogram.count_at_or_below(1000), 2);
+  EXPECT_EQ(histogram.count_at_or_below(1000000), 3);
+  EXPECT_EQ(histogram.count_at_or_below(hdr_histogram::max_value), 4);
+}
+
+TEST(HdrHistogramTests, MergeMatchesRecordingEverything) {
+  std::mt19937_64 rng { 1 };
+  std::lognormal_distribution<double> latency { 8, 1 };
+
+  hdr_histogram all, first, second;
+  for (int x = 0; x < 10000; ++x) {
+    auto value = (std::uint64_t) latency(rng);
+    all.record(value);
+    (x % 3 ? first : second).record(value);
+  }
+
+  first.merge(second);
+  EXPECT_EQ(first.count(), all.count());
+  EXPECT_EQ(first.sum(), all.sum());
+  EXPECT_EQ(first.min(), all.min());
+  EXPECT_EQ(first.max(), all.max());
+  for (auto percentile : { 50.0, 90.0, 99.0, 99.9 }) {
+    EXPECT_EQ(first.percentile(percentile), all.percentile(percentile));
+  }
+}
+
+TEST(HdrHistogramTests, ConcurrentRecording) {
+  hdr_histogram histogram;
+
+  std::vector<std::thread> threads;
+  for (int x = 0; x < 4; ++x) {
+    threads.emplace_back([&histogram, x]() {
+      for (std::uint64_t value = 1; value <= 10000; ++value) {
+        histogram.record(value * (x + 1));
+      }
+    });
+  }
+
+  for (int x = 0; x < 10; ++x) {
+    histogram.percentile(99);
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(histogram.count(), 40000);
+  EXPECT_EQ(histogram.min(), 1);
+  EXPECT_EQ(histogram.max(), 40000);
+}
+
+TEST(PercentileTrackerTests, CallsBackWithPercentilesOfInterval) {
+  stat_trackers::percentile_tracker<double> tracker;
+
+  int calls = 0;
+  auto callback = [&](const stat_trackers::percentile_tracker<double> &stats) {
+    ++calls;
+    EXPECT_DOUBLE_EQ(stats.min(), 0.5);
+    EXPECT_DOUBLE_EQ(stats.max(), 1.25);
+    EXPECT_DOUBLE_EQ(stats.percentile(50), 0.5);
+    EXPECT_DOUBLE_EQ(stats.percentile(99.9), 1.25);
+    EXPECT_NEAR(stats.mean(), (0.5 * 3 + 1.25) / 4, 0.001);
+  };
+
+  tracker.collect_and_callback_on_interval(0.5, callback, std::chrono::seconds { 0 });
+  tracker.collect_and_callback_on_interval(0.5, callback, std::chrono::seconds { 3600 });
+  tracker.collect_and_callback_on_interval(0.5, callback, std::chrono::seconds { 3600 });
+  tracker.collect_and_callback_on_interval(1.25, callback, std::chrono::seconds { 3600 });
+  EXPECT_EQ(calls, 0);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds { 5 });
+  tracker.collect_and_callback_on_interval(3, callback, std::chrono::seconds { 0 });
+  EXPECT_EQ(calls, 1);
+}
@@ -0,0 +1,214 @@
+/**
+ * @file tests/unit/test_trace.cpp
+ * @brief Test src/trace.*
+ */
+#include <src/trace.h>
+
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "../tests_common.h"
+
+namespace pt = boost::property_tree;
+
+namespace {
+  struct event_t {
+    std::string name;
+    std::string phase;
+    int tid;
+    double ts;
+    double dur;
+    int frame;
+  };
+
+  std::vector<event_t>
+  export_events() {
+    std::istringstream json { trace::export_chrome_json() };
+
+    pt::ptree tree;
+    pt::read_json(json, tree);
+
+    std::vector<event_t> events;
+    for (auto &[_, event] : tree.get_child("traceEvents")) {
+      events.push_back({
+        event.get<std::string>("name"),
+        event.get<std::string>("ph"),
+        event.get<int>("tid"),
+        event.get<double>("ts", 0),
+        event.get<double>("dur", 0),
+        event.get<int>("args.frame", -1),
+      });
+    }
+
+    return events;
+  }
+
+  std::size_t
+  count(const std::vector<event_t> &events, const std::string &name) {
+    return std::count_if(events.begin(), events.end(), [&](const event_t &event) {
+      return event.name == name;
+    });
+  }
+}  // namespace
+
+TEST(TraceTests, RecordsOnlyWhileActive) {
+  trace::stop();
+  trace::record("before", 1, trace::clock::now(), trace::clock::now());
+
+  trace::start();
+  {
+    trace::scope_t scope { "during", 2 };
+  }
+  trace::stop();
+
+  trace::record("after", 3, trace::clock::now(), trace::clock::now());
+
+  auto events = export_events();
+  EXPECT_EQ(count(events, "before"), 0);
+  EXPECT_EQ(count(events, "during"), 1);
+  EXPECT_EQ(count(events, "after"), 0);
+}
+
+TEST(TraceTests, ExportsStagesOfNamedThreads) {
+  trace::start();
+
+  std::thread { []() {
+    trace::name_thread("worker \"1\"\t");
+
+    auto begin = trace::clock::now();
+    trace::record("stage", 7, begin, begin + std::chrono::microseconds { 1500 });
+  } }.join();
+
+  trace::stop();
+
+  auto events = export_events();
+
+  auto stage = std::find_if(events.begin(), events.end(), [](const event_t &event) {
+    return event.name == "stage";
+  });
+  ASSERT_NE(stage, events.end());
+  EXPECT_EQ(stage->phase, "X");
+  EXPECT_EQ(stage->frame, 7);
+  EXPECT_NEAR(stage->dur, 1500, 0.001);
+  EXPECT_GE(stage->ts, 0);
+
+  // The metadata event names the thread that recorded the stage
+  std::istringstream json { trace::export_chrome_json() };
+  pt::ptree tree;
+  pt::read_json(json, tree);
+
+  bool named = false;
+  for (auto &[_, event] : tree.get_child("traceEvents")) {
+    if (event.get<std::string>("ph") == "M" && event.get<int>("tid") == stage->tid) {
+      EXPECT_EQ(event.get<std::string>("args.name"), "worker \"1\"\t");
+      named = true;
+    }
+  }
+  EXPECT_TRUE(named);
+}
+
+TEST(TraceTests, DeferredStagesStayOnTheirThread) {
+  trace::stop();
+  EXPECT_EQ(trace::now(), trace::clock::time_point {});
+  EXPECT_EQ(trace::defer("ignored", trace::clock::now(), trace::clock::now()).name, nullptr);
+
+  trace::start();
+
+  // The trace started while the stage ran
+  trace::record("partial", 1, trace::clock::time_point {}, trace::now());
+
+  trace::deferred_t stage;
+  std::thread { [&]() {
+    trace::name_thread("capture");
+
+    auto begin = trace::now();
+    stage = trace::defer("capture", begin, begin + std::chrono::microseconds { 250 });
+  } }.join();
+
+  trace::record(stage, 5);
+  trace::record("encode", 5, trace::now(), trace::now());
+  trace::stop();
+
+  auto events = export_events();
+  EXPECT_EQ(count(events, "partial"), 0);
+
+  auto capture = std::find_if(events.begin(), events.end(), [](const event_t &event) {
+    return event.name == "capture";
+  });
+  auto encode = std::find_if(events.begin(), events.end(), [](const event_t &event) {
+    return event.name == "encode";
+  });
+  ASSERT_NE(capture, events.end());
+  ASSERT_NE(encode, events.end());
+  EXPECT_EQ(capture->frame, 5);
+  EXPECT_NEAR(capture->dur, 250, 0.001);
+  EXPECT_NE(capture->tid, encode->tid);
+}
+
+TEST(TraceTests, StartDiscardsPreviousTrace) {
+  trace::start();
+  trace::record("old", -1, trace::clock::now(), trace::clock::now());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+  trace::start();
+  trace::record("new", -1, trace::clock::now(), trace::clock::now());
+  trace::stop();
+
+  auto events = export_events();
+  EXPECT_EQ(count(events, "old"), 0);
+  EXPECT_EQ(count(events, "new"), 1);
+}
+
+TEST(TraceTests, KeepsNewestEventsWhenFull) {
+  constexpr int total = 200000;
+
+  trace::start();
+  for (int x = 0; x < total; ++x) {
+    auto now = trace::clock::now();
+    trace::record("flood", x, now, now);
+  }
+  trace::stop();
+
+  auto events = export_events();
+  auto flood = count(events, "flood");
+  EXPECT_GT(flood, 0);
+  EXPECT_LT(flood, total);
+
+  int newest = -1;
+  for (auto &event : events) {
+    if (event.name == "flood") {
+      newest = std::max(newest, event.frame);
+    }
+  }
+  EXPECT_EQ(newest, total - 1);
+}
+
+TEST(TraceTests, ExportWhileRecording) {
+  trace::start();
+
+  std::atomic_bool done = false;
+  std::thread writer { [&]() {
+    for (int x = 0; !done; ++x) {
+      auto now = trace::clock::now();
+      trace::record("stamp", x, now, now + std::chrono::microseconds { x % 1000 });
+    }
+  } };
+
+  for (int x = 0; x < 5; ++x) {
+    for (auto &event : export_events()) {
+      // Torn events would mix up the fields of different stamps
+      if (event.name == "stamp") {
+        EXPECT_NEAR(event.dur, event.frame % 1000, 0.001);
+      }
+    }
+  }
+
+  done = true;
+  writer.join();
+  trace::stop();
+}
@@ -0,0 +1,190 @@
+/**
+ * @file tests/unit/test_video_convert.cpp
+ * @brief Test src/video_convert.*
+ */
+#include <src/video_convert.h>
+
+#include <cmath>
+#include <random>
+
+#include "../tests_common.h"
+
+namespace {
+  struct format_info_t {
+    int sample_size;
+    bool chroma420;
+    bool semi_planar;
+    int shift;
+  };
+
+  format_info_t
+  format_info(AVPixelFormat format) {
+    switch (format) {
+      case AV_PIX_FMT_YUV420P:
+        return { 1, true, false, 0 };
+      case AV_PIX_FMT_NV12:
+        return { 1, true, true, 0 };
+      case AV_PIX_FMT_YUV444P:
+        return { 1, false, false, 0 };
+      case AV_PIX_FMT_YUV420P10:
+        return { 2, true, false, 0 };
+      case AV_PIX_FMT_P010:
+        return { 2, true, true, 6 };
+      case AV_PIX_FMT_YUV444P10:
+      default:
+        return { 2, false, false, 0 };
+    }
+  }
+
+  struct frame_t {
+    frame_t(AVPixelFormat format, int width, int height):
+        info { format_info(format) } {
+      auto chroma_width = info.chroma420 ? (width + 1) / 2 : width;
+      auto chroma_height = info.chroma420 ? (height + 1) / 2 : height;
+
+      linesize[0] = width * info.sample_size;
+      planes[0].resize(linesize[0] * height);
+
+      if (info.semi_planar) {
+        linesize[1] = chroma_width * 2 * info.sample_size;
+        planes[1].resize(linesize[1] * chroma_height);
+      }
+      else {
+        for (int x = 1; x < 3; ++x) {
+          linesize[x] = chroma_width * info.sample_size;
+          planes[x].resize(linesize[x] * chroma_height);
+        }
+      }
+
+      for (int x = 0; x < 3; ++x) {
+        data[x] = planes[x].empty() ? nullptr : planes[x].data();
+      }
+    }
+
+    format_info_t info;
+    std::vector<std::uint8_t> planes[3];
+    std::uint8_t *data[4] {};
+    int linesize[4] {};
+  };
+
+  std::vector<std::uint8_t>
+  random_image(int width, int height) {
+    std::mt19937 rng { 1234 };
+
+    std::vector<std::uint8_t> image(width * height * 4);
+    for (auto &byte : image) {
+      byte = rng();
+    }
+
+    return image;
+  }
+
+  /**
+   * @brief Convert a pixel with floating point math, before rounding.
+   */
+  double
+  reference(const std::uint8_t *pixel, const float (&color_vec)[4]) {
+    return pixel[2] / 255.0 * color_vec[0] + pixel[1] / 255.0 * color_vec[1] + pixel[0] / 255.0 * color_vec[2] + color_vec[3];
+  }
+}  // namespace
+
+struct VideoConvertTest: testing::TestWithParam<AVPixelFormat> {};
+
+INSTANTIATE_TEST_SUITE_P(
+  VideoConvertFormats,
+  VideoConvertTest,
+  testing::Values(
+    AV_PIX_FMT_YUV420P,
+    AV_PIX_FMT_NV12,
+    AV_PIX_FMT_YUV444P,
+    AV_PIX_FMT_YUV420P10,
+    AV_PIX_FMT_P010,
+    AV_PIX_FMT_YUV444P10));
+
+TEST_P(VideoConvertTest, SimdMatchesScalar) {
+  // Odd dimensions exercise the scalar tails of the SIMD kernels
+  for (auto [width, height] : { std::pair { 64, 32 }, std::pair { 101, 37 } }) {
+    auto image = random_image(width, height);
+
+    auto scalar = video::bgr0_converter_t::make(GetParam(), 1, false);
+    auto simd = video::bgr0_converter_t::make(GetParam(), 3, true);
+    ASSERT_TRUE(scalar && simd);
+
+    frame_t expected { GetParam(), width, height };
+    frame_t actual { GetParam(), width, height };
+
+    scalar->convert(image.data(), width * 4, width, height, expected.data, expected.linesize);
+    simd->convert(image.data(), width * 4, width, height, actual.data, actual.linesize);
+
+    for (int x = 0; x < 3; ++x) {
+      ASSERT_EQ(actual.planes[x], expected.planes[x]) << "plane " << x << ", " << width << 'x' << height;
+    }
+  }
+}
+
+TEST_P(VideoConvertTest, MatchesReference) {
+  constexpr int width = 48;
+  constexpr int height = 16;
+
+  auto info = format_info(GetParam());
+  auto image = random_image(width, height);
+
+  for (auto colorspace : { video::colorspace_e::rec601, video::colorspace_e::rec709, video::colorspace_e::bt2020sdr }) {
+    for (auto full_range : { false, true }) {
+      video::sunshine_colorspace_t sunshine_colorspace { colorspace, full_range, info.sample_size == 2 ? 10u : 8u };
+      auto color_vectors = video::new_color_vectors_from_colorspace(sunshine_colorspace);
+      auto max = (1 << sunshine_colorspace.bit_depth) - 1;
+
+      auto converter = video::bgr0_converter_t::make(GetParam(), 1);
+      ASSERT_TRUE(converter);
+      converter->set_colorspace(sunshine_colorspace);
+
+      frame_t frame { GetParam(), width, height };
+      converter->convert(image.data(), width * 4, width, height, frame.data, frame.linesize);
+
+      auto value = [&](int plane, int x, int y) {
+        auto row = frame.planes[plane].data() + y * frame.linesize[plane];
+        return info.sample_size == 2 ? ((std::uint16_t *) row)[x] >> info.shift : row[x];
+      };
+      auto expect_near = [&](double expected, int actual) {
+        ASSERT_NEAR(std::clamp((int) std::floor(expected), 0, max), actual, 1);
+      };
+
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          auto pixel = image.data() + (y * width + x) * 4;
+
+          expect_near(reference(pixel, color_vectors->color_vec_y), value(0, x, y));
+          if (!info.chroma420) {
+            expect_near(reference(pixel, color_vectors->color_vec_u), value(1, x, y));
+            expect_near(reference(pixel, color_vectors->color_vec_v), value(2, x, y));
+          }
+        }
+      }
+
+      if (!info.chroma420) {
+        continue;
+      }
+
+      for (int y = 0; y < height / 2; ++y) {
+        for (int x = 0; x < width / 2; ++x) {
+          double u = 0, v = 0;
+          for (auto [dx, dy] : { std::pair { 0, 0 }, std::pair { 1, 0 }, std::pair { 0, 1 }, std::pair { 1, 1 } }) {
+            auto pixel = image.data() + ((y * 2 + dy) * width + x * 2 + dx) * 4;
+            u += reference(pixel, color_vectors->color_vec_u) / 4;
+            v += reference(pixel, color_vectors->color_vec_v) / 4;
+          }
+
+          if (info.semi_planar) {
+            expect_near(u, value(1, x * 2, y));
+            expect_near(v, value(1, x * 2 + 1, y));
+          }
+          else {
+            expect_near(u, value(1, x, y));
+            expect_near(v, value(2, x, y));
+          }
+        }
+      }
+    }
+  }
+}
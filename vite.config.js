@@ -1,6 +1,7 @@
 import { fileURLToPath, URL } from 'node:url'
 import fs from 'fs'
-import { resolve } from 'path'
+import { join, resolve } from 'path'
+import zlib from 'zlib'
 import { defineConfig } from 'vite'
 import { ViteEjsPlugin } from 'vite-plugin-ejs'
 import vue from '@vitejs/plugin-vue'
@@ -31,6 +32,52 @@ if (process.env.SUNSHINE_BUILD_HOMEBREW) {
 
 let header = fs.readFileSync(resolve(assetsSrcPath, 'template_header.html'))
 
+/**
+ * Writes a .gz and a .br file next to every text file of the build,
+ * the Web UI server sends them to clients that accept them instead of compressing on every request
+ */
+function precompress() {
+  const compressible = /\.(html|js|css|svg|json|ico|ttf|txt|xml)$/
+  let outDir
+
+  const walk = (dir) =>
+    fs.readdirSync(dir, { withFileTypes: true }).flatMap((entry) => {
+      const path = join(dir, entry.name)
+      return entry.isDirectory() ? walk(path) : [path]
+    })
+
+  return {
+    name: 'sunshine-precompress',
+    apply: 'build',
+    configResolved(config) {
+      outDir = config.build.outDir
+    },
+    closeBundle() {
+      for (const file of walk(outDir).filter((file) => compressible.test(file))) {
+        const content = fs.readFileSync(file)
+        const variants = {
+          '.gz': zlib.gzipSync(content, { level: zlib.constants.Z_BEST_COMPRESSION }),
+          '.br': zlib.brotliCompressSync(content, {
+            params: {
+              [zlib.constants.BROTLI_PARAM_QUALITY]: zlib.constants.BROTLI_MAX_QUALITY,
+              [zlib.constants.BROTLI_PARAM_SIZE_HINT]: content.length,
+            },
+          }),
+        }
+
+        for (const [extension, compressed] of Object.entries(variants)) {
+          // Files that don't get smaller are sent as they are
+          if (compressed.length < content.length) {
+            fs.writeFileSync(file + extension, compressed)
+          } else {
+            fs.rmSync(file + extension, { force: true })
+          }
+        }
+      }
+    },
+  }
+}
+
 // https://vitejs.dev/config/
 export default defineConfig({
   resolve: {
@@ -38,7 +85,7 @@ export default defineConfig({
       vue: 'vue/dist/vue.esm-bundler.js',
     },
   },
-  plugins: [vue(), ViteEjsPlugin({ header })],
+  plugins: [vue(), ViteEjsPlugin({ header }), precompress()],
   root: resolve(assetsSrcPath),
   build: {
     outDir: resolve(assetsDstPath),